@@ -0,0 +1,294 @@
+/**
+ * Benchmarks against the loopback server in bench/server.cc. Needs no
+ * sshd and no network, so results are comparable between runs on one box.
+ *
+ *   yarn build:native && yarn bench [--quick] [--only name,name] [--out file]
+ *
+ * Results are printed as JSON on stdout (or written to --out); progress
+ * goes to stderr.
+ */
+import { ChildProcess, spawn } from 'child_process';
+import * as fs from 'fs';
+import * as net from 'net';
+import * as os from 'os';
+import * as path from 'path';
+import { SSHSession, SSHTunnel } from '../lib';
+
+const SERVER_PATH = path.join(__dirname, '..', 'build', 'Release', 'libssh_node_bench_server');
+
+interface BenchOptions {
+  quick: boolean;
+  only: string[] | null;
+  out: string | null;
+}
+
+interface Percentiles {
+  count: number;
+  minMs: number;
+  p50Ms: number;
+  p90Ms: number;
+  p99Ms: number;
+  maxMs: number;
+}
+
+interface BenchServer {
+  process: ChildProcess;
+  port: number;
+}
+
+type Scenario = (server: BenchServer, quick: boolean) => Promise<Record<string, unknown>>;
+
+function parseArgs(argv: string[]): BenchOptions {
+  const options: BenchOptions = { quick: false, only: null, out: null };
+  for (let i = 0; i < argv.length; i++) {
+    if (argv[i] === '--quick') {
+      options.quick = true;
+    } else if (argv[i] === '--only') {
+      options.only = argv[++i].split(',');
+    } else if (argv[i] === '--out') {
+      options.out = argv[++i];
+    }
+  }
+  return options;
+}
+
+function log(message: string): void {
+  process.stderr.write(`${message}\n`);
+}
+
+function elapsedMs(start: bigint): number {
+  return Number(process.hrtime.bigint() - start) / 1e6;
+}
+
+function percentiles(samples: number[]): Percentiles {
+  const sorted = [...samples].sort((a, b) => a - b);
+  const at = (q: number) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+  return {
+    count: sorted.length,
+    minMs: sorted[0],
+    p50Ms: at(0.5),
+    p90Ms: at(0.9),
+    p99Ms: at(0.99),
+    maxMs: sorted[sorted.length - 1]
+  };
+}
+
+function startServer(): Promise<BenchServer> {
+  if (!fs.existsSync(SERVER_PATH)) {
+    throw new Error(`${SERVER_PATH} not found; run yarn build:native first`);
+  }
+
+  return new Promise((resolve, reject) => {
+    const child = spawn(SERVER_PATH, [], { stdio: ['pipe', 'pipe', 'inherit'] });
+    let output = '';
+    child.once('error', reject);
+    child.once('exit', code => reject(new Error(`Benchmark server exited with code ${code}`)));
+    child.stdout!.on('data', (chunk: Buffer) => {
+      output += chunk.toString();
+      const match = /listening (\d+)/.exec(output);
+      if (match) {
+        child.removeAllListeners('exit');
+        resolve({ process: child, port: Number(match[1]) });
+      }
+    });
+  });
+}
+
+async function connect(server: BenchServer): Promise<SSHSession> {
+  const session = new SSHSession({ host: '127.0.0.1', port: server.port, user: 'bench', autoDetectAgent: false });
+  await session.connect();
+  await session.authenticate({ username: 'bench', password: 'bench' });
+  return session;
+}
+
+async function openTunnelSocket(session: SSHSession): Promise<{ tunnel: SSHTunnel; socket: net.Socket }> {
+  // The server echoes every direct-tcpip channel, so the target is never dialled
+  const tunnel = new SSHTunnel({ session, remoteHost: '127.0.0.1', remotePort: 7 });
+  await tunnel.start();
+  const address = tunnel.getLocalAddress()!;
+  const socket = net.connect(address.port, address.host);
+  socket.setNoDelay(true);
+  await new Promise<void>((resolve, reject) => {
+    socket.once('connect', resolve);
+    socket.once('error', reject);
+  });
+  return { tunnel, socket };
+}
+
+// Bulk data through a forwarded connection and back
+const tunnelThroughput: Scenario = async (server, quick) => {
+  const totalBytes = (quick ? 16 : 256) * 1024 * 1024;
+  const chunk = Buffer.alloc(64 * 1024, 0x61);
+  const session = await connect(server);
+  const { tunnel, socket } = await openTunnelSocket(session);
+
+  const start = process.hrtime.bigint();
+  let received = 0;
+  const echoed = new Promise<void>(resolve => {
+    socket.on('data', (data: Buffer) => {
+      received += data.length;
+      if (received >= totalBytes) {
+        resolve();
+      }
+    });
+  });
+
+  let sent = 0;
+  while (sent < totalBytes) {
+    const piece = chunk.subarray(0, Math.min(chunk.length, totalBytes - sent));
+    sent += piece.length;
+    if (!socket.write(piece)) {
+      await new Promise(resolve => socket.once('drain', resolve));
+    }
+  }
+  await echoed;
+  const ms = elapsedMs(start);
+
+  socket.destroy();
+  await tunnel.stop();
+  await session.disconnect();
+  return {
+    bytes: totalBytes,
+    ms,
+    // Each byte crosses the tunnel twice
+    mbPerSecond: (2 * totalBytes) / (1024 * 1024) / (ms / 1000)
+  };
+};
+
+// Round trips of a small message through a forwarded connection
+const tunnelLatency: Scenario = async (server, quick) => {
+  const iterations = quick ? 200 : 2000;
+  const message = Buffer.alloc(64, 0x62);
+  const session = await connect(server);
+  const { tunnel, socket } = await openTunnelSocket(session);
+
+  const samples: number[] = [];
+  for (let i = 0; i < iterations; i++) {
+    const start = process.hrtime.bigint();
+    await new Promise<void>(resolve => {
+      let received = 0;
+      const onData = (data: Buffer) => {
+        received += data.length;
+        if (received >= message.length) {
+          socket.off('data', onData);
+          resolve();
+        }
+      };
+      socket.on('data', onData);
+      socket.write(message);
+    });
+    samples.push(elapsedMs(start));
+  }
+
+  socket.destroy();
+  await tunnel.stop();
+  await session.disconnect();
+  return { messageBytes: message.length, ...percentiles(samples) };
+};
+
+// Channels opened in one burst with openChannels()
+const channelOpenRate: Scenario = async (server, quick) => {
+  const count = quick ? 50 : 500;
+  const session = await connect(server);
+
+  const start = process.hrtime.bigint();
+  const channels = await Promise.all(session.openChannels(count));
+  const ms = elapsedMs(start);
+
+  await Promise.all(channels.map(channel => channel.close()));
+  const operations = session.getStats().operations;
+  await session.disconnect();
+  return { channels: count, ms, channelsPerSecond: count / (ms / 1000), open: operations.open };
+};
+
+// Sequential open, exec, exit status and close of one command
+const execRoundTrip: Scenario = async (server, quick) => {
+  const iterations = quick ? 50 : 500;
+  const session = await connect(server);
+
+  const samples: number[] = [];
+  for (let i = 0; i < iterations; i++) {
+    const start = process.hrtime.bigint();
+    const [result] = await session.execMany(['true']);
+    samples.push(elapsedMs(start));
+    if (result.exitCode !== 0) {
+      throw new Error(`exec failed: ${result.error ?? result.exitCode}`);
+    }
+  }
+
+  await session.disconnect();
+  return percentiles(samples);
+};
+
+// Resident memory added per connected, authenticated session
+const memoryPerConnection: Scenario = async (server, quick) => {
+  const count = quick ? 10 : 100;
+  const collect = (global as { gc?: () => void }).gc;
+  collect?.();
+  const before = process.memoryUsage();
+
+  const sessions: SSHSession[] = [];
+  for (let i = 0; i < count; i++) {
+    sessions.push(await connect(server));
+  }
+  collect?.();
+  const after = process.memoryUsage();
+
+  await Promise.all(sessions.map(session => session.disconnect()));
+  return {
+    sessions: count,
+    rssBytesPerSession: (after.rss - before.rss) / count,
+    heapBytesPerSession: (after.heapUsed - before.heapUsed) / count,
+    externalBytesPerSession: (after.external - before.external) / count,
+    gcExposed: collect !== undefined
+  };
+};
+
+const SCENARIOS: Record<string, Scenario> = {
+  tunnelThroughput,
+  tunnelLatency,
+  channelOpenRate,
+  execRoundTrip,
+  memoryPerConnection
+};
+
+async function main(): Promise<void> {
+  const options = parseArgs(process.argv.slice(2));
+  const names = options.only ?? Object.keys(SCENARIOS);
+  for (const name of names) {
+    if (!SCENARIOS[name]) {
+      throw new Error(`Unknown scenario: ${name} (expected one of ${Object.keys(SCENARIOS).join(', ')})`);
+    }
+  }
+
+  const server = await startServer();
+  const results: Record<string, unknown> = {};
+  try {
+    for (const name of names) {
+      log(`running ${name}...`);
+      results[name] = await SCENARIOS[name](server, options.quick);
+    }
+  } finally {
+    server.process.stdin!.end();
+  }
+
+  const report = JSON.stringify({
+    timestamp: new Date().toISOString(),
+    quick: options.quick,
+    node: process.version,
+    platform: `${os.platform()} ${os.arch()}`,
+    cpus: os.cpus().length,
+    results
+  }, null, 2);
+
+  if (options.out) {
+    fs.writeFileSync(options.out, `${report}\n`);
+  } else {
+    process.stdout.write(`${report}\n`);
+  }
+}
+
+main().catch(err => {
+  log(`benchmark failed: ${(err as Error).message}`);
+  process.exit(1);
+});
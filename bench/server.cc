@@ -0,0 +1,307 @@
+// Loopback SSH server for the benchmarks in bench/run.ts, built on
+// libssh's server API so no sshd is needed. It accepts any password and
+// serves just enough to exercise the client's hot paths:
+//
+// - direct-tcpip channels echo everything back, whatever the target
+// - exec "true" exits 0, "echo <text>" prints text, "cat" echoes until
+//   EOF, "zero <bytes>" writes that many zero bytes; anything else exits 127
+//
+// Prints "listening <port>" once bound and exits when stdin closes, so a
+// crashed driver never leaves it behind.
+//
+// usage: libssh_node_bench_server [--host 127.0.0.1] [--port 0]
+
+#include <libssh/libssh.h>
+#include <libssh/server.h>
+#include <libssh/callbacks.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace libssh_node {
+namespace {
+
+constexpr int kPollMs = 100;
+constexpr uint32_t kChunkSize = 64 * 1024;
+
+// One channel and what the server still has to do with it
+struct BenchChannel {
+  enum class Mode { kPending, kEcho, kOutput, kDone };
+
+  ssh_channel channel = nullptr;
+  Mode mode = Mode::kPending;
+  bool exec = false; // Session channel: report an exit status when done
+  int exitStatus = 0;
+  std::string output;       // Written before finishing in kOutput
+  uint64_t zeroBytes = 0;   // Then this many zero bytes
+  struct ssh_channel_callbacks_struct callbacks;
+};
+
+struct Connection {
+  ssh_session session = nullptr;
+  std::vector<std::unique_ptr<BenchChannel>> channels;
+  struct ssh_server_callbacks_struct callbacks;
+};
+
+int OnAuthPassword(ssh_session, const char*, const char*, void*) {
+  return SSH_AUTH_SUCCESS;
+}
+
+int OnExecRequest(ssh_session, ssh_channel, const char* command, void* userdata) {
+  BenchChannel* bench = static_cast<BenchChannel*>(userdata);
+  std::string line(command);
+
+  // The reply goes out when this returns; output follows on the next pass
+  if (line == "true") {
+    bench->mode = BenchChannel::Mode::kOutput;
+  } else if (line == "cat") {
+    bench->mode = BenchChannel::Mode::kEcho;
+  } else if (line.compare(0, 5, "echo ") == 0) {
+    bench->mode = BenchChannel::Mode::kOutput;
+    bench->output = line.substr(5) + "\n";
+  } else if (line.compare(0, 5, "zero ") == 0) {
+    bench->mode = BenchChannel::Mode::kOutput;
+    bench->zeroBytes = std::strtoull(line.c_str() + 5, nullptr, 10);
+  } else {
+    bench->mode = BenchChannel::Mode::kOutput;
+    bench->output = "unknown command: " + line + "\n";
+    bench->exitStatus = 127;
+  }
+  return 0;
+}
+
+BenchChannel* AddChannel(Connection* conn, ssh_channel channel) {
+  auto bench = std::make_unique<BenchChannel>();
+  bench->channel = channel;
+  conn->channels.push_back(std::move(bench));
+  return conn->channels.back().get();
+}
+
+ssh_channel OnSessionChannel(ssh_session session, void* userdata) {
+  Connection* conn = static_cast<Connection*>(userdata);
+  ssh_channel channel = ssh_channel_new(session);
+  if (channel == nullptr) {
+    return nullptr;
+  }
+
+  BenchChannel* bench = AddChannel(conn, channel);
+  bench->exec = true;
+  std::memset(&bench->callbacks, 0, sizeof(bench->callbacks));
+  bench->callbacks.userdata = bench;
+  bench->callbacks.channel_exec_request_function = &OnExecRequest;
+  ssh_callbacks_init(&bench->callbacks);
+  ssh_set_channel_callbacks(channel, &bench->callbacks);
+  return channel;
+}
+
+// Messages the server callbacks don't cover. Returns 1 for the default
+// (refusing) reply.
+int OnMessage(ssh_session, ssh_message message, void* userdata) {
+  Connection* conn = static_cast<Connection*>(userdata);
+  if (ssh_message_type(message) != SSH_REQUEST_CHANNEL_OPEN ||
+      ssh_message_subtype(message) != SSH_CHANNEL_DIRECT_TCPIP) {
+    return 1;
+  }
+
+  ssh_channel channel = ssh_message_channel_request_open_reply_accept(message);
+  if (channel == nullptr) {
+    return 1;
+  }
+  AddChannel(conn, channel)->mode = BenchChannel::Mode::kEcho;
+  return 0;
+}
+
+void Finish(BenchChannel* bench) {
+  if (bench->exec) {
+    ssh_channel_request_send_exit_status(bench->channel, bench->exitStatus);
+  }
+  ssh_channel_send_eof(bench->channel);
+  ssh_channel_close(bench->channel);
+  bench->mode = BenchChannel::Mode::kDone;
+}
+
+// Moves as much as the client's window allows, never blocking
+void Service(BenchChannel* bench, char* buffer) {
+  static const char zeros[kChunkSize] = {};
+  ssh_channel channel = bench->channel;
+
+  switch (bench->mode) {
+    case BenchChannel::Mode::kEcho:
+      // Unread data stays in libssh's buffer and keeps our window shut,
+      // so a client that outruns the echo is throttled, not buffered
+      while (uint32_t window = ssh_channel_window_size(channel)) {
+        int n = ssh_channel_read_nonblocking(channel, buffer, std::min(window, kChunkSize), 0);
+        if (n <= 0) {
+          break;
+        }
+        ssh_channel_write(channel, buffer, static_cast<uint32_t>(n));
+      }
+      if (ssh_channel_is_eof(channel)) {
+        Finish(bench);
+      }
+      break;
+
+    case BenchChannel::Mode::kOutput:
+      while (!bench->output.empty() || bench->zeroBytes > 0) {
+        uint32_t window = std::min(ssh_channel_window_size(channel), kChunkSize);
+        if (window == 0) {
+          return;
+        }
+        int n;
+        if (!bench->output.empty()) {
+          n = ssh_channel_write(channel, bench->output.data(),
+                                std::min(window, static_cast<uint32_t>(bench->output.size())));
+          if (n > 0) {
+            bench->output.erase(0, static_cast<size_t>(n));
+          }
+        } else {
+          n = ssh_channel_write(channel, zeros,
+                                static_cast<uint32_t>(std::min<uint64_t>(window, bench->zeroBytes)));
+          if (n > 0) {
+            bench->zeroBytes -= static_cast<uint64_t>(n);
+          }
+        }
+        if (n <= 0) {
+          return;
+        }
+      }
+      Finish(bench);
+      break;
+
+    case BenchChannel::Mode::kPending:
+    case BenchChannel::Mode::kDone:
+      break;
+  }
+}
+
+void Serve(ssh_session session) {
+  Connection conn;
+  conn.session = session;
+  std::vector<char> buffer(kChunkSize);
+
+  std::memset(&conn.callbacks, 0, sizeof(conn.callbacks));
+  conn.callbacks.userdata = &conn;
+  conn.callbacks.auth_password_function = &OnAuthPassword;
+  conn.callbacks.channel_open_request_session_function = &OnSessionChannel;
+  ssh_callbacks_init(&conn.callbacks);
+  ssh_set_server_callbacks(session, &conn.callbacks);
+  ssh_set_message_callback(session, &OnMessage, &conn);
+  ssh_set_auth_methods(session, SSH_AUTH_METHOD_PASSWORD);
+
+  if (ssh_handle_key_exchange(session) != SSH_OK) {
+    std::fprintf(stderr, "key exchange failed: %s\n", ssh_get_error(session));
+    ssh_free(session);
+    return;
+  }
+  ssh_set_blocking(session, 0);
+
+  ssh_event event = ssh_event_new();
+  ssh_event_add_session(event, session);
+
+  while (ssh_event_dopoll(event, kPollMs) != SSH_ERROR &&
+         (ssh_get_status(session) & (SSH_CLOSED | SSH_CLOSED_ERROR)) == 0) {
+    for (auto& bench : conn.channels) {
+      Service(bench.get(), buffer.data());
+    }
+
+    // Freeing a channel the client has not closed yet is fine: libssh
+    // keeps it until the close arrives
+    auto closed = std::remove_if(conn.channels.begin(), conn.channels.end(),
+                                 [](const std::unique_ptr<BenchChannel>& bench) {
+                                   if (!ssh_channel_is_closed(bench->channel)) {
+                                     return false;
+                                   }
+                                   if (bench->exec) {
+                                     ssh_remove_channel_callbacks(bench->channel, &bench->callbacks);
+                                   }
+                                   ssh_channel_free(bench->channel);
+                                   return true;
+                                 });
+    conn.channels.erase(closed, conn.channels.end());
+  }
+
+  for (auto& bench : conn.channels) {
+    if (bench->exec) {
+      ssh_remove_channel_callbacks(bench->channel, &bench->callbacks);
+    }
+    ssh_channel_free(bench->channel);
+  }
+  ssh_event_remove_session(event, session);
+  ssh_event_free(event);
+  ssh_disconnect(session);
+  ssh_free(session);
+}
+
+int BoundPort(ssh_bind bind) {
+  struct sockaddr_storage addr;
+  socklen_t length = sizeof(addr);
+  if (getsockname(ssh_bind_get_fd(bind), reinterpret_cast<struct sockaddr*>(&addr), &length) != 0) {
+    return -1;
+  }
+  if (addr.ss_family == AF_INET6) {
+    return ntohs(reinterpret_cast<struct sockaddr_in6*>(&addr)->sin6_port);
+  }
+  return ntohs(reinterpret_cast<struct sockaddr_in*>(&addr)->sin_port);
+}
+
+} // namespace
+} // namespace libssh_node
+
+int main(int argc, char** argv) {
+  using namespace libssh_node;
+
+  std::string host = "127.0.0.1";
+  int port = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--host") == 0) {
+      host = argv[i + 1];
+    } else if (std::strcmp(argv[i], "--port") == 0) {
+      port = std::atoi(argv[i + 1]);
+    }
+  }
+
+  ssh_init();
+
+  // A fresh host key per run; the client does not check host keys
+  ssh_key hostKey = nullptr;
+  if (ssh_pki_generate(SSH_KEYTYPE_ED25519, 0, &hostKey) != SSH_OK) {
+    std::fprintf(stderr, "failed to generate host key\n");
+    return 1;
+  }
+
+  ssh_bind bind = ssh_bind_new();
+  ssh_bind_options_set(bind, SSH_BIND_OPTIONS_BINDADDR, host.c_str());
+  ssh_bind_options_set(bind, SSH_BIND_OPTIONS_BINDPORT, &port);
+  ssh_bind_options_set(bind, SSH_BIND_OPTIONS_IMPORT_KEY, hostKey);
+  if (ssh_bind_listen(bind) != SSH_OK) {
+    std::fprintf(stderr, "listen failed: %s\n", ssh_get_error(bind));
+    return 1;
+  }
+
+  std::printf("listening %d\n", BoundPort(bind));
+  std::fflush(stdout);
+
+  std::thread([] {
+    while (std::fgetc(stdin) != EOF) {
+    }
+    std::_Exit(0);
+  }).detach();
+
+  for (;;) {
+    ssh_session session = ssh_new();
+    if (ssh_bind_accept(bind, session) != SSH_OK) {
+      std::fprintf(stderr, "accept failed: %s\n", ssh_get_error(bind));
+      ssh_free(session);
+      continue;
+    }
+    std::thread(Serve, session).detach();
+  }
+}
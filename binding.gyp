@@ -5,9 +5,23 @@
       "sources": [
         "src/binding.cc",
         "src/ssh_session.cc",
+        "src/session_options.cc",
+        "src/ssh_config.cc",
         "src/ssh_channel.cc",
         "src/ssh_sftp.cc",
+        "src/sftp_client.cc",
+        "src/sftp_transfer.cc",
+        "src/ssh_tunnel.cc",
+        "src/agent_client.cc",
         "src/async_workers.cc",
+        "src/happy_eyeballs.cc",
+        "src/jump_transport.cc",
+        "src/exec.cc",
+        "src/line_framer.cc",
+        "src/buffer_pool.cc",
+        "src/reactor.cc",
+        "src/stats.cc",
+        "src/socket_util.cc",
         "src/utils.cc"
       ],
       "include_dirs": [
@@ -43,7 +57,7 @@
         [
           "OS=='win'",
           {
-            "libraries": ["ssh.lib"],
+            "libraries": ["ssh.lib", "ws2_32.lib"],
             "msvs_settings": {
               "VCCLCompilerTool": {
                 "ExceptionHandling": 1,
@@ -54,5 +68,29 @@
         ]
       ]
     }
+  ],
+  "conditions": [
+    [
+      "OS!='win'",
+      {
+        "targets": [
+          {
+            # Loopback SSH server for bench/run.ts
+            "target_name": "libssh_node_bench_server",
+            "type": "executable",
+            "sources": ["bench/server.cc"],
+            "cflags!": ["-fno-exceptions"],
+            "cflags_cc!": ["-fno-exceptions"],
+            "cflags_cc": ["-std=c++17"],
+            "libraries": ["-lssh", "-lpthread"],
+            "xcode_settings": {
+              "CLANG_CXX_LIBRARY": "libc++",
+              "MACOSX_DEPLOYMENT_TARGET": "10.15",
+              "OTHER_CPLUSPLUSFLAGS": ["-std=c++17", "-stdlib=libc++"]
+            }
+          }
+        ]
+      }
+    ]
   ]
 }
@@ -1,6 +1,240 @@
+import { Duplex, Readable } from 'stream';
+import { SSHChannelError } from './errors';
+import { ChannelExecOptions, ExecResult, OperationOptions, toNativeCapture } from './exec';
+
 // eslint-disable-next-line @typescript-eslint/no-var-requires
 const binding = require('../build/Release/libssh_node.node');
 
+/** Data moved through a channel, or through every channel of a session */
+export interface ChannelStats {
+  bytesRead: number;
+  bytesWritten: number;
+  reads: number;
+  writes: number;
+  /** Times writing stopped because the remote window was empty */
+  windowStalls: number;
+  /** Bytes accepted from write()/writev() and not yet sent */
+  bufferedBytes: number;
+}
+
+export interface ChannelStreamOptions {
+  /** Bytes buffered on each side before backpressure applies */
+  highWaterMark?: number;
+}
+
+export interface LineStreamOptions {
+  /** Lines per batch before it is delivered (default 1000) */
+  maxBatch?: number;
+  /** Deliver a partial batch once its oldest line is this old (ms, default 50) */
+  flushMs?: number;
+  /** Longer lines are split at this many bytes (default 1MB) */
+  maxLineLength?: number;
+  /** Batches buffered before native reads pause (default 16) */
+  highWaterMark?: number;
+}
+
+interface ChannelStreamEvent {
+  type: 'data' | 'stderr' | 'lines' | 'stderrLines' | 'eof' | 'exit' | 'close';
+  data?: Buffer;
+  lines?: string[];
+  code?: number;
+}
+
+/**
+ * Object-mode readable of line batches (`string[]`) from an open channel.
+ * Output is split on newlines natively, so JS receives one array per batch
+ * instead of raw chunks to re-split. stderr lines arrive on the `stderr`
+ * readable, and the exit status as the `exit` event.
+ */
+export class SSHChannelLineStream extends Readable {
+  readonly stderr: Readable;
+  exitCode: number | null = null;
+
+  private channel: typeof binding.SSHChannel;
+  private reading = false;
+  private remoteClosed = false;
+  private readableEndPushed = false;
+
+  constructor(nativeChannel: typeof binding.SSHChannel, options: LineStreamOptions = {}) {
+    super({ objectMode: true, highWaterMark: options.highWaterMark ?? 16 });
+    this.channel = nativeChannel;
+    this.stderr = new Readable({ objectMode: true, read() { /* pushed by the channel */ } });
+    this.channel.startStream((event: ChannelStreamEvent) => this.handleEvent(event), {
+      lines: {
+        maxBatch: options.maxBatch,
+        flushMs: options.flushMs,
+        maxLineLength: options.maxLineLength
+      }
+    });
+  }
+
+  _read(): void {
+    if (!this.reading) {
+      this.reading = true;
+      this.channel.readStart();
+    }
+  }
+
+  _destroy(error: Error | null, callback: (error?: Error | null) => void): void {
+    if (this.remoteClosed) {
+      callback(error);
+      return;
+    }
+    Promise.resolve(this.channel.close()).then(() => callback(error), () => callback(error));
+  }
+
+  private handleEvent(event: ChannelStreamEvent): void {
+    switch (event.type) {
+      case 'lines':
+        if (!this.push(event.lines) && this.reading) {
+          this.reading = false;
+          this.channel.readStop();
+        }
+        break;
+      case 'stderrLines':
+        this.stderr.push(event.lines);
+        break;
+      case 'eof':
+        this.endReadable();
+        break;
+      case 'exit':
+        this.exitCode = event.code ?? null;
+        this.emit('exit', this.exitCode);
+        break;
+      case 'close':
+        this.remoteClosed = true;
+        this.endReadable();
+        break;
+    }
+  }
+
+  private endReadable(): void {
+    if (!this.readableEndPushed) {
+      this.readableEndPushed = true;
+      this.push(null);
+      this.stderr.push(null);
+    }
+  }
+}
+
+/**
+ * Duplex stream over an open channel. Data is pushed from the native layer
+ * as it arrives; native reads pause while the readable side is full.
+ * Remote stderr is available as the separate `stderr` readable, which does
+ * not apply backpressure.
+ */
+export class SSHChannelStream extends Duplex {
+  readonly stderr: Readable;
+  exitCode: number | null = null;
+
+  private channel: typeof binding.SSHChannel;
+  private reading = false;
+  private remoteClosed = false;
+  private readableEndPushed = false;
+
+  constructor(nativeChannel: typeof binding.SSHChannel, options: ChannelStreamOptions = {}) {
+    super({
+      allowHalfOpen: true,
+      readableHighWaterMark: options.highWaterMark,
+      writableHighWaterMark: options.highWaterMark
+    });
+    this.channel = nativeChannel;
+    this.stderr = new Readable({ read() { /* pushed by the channel */ } });
+    this.channel.startStream((event: ChannelStreamEvent) => this.handleEvent(event));
+  }
+
+  _read(): void {
+    if (!this.reading) {
+      this.reading = true;
+      this.channel.readStart();
+    }
+  }
+
+  _write(chunk: Buffer, _encoding: BufferEncoding, callback: (error?: Error | null) => void): void {
+    if (this.remoteClosed) {
+      callback(new SSHChannelError('Channel is closed'));
+      return;
+    }
+    this.queueWrite(this.channel.write(chunk), callback);
+  }
+
+  _writev(
+    chunks: Array<{ chunk: Buffer; encoding: BufferEncoding }>,
+    callback: (error?: Error | null) => void
+  ): void {
+    if (this.remoteClosed) {
+      callback(new SSHChannelError('Channel is closed'));
+      return;
+    }
+    this.queueWrite(this.channel.writev(chunks.map(({ chunk }) => chunk)), callback);
+  }
+
+  _final(callback: (error?: Error | null) => void): void {
+    if (this.remoteClosed) {
+      callback();
+      return;
+    }
+    this.channel.sendEof().then(() => callback(), callback);
+  }
+
+  _destroy(error: Error | null, callback: (error?: Error | null) => void): void {
+    if (this.remoteClosed) {
+      callback(error);
+      return;
+    }
+    Promise.resolve(this.channel.close()).then(() => callback(error), () => callback(error));
+  }
+
+  /**
+   * Let further writes queue up natively, where small chunks are coalesced,
+   * until the native queue reaches the high-water mark
+   */
+  private queueWrite(pending: Promise<number>, callback: (error?: Error | null) => void): void {
+    if (this.channel.getWriteQueueSize() < this.writableHighWaterMark) {
+      pending.catch((error: Error) => this.destroy(error));
+      callback();
+    } else {
+      pending.then(() => callback(), callback);
+    }
+  }
+
+  private handleEvent(event: ChannelStreamEvent): void {
+    switch (event.type) {
+      case 'data':
+        if (!this.push(event.data) && this.reading) {
+          this.reading = false;
+          this.channel.readStop();
+        }
+        break;
+      case 'stderr':
+        this.stderr.push(event.data);
+        break;
+      case 'eof':
+        this.endReadable();
+        break;
+      case 'exit':
+        this.exitCode = event.code ?? null;
+        this.emit('exit', this.exitCode);
+        break;
+      case 'close':
+        this.remoteClosed = true;
+        this.endReadable();
+        if (!this.writableEnded) {
+          this.end();
+        }
+        break;
+    }
+  }
+
+  private endReadable(): void {
+    if (!this.readableEndPushed) {
+      this.readableEndPushed = true;
+      this.push(null);
+      this.stderr.push(null);
+    }
+  }
+}
+
 export class SSHChannel {
   private channel: typeof binding.SSHChannel;
 
@@ -11,15 +245,28 @@ export class SSHChannel {
   /**
    * Open a session channel
    */
-  async openSession(): Promise<void> {
-    return this.channel.openSession();
+  async openSession(options?: OperationOptions): Promise<void> {
+    return this.channel.openSession(options);
   }
 
   /**
    * Execute a command on the remote host
    */
-  async requestExec(command: string): Promise<void> {
-    return this.channel.requestExec(command);
+  async requestExec(command: string, options?: OperationOptions): Promise<void> {
+    return this.channel.requestExec(command, options);
+  }
+
+  /**
+   * Run a command and collect both output streams and the exit status.
+   * stdout and stderr are drained natively as data arrives, so a chatty
+   * stderr cannot stall the channel; memory is bounded by `capture`.
+   */
+  async exec(command: string, options: ChannelExecOptions = {}): Promise<ExecResult> {
+    return this.channel.exec(command, {
+      timeoutMs: options.timeoutMs,
+      signal: options.signal,
+      capture: toNativeCapture(options.capture)
+    });
   }
 
   /**
@@ -29,23 +276,81 @@ export class SSHChannel {
     remoteHost: string,
     remotePort: number,
     sourceHost?: string,
-    sourcePort?: number
+    sourcePort?: number,
+    options?: OperationOptions
   ): Promise<void> {
-    return this.channel.requestForwardTcpIp(remoteHost, remotePort, sourceHost, sourcePort);
+    return this.channel.requestForwardTcpIp(remoteHost, remotePort, sourceHost, sourcePort, options);
+  }
+
+  /**
+   * Switch the channel to push mode and return it as a Duplex stream.
+   * read() cannot be used afterwards.
+   */
+  createStream(options?: ChannelStreamOptions): SSHChannelStream {
+    return new SSHChannelStream(this.channel, options);
+  }
+
+  /**
+   * Switch the channel to push mode and return its output as batches of
+   * lines, e.g. for `tail -F`. read() cannot be used afterwards.
+   */
+  createLineStream(options?: LineStreamOptions): SSHChannelLineStream {
+    return new SSHChannelLineStream(this.channel, options);
+  }
+
+  /**
+   * Signal end of input to the remote side
+   */
+  async sendEof(options?: OperationOptions): Promise<void> {
+    return this.channel.sendEof(options);
   }
 
   /**
    * Read data from the channel
    */
-  async read(maxBytes?: number): Promise<Buffer> {
-    return this.channel.read(maxBytes);
+  async read(maxBytes?: number, options?: OperationOptions): Promise<Buffer> {
+    return this.channel.read(maxBytes, options);
+  }
+
+  /**
+   * Read into a caller-supplied Buffer, starting at `offset` and filling at
+   * most `length` bytes. Resolves with the number of bytes read (0 at EOF).
+   */
+  async readInto(buffer: Buffer, offset?: number, length?: number, options?: OperationOptions): Promise<number> {
+    return this.channel.readInto(buffer, offset, length, options);
+  }
+
+  /**
+   * Write data to the channel. The Buffer is sent without copying and must
+   * not be modified until the returned promise settles. If the write is
+   * aborted, bytes already sent stay sent.
+   */
+  async write(data: Buffer, options?: OperationOptions): Promise<number> {
+    return this.channel.write(data, options);
+  }
+
+  /**
+   * Write several Buffers in one native operation. Same ownership rules as
+   * write().
+   */
+  async writev(buffers: Buffer[], options?: OperationOptions): Promise<number> {
+    return this.channel.writev(buffers, options);
+  }
+
+  /**
+   * Bytes accepted by write()/writev() that are still waiting for the
+   * remote window
+   */
+  getWriteQueueSize(): number {
+    return this.channel.getWriteQueueSize();
   }
 
   /**
-   * Write data to the channel
+   * I/O counters for this channel. The same traffic is also counted in
+   * its session's getStats().
    */
-  async write(data: Buffer): Promise<number> {
-    return this.channel.write(data);
+  getStats(): ChannelStats {
+    return this.channel.getStats();
   }
 
   /**
@@ -13,21 +13,54 @@ export interface SSHConfigHost {
   [key: string]: string | number | boolean | string[] | undefined;
 }
 
+/** One hop of a ProxyJump list */
+export interface SSHJumpHost {
+  /** The hop as written, e.g. "admin@bastion:2222" */
+  spec: string;
+  host: string;
+  port?: number;
+  user?: string;
+}
+
+type NativeResolveConfig = (host: string, configPath?: string) => Record<string, string[]>;
+
+interface CachedConfig {
+  mtimeMs: number;
+  size: number;
+  hosts: SSHConfigHost[];
+}
+
 export class SSHConfigParser {
+  private static nativeResolve: NativeResolveConfig | null | undefined;
+  private static cache = new Map<string, CachedConfig>();
+  private static patterns = new Map<string, (hostname: string) => boolean>();
+
   /**
-   * Parse SSH config file (default: ~/.ssh/config)
+   * Parse SSH config file (default: ~/.ssh/config). The result is cached
+   * until the file's mtime or size changes; treat it as read-only.
    */
   static parse(configPath?: string): SSHConfigHost[] {
     if (!configPath) {
       configPath = path.join(os.homedir(), '.ssh', 'config');
     }
 
-    if (!fs.existsSync(configPath)) {
+    let stat: fs.Stats;
+    try {
+      stat = fs.statSync(configPath);
+    } catch {
+      this.cache.delete(configPath);
       return [];
     }
 
+    const cached = this.cache.get(configPath);
+    if (cached && cached.mtimeMs === stat.mtimeMs && cached.size === stat.size) {
+      return cached.hosts;
+    }
+
     const content = fs.readFileSync(configPath, 'utf-8');
-    return this.parseContent(content);
+    const hosts = this.parseContent(content);
+    this.cache.set(configPath, { mtimeMs: stat.mtimeMs, size: stat.size, hosts });
+    return hosts;
   }
 
   /**
@@ -71,35 +104,88 @@ export class SSHConfigParser {
   }
 
   /**
-   * Find host configuration by hostname
+   * Effective configuration for hostname: every matching Host block, with
+   * the first value obtained winning as in ssh(1). Uses the native
+   * resolver, which also follows Include and Match and shares its cache
+   * with session construction, when the addon is built.
    */
   static findHostConfig(hostname: string, configPath?: string): SSHConfigHost | null {
-    const hosts = this.parse(configPath);
+    const resolve = this.loadNativeResolver();
+    if (resolve) {
+      const options = resolve(hostname, configPath);
+      const keys = Object.keys(options);
+      if (keys.length === 0) {
+        return null;
+      }
+      const host: SSHConfigHost = { host: hostname };
+      for (const key of keys) {
+        for (const value of options[key]) {
+          this.parseOption(host, key, value);
+        }
+      }
+      return host;
+    }
 
-    for (const host of hosts) {
-      if (this.matchHost(hostname, host.host)) {
-        return host;
+    let result: SSHConfigHost | null = null;
+    for (const block of this.parse(configPath)) {
+      if (!this.matchHost(hostname, block.host)) {
+        continue;
+      }
+      result = result || { host: hostname };
+      for (const [key, value] of Object.entries(block)) {
+        if (key === 'host' || value === undefined) {
+          continue;
+        }
+        if (key === 'identityFile') {
+          result.identityFile = [...(result.identityFile || []), ...(value as string[])];
+        } else if (result[key] === undefined) {
+          result[key] = value;
+        }
       }
     }
+    return result;
+  }
 
-    return null;
+  private static loadNativeResolver(): NativeResolveConfig | null {
+    if (this.nativeResolve === undefined) {
+      try {
+        // eslint-disable-next-line @typescript-eslint/no-var-requires
+        this.nativeResolve = require('../build/Release/libssh_node.node').resolveConfig || null;
+      } catch {
+        this.nativeResolve = null;
+      }
+    }
+    return this.nativeResolve as NativeResolveConfig | null;
   }
 
   /**
-   * Match hostname against host pattern (supports wildcards)
+   * Match hostname against a Host line: any of its patterns (with * and ?
+   * wildcards) must match and none of its !negated ones
    */
-  private static matchHost(hostname: string, pattern: string): boolean {
-    if (pattern === '*') return true;
-    if (pattern === hostname) return true;
-
-    // Convert SSH pattern to regex
-    const regexPattern = pattern
-      .replace(/\./g, '\\.')
-      .replace(/\*/g, '.*')
-      .replace(/\?/g, '.');
-
-    const regex = new RegExp(`^${regexPattern}$`, 'i');
-    return regex.test(hostname);
+  private static matchHost(hostname: string, patternList: string): boolean {
+    let matcher = this.patterns.get(patternList);
+    if (!matcher) {
+      const compiled = patternList.split(/\s+/).filter(Boolean).map(pattern => {
+        const negated = pattern.startsWith('!');
+        const regexPattern = (negated ? pattern.slice(1) : pattern)
+          .replace(/[.+^${}()|[\]\\]/g, '\\$&')
+          .replace(/\*/g, '.*')
+          .replace(/\?/g, '.');
+        return { negated, regex: new RegExp(`^${regexPattern}$`, 'i') };
+      });
+      matcher = (name: string) => {
+        let matched = false;
+        for (const { negated, regex } of compiled) {
+          if (regex.test(name)) {
+            if (negated) return false;
+            matched = true;
+          }
+        }
+        return matched;
+      };
+      this.patterns.set(patternList, matcher);
+    }
+    return matcher(hostname);
   }
 
   /**
@@ -140,6 +226,45 @@ export class SSHConfigParser {
     }
   }
 
+  /**
+   * Split a ProxyJump value into hops, first hop first: comma separated
+   * [user@]host[:port] or ssh://[user@]host[:port], with IPv6 addresses
+   * in brackets. "none" gives no hops.
+   */
+  static parseProxyJump(value: string): SSHJumpHost[] {
+    if (value.trim().toLowerCase() === 'none') {
+      return [];
+    }
+    return value.split(',').map(part => part.trim()).filter(Boolean).map(spec => {
+      let rest = spec.replace(/^ssh:\/\//, '').replace(/\/$/, '');
+      const hop: SSHJumpHost = { spec, host: rest };
+
+      const at = rest.lastIndexOf('@');
+      if (at >= 0) {
+        hop.user = rest.slice(0, at);
+        rest = rest.slice(at + 1);
+      }
+
+      const bracketed = /^\[([^\]]+)\](?::(\d+))?$/.exec(rest);
+      const colon = rest.indexOf(':');
+      if (bracketed) {
+        hop.host = bracketed[1];
+        rest = bracketed[2] || '';
+      } else if (colon >= 0 && colon === rest.lastIndexOf(':')) {
+        hop.host = rest.slice(0, colon);
+        rest = rest.slice(colon + 1);
+      } else {
+        // A bare IPv6 address has no port
+        hop.host = rest;
+        rest = '';
+      }
+      if (rest) {
+        hop.port = parseInt(rest, 10);
+      }
+      return hop;
+    });
+  }
+
   /**
    * Merge host config with default values
    */
@@ -32,3 +32,10 @@ export class SSHTunnelError extends SSHError {
     this.name = 'SSHTunnelError';
   }
 }
+
+export class SSHSftpError extends SSHError {
+  constructor(message: string) {
+    super(message);
+    this.name = 'SSHSftpError';
+  }
+}
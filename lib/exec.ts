@@ -0,0 +1,90 @@
+import { randomUUID } from 'crypto';
+import { tmpdir } from 'os';
+import { join } from 'path';
+
+/**
+ * How much of each output stream a command keeps. In-memory modes hold at
+ * most `maxBytes` per stream and count the rest; 'file' writes everything
+ * to temp files and returns their paths.
+ */
+export interface CapturePolicy {
+  /** 'head' (default) keeps the first maxBytes, 'tail' the last, 'headTail' half of each */
+  mode?: 'head' | 'tail' | 'headTail' | 'file';
+  /** Bytes kept per stream in memory (default 1MB) */
+  maxBytes?: number;
+  /** Directory for 'file' mode (default os.tmpdir()) */
+  directory?: string;
+}
+
+/**
+ * Cancellation for a single native operation. An aborted operation rejects
+ * with an AbortError (code 'ABORT_ERR'), one past its deadline with code
+ * 'ETIMEDOUT'.
+ */
+export interface OperationOptions {
+  signal?: AbortSignal;
+  /** Give up after this long (ms, default: no limit) */
+  timeoutMs?: number;
+}
+
+/** One command for SSHSession.execMany() */
+export interface ExecCommand {
+  command: string;
+  /** Give up on the command after this long (ms, default: no limit) */
+  timeoutMs?: number;
+  /** Shorthand for `capture: { maxBytes }` */
+  maxOutput?: number;
+  capture?: CapturePolicy;
+}
+
+/** `signal` and `timeoutMs` apply to the whole batch */
+export interface ExecManyOptions extends OperationOptions {
+  /** Commands running at once, each on its own channel (default 8) */
+  concurrency?: number;
+}
+
+/** Options for SSHChannel.exec() */
+export interface ChannelExecOptions {
+  /** Stop the command after this long; it resolves with `timedOut` set */
+  timeoutMs?: number;
+  /** Aborting rejects with an AbortError; the channel stays open */
+  signal?: AbortSignal;
+  capture?: CapturePolicy;
+}
+
+export interface ExecResult {
+  command: string;
+  /** Null if the command was killed by a signal, timed out or never ran */
+  exitCode: number | null;
+  /** Signal name without the SIG prefix, e.g. 'TERM' */
+  signal: string | null;
+  /** Captured output; head and tail are joined in 'headTail' mode */
+  stdout: Buffer;
+  stderr: Buffer;
+  /** Bytes the command wrote, including any that were dropped */
+  stdoutBytes: number;
+  stderrBytes: number;
+  /** Set in 'file' mode */
+  stdoutPath?: string;
+  stderrPath?: string;
+  /** Output went over the capture limit and was cut */
+  truncated: boolean;
+  timedOut: boolean;
+  /** Set when the channel could not be opened or the exec request failed */
+  error?: string;
+}
+
+/**
+ * Turn a capture policy into native options, choosing temp file paths
+ * for 'file' mode
+ */
+export function toNativeCapture(capture?: CapturePolicy): Record<string, unknown> | undefined {
+  if (!capture) {
+    return undefined;
+  }
+  if (capture.mode !== 'file') {
+    return { mode: capture.mode, maxBytes: capture.maxBytes };
+  }
+  const base = join(capture.directory || tmpdir(), `libssh-node-exec-${randomUUID()}`);
+  return { mode: 'file', stdoutPath: `${base}.stdout`, stderrPath: `${base}.stderr` };
+}
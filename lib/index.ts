@@ -1,12 +1,51 @@
-export { SSHSession, SSHSessionOptions, AuthOptions } from './session';
-export { SSHChannel } from './channel';
-export { SSHTunnel, TunnelOptions } from './tunnel';
+export {
+  SSHSession,
+  SSHSessionOptions,
+  AuthOptions,
+  ChannelOpenTarget,
+  SessionStats,
+  ConnectTimings,
+  OperationStats,
+  LatencyHistogram
+} from './session';
+export {
+  SSHChannel,
+  SSHChannelStream,
+  SSHChannelLineStream,
+  ChannelStreamOptions,
+  LineStreamOptions,
+  ChannelStats
+} from './channel';
+export {
+  ExecCommand,
+  ExecManyOptions,
+  ExecResult,
+  CapturePolicy,
+  ChannelExecOptions,
+  OperationOptions
+} from './exec';
+export { SSHSessionPool, SessionPoolOptions, SessionLease, SessionPoolStats } from './pool';
+export {
+  SSHSftp,
+  SftpDirBatch,
+  SftpDirEntry,
+  ReaddirOptions,
+  TransferOptions,
+  TransferResult,
+  TransferJob,
+  TransferManyOptions,
+  TransferManyResult,
+  TransferFileResult
+} from './sftp';
+export { SSHTunnel, TunnelOptions, TunnelStats, TunnelConnectionInfo } from './tunnel';
 export { AgentDetector, AgentInfo } from './agent';
-export { SSHConfigParser, SSHConfigHost } from './config';
+export { CipherProbe, CipherProbeResult } from './crypto';
+export { SSHConfigParser, SSHConfigHost, SSHJumpHost } from './config';
 export {
   SSHError,
   SSHConnectionError,
   SSHAuthenticationError,
   SSHChannelError,
-  SSHTunnelError
+  SSHTunnelError,
+  SSHSftpError
 } from './errors';
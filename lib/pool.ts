@@ -0,0 +1,245 @@
+import { createHash } from 'crypto';
+import { SSHSession, SSHSessionOptions, AuthOptions } from './session';
+import { SSHConnectionError } from './errors';
+
+export interface SessionPoolOptions {
+  /** Close a session this long after its last lease is released (ms, default 30000) */
+  idleTimeout?: number;
+  /** Leases (tunnels, execs, ...) sharing one connection before another is opened (default 10) */
+  maxLeasesPerSession?: number;
+  /**
+   * Open channels on a connection before leases go to another one
+   * (default 10, sshd's default MaxSessions). Counts every channel, exec,
+   * tunnel connection and SFTP session open on it.
+   */
+  maxChannelsPerSession?: number;
+}
+
+export interface SessionLease {
+  session: SSHSession;
+  /** Return the session to the pool; safe to call more than once */
+  release(): void;
+}
+
+export interface SessionPoolStats {
+  sessions: number;
+  leases: number;
+}
+
+// Options already in the key, or that do not change the connection
+const KEYED_APART = new Set(['host', 'hostname', 'port', 'user', 'proxyJump', 'agentSocket', 'jumpPool']);
+
+interface PoolEntry {
+  key: string;
+  session: SSHSession;
+  ready: Promise<void>;
+  connected: boolean;
+  leases: number;
+  idleTimer: NodeJS.Timeout | null;
+}
+
+/**
+ * Shares connected, authenticated sessions between tunnels and execs to the
+ * same host. Sessions are keyed by host, port, user, auth method and every
+ * other session option, so a second tunnel to a known host costs a channel
+ * open instead of a full handshake, and callers with different host key or
+ * algorithm settings never share a connection.
+ */
+export class SSHSessionPool {
+  private idleTimeout: number;
+  private maxLeasesPerSession: number;
+  private maxChannelsPerSession: number;
+  private entries = new Map<string, PoolEntry[]>();
+
+  constructor(options: SessionPoolOptions = {}) {
+    this.idleTimeout = options.idleTimeout ?? 30000;
+    this.maxLeasesPerSession = options.maxLeasesPerSession ?? 10;
+    this.maxChannelsPerSession = options.maxChannelsPerSession ?? 10;
+  }
+
+  /**
+   * Lease a connected, authenticated session, reusing one when possible
+   */
+  async acquire(options: SSHSessionOptions, auth: AuthOptions): Promise<SessionLease> {
+    const key = SSHSessionPool.keyFor(options, auth);
+    const entries = this.entries.get(key) || [];
+    this.entries.set(key, entries);
+
+    // Prune sessions that dropped while idle or leased
+    for (const entry of entries.slice()) {
+      if (entry.connected && !entry.session.isConnected()) {
+        this.remove(entry);
+      }
+    }
+
+    let entry = entries.find(e => e.leases < this.maxLeasesPerSession && !this.atChannelCap(e));
+    if (!entry) {
+      entry = this.open(key, options, auth);
+      entries.push(entry);
+    }
+
+    // Count the lease before the handshake finishes so concurrent callers
+    // share this connection instead of racing to open their own
+    this.lease(entry);
+    try {
+      await entry.ready;
+    } catch (err) {
+      entry.leases--;
+      throw err;
+    }
+
+    return this.createLease(entry);
+  }
+
+  /**
+   * Run `fn` with a leased session, releasing it afterwards
+   */
+  async withSession<T>(
+    options: SSHSessionOptions,
+    auth: AuthOptions,
+    fn: (session: SSHSession) => Promise<T>
+  ): Promise<T> {
+    const lease = await this.acquire(options, auth);
+    try {
+      return await fn(lease.session);
+    } finally {
+      lease.release();
+    }
+  }
+
+  getStats(): SessionPoolStats {
+    let sessions = 0;
+    let leases = 0;
+    for (const entries of this.entries.values()) {
+      sessions += entries.length;
+      for (const entry of entries) {
+        leases += entry.leases;
+      }
+    }
+    return { sessions, leases };
+  }
+
+  /**
+   * Disconnect every pooled session, leased or not
+   */
+  async close(): Promise<void> {
+    const all = Array.from(this.entries.values()).flat();
+    this.entries.clear();
+    await Promise.all(all.map(entry => this.disconnect(entry)));
+  }
+
+  private open(key: string, options: SSHSessionOptions, auth: AuthOptions): PoolEntry {
+    const session = new SSHSession({ ...options });
+    const entry: PoolEntry = {
+      key,
+      session,
+      ready: Promise.resolve(),
+      connected: false,
+      leases: 0,
+      idleTimer: null
+    };
+
+    entry.ready = (async () => {
+      try {
+        await session.connect();
+        await session.authenticate(auth);
+        entry.connected = true;
+      } catch (err) {
+        this.remove(entry);
+        session.disconnect().catch(() => undefined);
+        throw err instanceof Error ? err : new SSHConnectionError(String(err));
+      }
+    })();
+    // Failures are reported to every waiting acquire()
+    entry.ready.catch(() => undefined);
+
+    return entry;
+  }
+
+  // One lease may hold many channels (prewarmed tunnels, execMany), so
+  // the session's own count decides whether it can take more
+  private atChannelCap(entry: PoolEntry): boolean {
+    return entry.connected && entry.session.getStats().channelsOpen >= this.maxChannelsPerSession;
+  }
+
+  private lease(entry: PoolEntry): void {
+    entry.leases++;
+    if (entry.idleTimer) {
+      clearTimeout(entry.idleTimer);
+      entry.idleTimer = null;
+    }
+  }
+
+  private createLease(entry: PoolEntry): SessionLease {
+    let released = false;
+    return {
+      session: entry.session,
+      release: () => {
+        if (released) {
+          return;
+        }
+        released = true;
+        entry.leases--;
+        if (entry.leases === 0) {
+          this.scheduleIdleClose(entry);
+        }
+      }
+    };
+  }
+
+  private scheduleIdleClose(entry: PoolEntry): void {
+    entry.idleTimer = setTimeout(() => {
+      entry.idleTimer = null;
+      if (entry.leases === 0) {
+        this.remove(entry);
+        this.disconnect(entry).catch(() => undefined);
+      }
+    }, this.idleTimeout);
+    // An idle pooled session should not keep the process alive
+    entry.idleTimer.unref();
+  }
+
+  private remove(entry: PoolEntry): void {
+    const entries = this.entries.get(entry.key);
+    if (!entries) {
+      return;
+    }
+    const index = entries.indexOf(entry);
+    if (index >= 0) {
+      entries.splice(index, 1);
+    }
+    if (entries.length === 0) {
+      this.entries.delete(entry.key);
+    }
+  }
+
+  private async disconnect(entry: PoolEntry): Promise<void> {
+    if (entry.idleTimer) {
+      clearTimeout(entry.idleTimer);
+      entry.idleTimer = null;
+    }
+    if (entry.connected) {
+      entry.connected = false;
+      await entry.session.disconnect();
+    }
+  }
+
+  private static keyFor(options: SSHSessionOptions, auth: AuthOptions): string {
+    const host = options.hostname || options.host || '';
+    const port = options.port || 22;
+    const user = auth.username || options.user || '';
+    // Never keep the password itself in the key
+    const method = auth.useAgent
+      ? `agent:${options.agentSocket || ''}`
+      : `password:${createHash('sha256').update(auth.password || '').digest('hex')}`;
+    // The same host reached through other jump hosts is another connection
+    const via = options.proxyJump ? ` via ${options.proxyJump}` : '';
+    // So is one with other known hosts, identities, algorithms, timeouts...
+    const settings = Object.entries(options)
+      .filter(([name, value]) => !KEYED_APART.has(name) && value !== undefined)
+      .sort(([a], [b]) => (a < b ? -1 : a > b ? 1 : 0))
+      .map(([name, value]) => `${name}=${JSON.stringify(value)}`)
+      .join(';');
+    return `${user}@${host}:${port}${via}/${method}/${settings}`;
+  }
+}
@@ -1,5 +1,9 @@
 import { AgentDetector } from './agent';
 import { SSHConfigParser } from './config';
+import { ChannelStats, SSHChannel } from './channel';
+import { CipherProbe } from './crypto';
+import { ExecCommand, ExecManyOptions, ExecResult, OperationOptions, toNativeCapture } from './exec';
+import { SessionLease, SSHSessionPool } from './pool';
 
 // Native module will be loaded
 // eslint-disable-next-line @typescript-eslint/no-var-requires
@@ -14,16 +18,119 @@ export interface SSHSessionOptions {
   agentSocket?: string;
   timeout?: number;
   autoDetectAgent?: boolean;
+
+  /** Algorithm preference lists, most preferred first */
+  ciphers?: string | string[];
+  macs?: string | string[];
+  kex?: string | string[];
+  hostKeyAlgorithms?: string | string[];
+  /**
+   * Order `ciphers` by a one-off local throughput measurement (see
+   * CipherProbe). Ignored when `ciphers` is given.
+   */
+  probeCiphers?: boolean;
+  /** true for zlib when the server supports it; helps on slow links only */
+  compression?: boolean | string;
+  compressionLevel?: number;
+  /** Rekey after this many bytes (0 for the cipher's default) */
+  rekeyData?: number;
+  /** Rekey after this many seconds (0 for never) */
+  rekeyTime?: number;
+  /** Disable Nagle on the connection */
+  nodelay?: boolean;
+  knownHosts?: string;
+  /** Private key file to offer, in addition to the defaults */
+  identity?: string;
+  /**
+   * Resolve the host off the event loop and race TCP connects across its
+   * addresses, IPv6 and IPv4 alternating, 250ms apart (RFC 8305). Defaults
+   * to true; not used with a proxy command, ProxyJump or bindAddress.
+   */
+  happyEyeballs?: boolean;
+  /**
+   * Jump hosts to connect through, as for ssh -J: [user@]host[:port],
+   * comma separated, first hop first, or "none". Defaults to ProxyJump
+   * from ssh_config. The connection rides on a direct-tcpip channel of
+   * the last hop, with no ssh process in between.
+   */
+  proxyJump?: string;
+  /**
+   * Pool the jump sessions come from, authenticated with the agent
+   * (default: one shared by every session in the process, so sessions
+   * behind the same bastion share its connection)
+   */
+  jumpPool?: SSHSessionPool;
 }
 
-export interface AuthOptions {
+/** `signal` and `timeoutMs` cancel the attempt; disconnect() afterwards */
+export interface AuthOptions extends OperationOptions {
   username?: string;
   password?: string;
   useAgent?: boolean;
 }
 
+/** Destination of a direct-tcpip channel opened by openChannels() */
+export interface ChannelOpenTarget {
+  remoteHost: string;
+  remotePort: number;
+  sourceHost?: string;
+  sourcePort?: number;
+}
+
+/**
+ * Durations in power-of-two buckets: buckets[i] counts durations under
+ * 2^i microseconds (the last bucket also takes everything longer)
+ */
+export interface LatencyHistogram {
+  count: number;
+  totalUs: number;
+  maxUs: number;
+  buckets: number[];
+}
+
+/** Timings of one kind of native operation */
+export interface OperationStats {
+  /** From queueing until the reactor thread first ran it */
+  queueWait: LatencyHistogram;
+  /** From its first run until it completed */
+  execute: LatencyHistogram;
+}
+
+/** Phases of the last connect() and authentication, null until run */
+export interface ConnectTimings {
+  resolveMs: number | null;
+  /**
+   * TCP connect race, or the channel open through a jump host; null when
+   * libssh made the connection itself
+   */
+  tcpMs: number | null;
+  /** Key exchange, or the whole connect when tcpMs is null */
+  handshakeMs: number | null;
+  authMs: number | null;
+  /** Address the TCP race connected to */
+  address: string | null;
+  /** TCP connects started */
+  attempts: number;
+}
+
+/** Counters for a session, including its channels, execs and SFTP transfers */
+export interface SessionStats extends ChannelStats {
+  channelsOpened: number;
+  channelOpenFailures: number;
+  /** Channels open right now: channels, execs, tunnel connections, SFTP and jumps through this session */
+  channelsOpen: number;
+  /** By operation name, e.g. connect, open, read, write, download */
+  operations: Record<string, OperationStats>;
+  connect: ConnectTimings;
+}
+
+let defaultJumpPool: SSHSessionPool | null = null;
+
 export class SSHSession {
   private session: typeof binding.SSHSession;
+  private proxyJump?: string;
+  private jumpLease: SessionLease | null = null;
+  private jumpOptions: SSHSessionOptions;
 
   constructor(options: SSHSessionOptions = {}) {
     // Auto-detect SSH agent if requested
@@ -41,41 +148,112 @@ export class SSHSession {
         options.hostname = hostConfig.hostname || options.host;
         options.port = options.port || hostConfig.port;
         options.user = options.user || hostConfig.user;
+        // The jump host makes the connection, so there is nothing to race
+        if (hostConfig.proxyJump && options.happyEyeballs === undefined) {
+          options.happyEyeballs = false;
+        }
+        if (options.proxyJump === undefined) {
+          options.proxyJump = hostConfig.proxyJump;
+        }
       }
     }
 
-    this.session = new binding.SSHSession(options);
+    if (options.probeCiphers && options.ciphers === undefined) {
+      options.ciphers = CipherProbe.preferredCiphers();
+    }
+
+    this.proxyJump = options.proxyJump;
+    // Jump sessions inherit what applies to every hop
+    this.jumpOptions = {
+      agentSocket: options.agentSocket,
+      timeout: options.timeout,
+      jumpPool: options.jumpPool,
+      autoDetectAgent: false
+    };
+
+    // A proxyJump passed on tells the native side not to apply the
+    // config's ProxyJump as well
+    this.session = new binding.SSHSession({ ...options, jumpPool: undefined });
   }
 
   /**
-   * Set a session option
+   * Set a libssh option by name: any SSHSessionOptions field except
+   * configFile, timeout and probeCiphers, plus ciphersClientToServer,
+   * ciphersServerToClient, macsClientToServer, macsServerToClient,
+   * publicKeyAcceptedTypes, compressionClientToServer,
+   * compressionServerToClient, knownHosts, globalKnownHosts, identity,
+   * sshDir, proxyCommand, bindAddress, logVerbosity, strictHostKeyChecking,
+   * processConfig, passwordAuth, publicKeyAuth, kbdintAuth, gssapiAuth and,
+   * with libssh 0.10 or later, identitiesOnly and rsaMinSize.
    */
-  setOption(name: string, value: string | number): void {
+  setOption(name: string, value: string | number | boolean | string[]): void {
     this.session.setOption(name, value);
   }
 
   /**
-   * Connect to the SSH server
+   * Connect to the SSH server, through the proxyJump hosts if any. An
+   * aborted or timed-out connect leaves the session disconnected.
    */
-  async connect(): Promise<void> {
-    return this.session.connect();
+  async connect(options?: OperationOptions): Promise<void> {
+    const hops = this.proxyJump ? SSHConfigParser.parseProxyJump(this.proxyJump) : [];
+    if (hops.length === 0) {
+      return this.session.connect(options);
+    }
+
+    // The last hop reaches the target; it is itself a session that
+    // connects through the hops before it
+    const last = hops[hops.length - 1];
+    const pool = this.jumpOptions.jumpPool || (defaultJumpPool = defaultJumpPool || new SSHSessionPool());
+    const lease = await pool.acquire(
+      {
+        ...this.jumpOptions,
+        host: last.host,
+        port: last.port,
+        user: last.user,
+        proxyJump: hops.slice(0, -1).map(hop => hop.spec).join(',') || 'none'
+      },
+      { useAgent: true, username: last.user }
+    );
+
+    try {
+      await this.connectVia(lease.session, options);
+    } catch (err) {
+      lease.release();
+      throw err;
+    }
+    this.releaseJump();
+    this.jumpLease = lease;
+  }
+
+  /**
+   * Connect over a direct-tcpip channel of `jump`, a connected and
+   * authenticated session, instead of over TCP. The jump session must
+   * stay connected for as long as this one is.
+   */
+  async connectVia(jump: SSHSession, options?: OperationOptions): Promise<void> {
+    return this.session.connectVia(jump.getNativeSession(), options);
   }
 
   /**
    * Disconnect from the SSH server
    */
   async disconnect(): Promise<void> {
-    return this.session.disconnect();
+    try {
+      await this.session.disconnect();
+    } finally {
+      this.releaseJump();
+    }
   }
 
   /**
    * Authenticate using password or agent
    */
   async authenticate(options: AuthOptions): Promise<void> {
+    const cancel = { signal: options.signal, timeoutMs: options.timeoutMs };
     if (options.useAgent) {
-      return this.session.authenticateAgent(options.username || null);
+      return this.session.authenticateAgent(options.username || null, cancel);
     } else if (options.password) {
-      return this.session.authenticatePassword(options.username || null, options.password);
+      return this.session.authenticatePassword(options.username || null, options.password, cancel);
     } else {
       throw new Error('Either password or useAgent must be specified');
     }
@@ -102,6 +280,47 @@ export class SSHSession {
     return this.session.createChannel();
   }
 
+  /**
+   * Open several channels at once: a number opens that many session
+   * channels, an array opens one forward channel per target. All open
+   * requests are sent back-to-back, so a burst costs about one round trip.
+   * Each promise settles as its own confirmation arrives; `options`
+   * applies to every open.
+   */
+  openChannels(targets: number | ChannelOpenTarget[], options?: OperationOptions): Promise<SSHChannel>[] {
+    const list = typeof targets === 'number' ? new Array(targets).fill({}) : targets;
+    const opened: Array<{ channel: typeof binding.SSHChannel; opened: Promise<void> }> =
+      this.session.openChannels(list, options);
+    return opened.map(entry => entry.opened.then(() => new SSHChannel(entry.channel)));
+  }
+
+  /**
+   * Run several commands on concurrent channels. Output is collected
+   * natively and every result arrives in one resolution, in command order.
+   * A failed command is reported in its result rather than rejecting the batch.
+   */
+  async execMany(commands: Array<string | ExecCommand>, options: ExecManyOptions = {}): Promise<ExecResult[]> {
+    const native = commands.map(entry =>
+      typeof entry === 'string' ? entry : { ...entry, capture: toNativeCapture(entry.capture) }
+    );
+    return this.session.execMany(native, options);
+  }
+
+  /**
+   * Traffic and operation timings since the session was created. Reading
+   * them never waits on the reactor, so it is cheap to poll.
+   */
+  getStats(): SessionStats {
+    return this.session.getStats();
+  }
+
+  private releaseJump(): void {
+    if (this.jumpLease) {
+      this.jumpLease.release();
+      this.jumpLease = null;
+    }
+  }
+
   /**
    * Get the native session object (for advanced use)
    */
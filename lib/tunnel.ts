@@ -1,44 +1,98 @@
-import * as net from 'net';
+import { EventEmitter } from 'events';
 import { SSHSession } from './session';
-import { SSHChannel } from './channel';
 import { SSHTunnelError } from './errors';
 
+// eslint-disable-next-line @typescript-eslint/no-var-requires
+const binding = require('../build/Release/libssh_node.node');
+
 export interface TunnelOptions {
   session: SSHSession;
   localHost?: string;
   localPort?: number;
   remoteHost: string;
   remotePort: number;
+  /**
+   * Keep this many forward channels open ahead of time, so an accepted
+   * connection skips the channel-open round trip (default 0)
+   */
+  prewarm?: number;
+}
+
+export interface TunnelStats {
+  activeConnections: number;
+  totalConnections: number;
+  bytesSent: number;
+  bytesReceived: number;
+  /** Bytes held in the tunnel's own buffers, in both directions */
+  bufferedBytes: number;
+  /** Pre-opened forward channels waiting for a connection */
+  warmChannels: number;
+}
+
+/** Gauges for one forwarded connection */
+export interface TunnelConnectionInfo {
+  id: number;
+  address: string;
+  port: number;
+  /** False while the forward channel is still being opened */
+  open: boolean;
+  bytesSent: number;
+  bytesReceived: number;
+  /** Read from the channel, waiting for the client socket to accept it */
+  bufferedToLocal: number;
+  /** Read from the client, waiting for remote window */
+  bufferedToRemote: number;
+  /** Received by libssh but not yet pulled by the tunnel */
+  channelBuffered: number;
+  /** Bytes the server is currently willing to accept */
+  remoteWindow: number;
 }
 
-interface ChannelMapping {
-  channel: SSHChannel;
-  socket: net.Socket;
+interface NativeTunnelEvent {
+  type: 'connection' | 'close' | 'error';
+  id: number;
+  address?: string;
+  port?: number;
+  bytesSent?: number;
+  bytesReceived?: number;
+  message?: string;
 }
 
-export class SSHTunnel {
+/**
+ * Local port forward over an SSH session.
+ *
+ * The listening socket and all forwarded connections are owned by the
+ * native tunnel engine, which moves bytes between sockets and channels on
+ * its own thread. Only lifecycle events reach JS:
+ *
+ * - `connection` (id, address, port) once the forward channel is open
+ * - `close` (id, bytesSent, bytesReceived, error?) when a connection ends
+ * - `error` (Error) for failures not tied to a single connection
+ */
+export class SSHTunnel extends EventEmitter {
   private session: SSHSession;
   private localHost: string;
   private localPort: number;
   private remoteHost: string;
   private remotePort: number;
-  private server: net.Server | null = null;
-  private channels: Map<number, ChannelMapping> = new Map();
-  private channelIdCounter = 0;
+  private prewarm: number;
+  private tunnel: typeof binding.SSHTunnel | null = null;
 
   constructor(options: TunnelOptions) {
+    super();
     this.session = options.session;
     this.localHost = options.localHost || '127.0.0.1';
     this.localPort = options.localPort || 0; // 0 means auto-assign
     this.remoteHost = options.remoteHost;
     this.remotePort = options.remotePort;
+    this.prewarm = options.prewarm || 0;
   }
 
   /**
    * Start the SSH tunnel
    */
   async start(): Promise<void> {
-    if (this.server) {
+    if (this.tunnel) {
       throw new SSHTunnelError('Tunnel is already started');
     }
 
@@ -46,189 +100,116 @@ export class SSHTunnel {
       throw new SSHTunnelError('SSH session is not connected');
     }
 
-    return new Promise((resolve, reject) => {
-      this.server = net.createServer((socket) => {
-        this.handleConnection(socket).catch((err) => {
-          console.error('Error handling connection:', err);
-          socket.destroy();
-        });
-      });
+    const tunnel = new binding.SSHTunnel(this.session.getNativeSession(), {
+      localHost: this.localHost,
+      localPort: this.localPort,
+      remoteHost: this.remoteHost,
+      remotePort: this.remotePort,
+      prewarm: this.prewarm
+    });
 
-      this.server.on('error', (err) => {
-        reject(new SSHTunnelError(`Server error: ${err.message}`));
-      });
+    try {
+      this.localPort = tunnel.start((event: NativeTunnelEvent) => this.handleEvent(event));
+    } catch (err) {
+      throw new SSHTunnelError(`Server error: ${(err as Error).message}`);
+    }
 
-      this.server.listen(this.localPort, this.localHost, () => {
-        const address = this.server!.address() as net.AddressInfo;
-        this.localPort = address.port;
-        resolve();
-      });
-    });
+    this.tunnel = tunnel;
   }
 
   /**
-   * Stop the SSH tunnel
+   * Stop the SSH tunnel, closing every forwarded connection
    */
   async stop(): Promise<void> {
-    if (!this.server) {
+    if (!this.tunnel) {
       return;
     }
 
-    // Close all active channels
-    for (const [id, mapping] of this.channels.entries()) {
-      try {
-        mapping.socket.destroy();
-        await mapping.channel.close();
-      } catch (err) {
-        console.error(`Error closing channel ${id}:`, err);
-      }
-    }
-    this.channels.clear();
-
-    // Close the server
-    return new Promise((resolve, reject) => {
-      this.server!.close((err) => {
-        if (err) {
-          reject(new SSHTunnelError(`Failed to close server: ${err.message}`));
-        } else {
-          this.server = null;
-          resolve();
-        }
-      });
-    });
+    const tunnel = this.tunnel;
+    this.tunnel = null;
+    await tunnel.stop();
   }
 
   /**
    * Get local address information
    */
   getLocalAddress(): { host: string; port: number } | null {
-    if (!this.server || !this.server.listening) {
+    if (!this.tunnel) {
       return null;
     }
 
-    const address = this.server.address() as net.AddressInfo;
     return {
-      host: address.address,
-      port: address.port
+      host: this.localHost,
+      port: this.localPort
     };
   }
 
   /**
-   * Handle new client connection
+   * Get number of active connections
    */
-  private async handleConnection(socket: net.Socket): Promise<void> {
-    const channelId = this.channelIdCounter++;
-
-    try {
-      // Create SSH channel
-      const nativeChannel = this.session.createChannel();
-      const channel = new SSHChannel(nativeChannel);
-
-      // Open forwarded channel
-      await channel.requestForwardTcpIp(
-        this.remoteHost,
-        this.remotePort,
-        socket.remoteAddress || '127.0.0.1',
-        socket.remotePort || 0
-      );
-
-      // Store channel mapping
-      this.channels.set(channelId, { channel, socket });
-
-      // Set up bidirectional data forwarding
-      this.setupDataForwarding(channelId, channel, socket);
-
-    } catch (err) {
-      console.error(`Failed to create channel ${channelId}:`, err);
-      socket.destroy();
-      this.channels.delete(channelId);
-    }
+  getActiveConnectionCount(): number {
+    return this.getStats().activeConnections;
   }
 
   /**
-   * Set up bidirectional data forwarding between socket and channel
+   * Get connection and byte counters from the native tunnel engine
    */
-  private setupDataForwarding(channelId: number, channel: SSHChannel, socket: net.Socket): void {
-    const isForwarding = true;
-
-    // Socket -> Channel
-    socket.on('data', async (data) => {
-      if (!isForwarding) return;
-
-      try {
-        await channel.write(data);
-      } catch (err) {
-        console.error(`Error writing to channel ${channelId}:`, err);
-        this.closeConnection(channelId);
-      }
-    });
-
-    // Channel -> Socket
-    const readLoop = async () => {
-      while (isForwarding && channel.isOpen()) {
-        try {
-          const data = await channel.read();
-          if (data.length > 0) {
-            socket.write(data);
-          } else {
-            // EOF
-            break;
-          }
-        } catch (err) {
-          console.error(`Error reading from channel ${channelId}:`, err);
-          break;
-        }
-      }
-
-      this.closeConnection(channelId);
-    };
-
-    readLoop();
-
-    // Handle socket close
-    socket.on('close', () => {
-      this.closeConnection(channelId);
-    });
+  getStats(): TunnelStats {
+    if (!this.tunnel) {
+      return { activeConnections: 0, totalConnections: 0, bytesSent: 0, bytesReceived: 0, bufferedBytes: 0, warmChannels: 0 };
+    }
 
-    socket.on('error', (err) => {
-      console.error(`Socket error for channel ${channelId}:`, err);
-      this.closeConnection(channelId);
-    });
+    return this.tunnel.getStats();
   }
 
   /**
-   * Close a specific connection
+   * Snapshot buffered-byte gauges for every open connection
    */
-  private async closeConnection(channelId: number): Promise<void> {
-    const mapping = this.channels.get(channelId);
-    if (!mapping) return;
-
-    this.channels.delete(channelId);
-
-    try {
-      mapping.socket.destroy();
-    } catch (err) {
-      // Ignore errors when closing socket
+  async getConnections(): Promise<TunnelConnectionInfo[]> {
+    if (!this.tunnel) {
+      return [];
     }
 
-    try {
-      await mapping.channel.close();
-    } catch (err) {
-      // Ignore errors when closing channel
-    }
+    return this.tunnel.getConnections();
   }
 
   /**
-   * Get number of active connections
+   * Check if tunnel is running
    */
-  getActiveConnectionCount(): number {
-    return this.channels.size;
+  isRunning(): boolean {
+    return this.tunnel !== null && this.tunnel.isRunning();
   }
 
   /**
-   * Check if tunnel is running
+   * Translate native lifecycle events into EventEmitter events
    */
-  isRunning(): boolean {
-    return this.server !== null && this.server.listening;
+  private handleEvent(event: NativeTunnelEvent): void {
+    switch (event.type) {
+      case 'connection':
+        this.emit('connection', { id: event.id, address: event.address, port: event.port });
+        break;
+      case 'close':
+        this.emit('close', {
+          id: event.id,
+          bytesSent: event.bytesSent,
+          bytesReceived: event.bytesReceived,
+          error: event.message ? new SSHTunnelError(event.message) : undefined
+        });
+        break;
+      case 'error': {
+        const error = new SSHTunnelError(event.message || 'Tunnel error');
+        if (this.listenerCount('error') > 0) {
+          this.emit('error', error);
+        } else {
+          console.error('SSH tunnel error:', error);
+        }
+
+        // The engine exits on fatal errors; release it so start() can be retried
+        if (this.tunnel && !this.tunnel.isRunning()) {
+          this.stop().catch(() => undefined);
+        }
+        break;
+      }
+    }
   }
 }
@@ -0,0 +1,20 @@
+#ifndef LIBSSH_NODE_ADDON_DATA_H
+#define LIBSSH_NODE_ADDON_DATA_H
+
+#include <napi.h>
+#include <memory>
+#include "reactor.h"
+
+namespace libssh_node {
+
+// Per-environment state, stored with env.SetInstanceData()
+struct AddonData {
+  Napi::FunctionReference sessionConstructor;
+  Napi::FunctionReference channelConstructor;
+  Napi::FunctionReference sftpConstructor;
+  std::shared_ptr<Reactor> reactor;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_ADDON_DATA_H
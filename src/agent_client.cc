@@ -0,0 +1,513 @@
+#include "agent_client.h"
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace libssh_node {
+
+namespace {
+
+// Agent protocol (draft-miller-ssh-agent)
+constexpr uint8_t kAgentFailure = 5;
+constexpr uint8_t kRequestIdentities = 11;
+constexpr uint8_t kIdentitiesAnswer = 12;
+constexpr uint8_t kSignRequest = 13;
+constexpr uint32_t kMaxMessage = 256 * 1024;
+
+// Keys added to or removed from the agent show up after this long at
+// the latest; a failed signature or login refreshes the list at once
+constexpr auto kIdentityTtl = std::chrono::seconds(30);
+
+// A hardware key waiting for a touch can take a while to sign
+constexpr int kAgentTimeoutSec = 120;
+
+uint32_t GetU32(const std::string& data, size_t offset) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data()) + offset;
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+void PutU32(std::string& data, uint32_t value) {
+  data.push_back(static_cast<char>(value >> 24));
+  data.push_back(static_cast<char>(value >> 16));
+  data.push_back(static_cast<char>(value >> 8));
+  data.push_back(static_cast<char>(value));
+}
+
+void PutString(std::string& data, const std::string& value) {
+  PutU32(data, static_cast<uint32_t>(value.size()));
+  data += value;
+}
+
+// Reads a length-prefixed string at offset, advancing it
+bool GetString(const std::string& data, size_t& offset, std::string& value) {
+  if (data.size() < offset + 4) {
+    return false;
+  }
+  uint32_t length = GetU32(data, offset);
+  if (data.size() - offset - 4 < length) {
+    return false;
+  }
+  value = data.substr(offset + 4, length);
+  offset += 4 + length;
+  return true;
+}
+
+std::string Failure() {
+  return std::string(1, static_cast<char>(kAgentFailure));
+}
+
+socket_t ConnectAgent(const std::string& path) {
+#ifdef _WIN32
+  // libssh only supports agents over Unix sockets
+  (void)path;
+  return SSH_INVALID_SOCKET;
+#else
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  if (path.size() >= sizeof(addr.sun_path)) {
+    return SSH_INVALID_SOCKET;
+  }
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+  socket_t fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == SSH_INVALID_SOCKET) {
+    return SSH_INVALID_SOCKET;
+  }
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+    CloseSocket(fd);
+    return SSH_INVALID_SOCKET;
+  }
+
+  struct timeval timeout;
+  timeout.tv_sec = kAgentTimeoutSec;
+  timeout.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  return fd;
+#endif
+}
+
+// Blocking socket I/O for the agent connection
+bool SendAll(socket_t fd, const char* data, size_t length) {
+  while (length > 0) {
+    int sent = send(fd, data, static_cast<int>(length), 0);
+    if (sent <= 0) {
+      return false;
+    }
+    data += sent;
+    length -= static_cast<size_t>(sent);
+  }
+  return true;
+}
+
+bool ReceiveAll(socket_t fd, char* data, size_t length) {
+  while (length > 0) {
+    int received = recv(fd, data, static_cast<int>(length), 0);
+    if (received <= 0) {
+      return false;
+    }
+    data += received;
+    length -= static_cast<size_t>(received);
+  }
+  return true;
+}
+
+} // namespace
+
+AgentClient& AgentClient::Get() {
+  // Never destroyed: the proxy and agent threads run for the life of the
+  // process
+  static AgentClient* client = new AgentClient();
+  return *client;
+}
+
+AgentClient::AgentClient()
+    : running_(false), wake_{SSH_INVALID_SOCKET, SSH_INVALID_SOCKET}, nextId_(1), agentRunning_(false) {}
+
+socket_t AgentClient::Attach(const std::string& agentPath, uint64_t* id) {
+  socket_t pair[2];
+  if (!CreateSocketPair(pair)) {
+    return SSH_INVALID_SOCKET;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!running_) {
+    if (!CreateSocketPair(wake_)) {
+      CloseSocket(pair[0]);
+      CloseSocket(pair[1]);
+      return SSH_INVALID_SOCKET;
+    }
+    running_ = true;
+    std::thread([this]() { Run(); }).detach();
+  }
+
+  *id = nextId_++;
+  logins_[*id].agentPath = agentPath;
+  pending_.push_back({*id, pair[1], ""});
+  SignalWake(wake_[1]);
+  return pair[0];
+}
+
+void AgentClient::Begin(uint64_t id, const std::string& target, std::shared_ptr<AgentWake> wake) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = logins_.find(id);
+  if (found == logins_.end()) {
+    return;
+  }
+  Login& login = found->second;
+  login.target = target;
+  login.lastSigned.clear();
+  login.wake = std::move(wake);
+  login.listing = true;
+  login.listed = false;
+  login.identities.clear();
+  login.first.clear();
+  login.deferred = false;
+  login.signRequest.clear();
+  login.signReply.clear();
+  Queue({id, login.agentPath, ""});
+}
+
+void AgentClient::Finish(uint64_t id, bool succeeded) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto login = logins_.find(id);
+  if (login == logins_.end()) {
+    return;
+  }
+  if (succeeded && !login->second.lastSigned.empty()) {
+    preferred_[login->second.target] = login->second.lastSigned;
+  } else if (!succeeded) {
+    // Perhaps the right key was added since the list was cached
+    caches_[login->second.agentPath].valid = false;
+  }
+  login->second.wake.reset();
+}
+
+bool AgentClient::Ready(uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto login = logins_.find(id);
+  return login == logins_.end() || (!login->second.listing && !login->second.signing);
+}
+
+bool AgentClient::Deferred(uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto login = logins_.find(id);
+  if (login == logins_.end() || !login->second.deferred) {
+    return false;
+  }
+  login->second.deferred = false;
+  return true;
+}
+
+void AgentClient::Run() {
+  std::vector<struct pollfd> fds;
+  for (;;) {
+    fds.clear();
+    fds.push_back({wake_[0], POLLIN, 0});
+    for (const Client& client : clients_) {
+      fds.push_back({client.fd, POLLIN, 0});
+    }
+
+#ifdef _WIN32
+    int ready = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), -1);
+#else
+    int ready = poll(fds.data(), fds.size(), -1);
+#endif
+    if (ready <= 0) {
+      continue;
+    }
+
+    // Clients that attached since the last poll are only looked at on
+    // the next one, so fds stays in step with clients_ below
+    std::vector<Client> attached;
+    if (fds[0].revents != 0) {
+      DrainWake(wake_[0]);
+      std::lock_guard<std::mutex> lock(mutex_);
+      attached.swap(pending_);
+    }
+
+    std::vector<Client> open;
+    for (size_t i = 0; i < clients_.size(); i++) {
+      if (fds[i + 1].revents == 0 || ReadClient(clients_[i])) {
+        open.push_back(std::move(clients_[i]));
+        continue;
+      }
+      CloseSocket(clients_[i].fd);
+      std::lock_guard<std::mutex> lock(mutex_);
+      logins_.erase(clients_[i].id);
+    }
+    clients_.swap(open);
+    for (Client& client : attached) {
+      clients_.push_back(std::move(client));
+    }
+  }
+}
+
+// Handles every complete request from the client. False once the client
+// has gone or sent something that is not the agent protocol.
+bool AgentClient::ReadClient(Client& client) {
+  char buffer[16384];
+  for (;;) {
+    int received = recv(client.fd, buffer, sizeof(buffer), 0);
+    if (received > 0) {
+      client.input.append(buffer, static_cast<size_t>(received));
+      continue;
+    }
+    if (received < 0 && SocketWouldBlock()) {
+      break;
+    }
+    return false;
+  }
+
+  while (client.input.size() >= 4) {
+    uint32_t length = GetU32(client.input, 0);
+    if (length == 0 || length > kMaxMessage) {
+      return false;
+    }
+    if (client.input.size() < 4 + length) {
+      break;
+    }
+    std::string message = client.input.substr(4, length);
+    client.input.erase(0, 4 + length);
+    Handle(client, message);
+  }
+  return true;
+}
+
+// Answers from what the agent thread has already fetched; libssh waits
+// for the reply on the reactor thread
+void AgentClient::Handle(const Client& client, const std::string& message) {
+  std::string reply = Failure();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = logins_.find(client.id);
+    uint8_t type = static_cast<uint8_t>(message[0]);
+    if (found != logins_.end() && type == kRequestIdentities && found->second.listed) {
+      const Login& login = found->second;
+      reply = std::string(1, static_cast<char>(kIdentitiesAnswer));
+      PutU32(reply, static_cast<uint32_t>(login.identities.size()));
+      for (int pass = 0; pass < 2; pass++) {
+        for (const Identity& identity : login.identities) {
+          if ((identity.blob == login.first) == (pass == 0)) {
+            PutString(reply, identity.blob);
+            PutString(reply, identity.comment);
+          }
+        }
+      }
+    } else if (found != logins_.end() && type == kSignRequest) {
+      reply = Sign(client.id, message);
+    }
+  }
+  Reply(client.fd, reply);
+}
+
+// The signature the agent thread fetched for this very request, or
+// Failure() while it is being fetched
+std::string AgentClient::Sign(uint64_t id, const std::string& message) {
+  Login& login = logins_[id];
+  size_t offset = 1;
+  std::string blob;
+  if (!GetString(message, offset, blob)) {
+    return Failure();
+  }
+
+  if (!login.signRequest.empty() && login.signRequest == message) {
+    std::string reply;
+    reply.swap(login.signReply);
+    login.signRequest.clear();
+    if (static_cast<uint8_t>(reply[0]) != kAgentFailure) {
+      login.lastSigned = blob;
+    }
+    return reply;
+  }
+  if (!login.signing) {
+    // The retry tries this key first, so libssh asks for the same
+    // signature again
+    login.signing = true;
+    login.first = blob;
+    Queue({id, login.agentPath, message});
+  }
+  login.deferred = true;
+  return Failure();
+}
+
+void AgentClient::Queue(Job job) {
+  if (!agentRunning_) {
+    agentRunning_ = true;
+    std::thread([this]() { RunAgent(); }).detach();
+  }
+  jobs_.push_back(std::move(job));
+  jobsReady_.notify_one();
+}
+
+// Agent thread: the only one that waits for agents
+void AgentClient::RunAgent() {
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      jobsReady_.wait(lock, [this]() { return !jobs_.empty(); });
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    if (job.message.empty()) {
+      List(job);
+    } else {
+      SignWithAgent(job);
+    }
+  }
+}
+
+void AgentClient::List(const Job& job) {
+  std::vector<Identity> identities;
+  bool listed = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    IdentityCache& cache = caches_[job.agentPath];
+    if (cache.valid && std::chrono::steady_clock::now() - cache.listed < kIdentityTtl) {
+      identities = cache.identities;
+      listed = true;
+    }
+  }
+
+  if (!listed) {
+    std::string reply = Forward(job.agentPath, std::string(1, static_cast<char>(kRequestIdentities)));
+    if (static_cast<uint8_t>(reply[0]) == kIdentitiesAnswer && reply.size() >= 5) {
+      uint32_t count = GetU32(reply, 1);
+      size_t offset = 5;
+      listed = true;
+      for (uint32_t i = 0; i < count && listed; i++) {
+        Identity identity;
+        listed = GetString(reply, offset, identity.blob) && GetString(reply, offset, identity.comment);
+        identities.push_back(std::move(identity));
+      }
+    }
+    if (listed) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      IdentityCache& cache = caches_[job.agentPath];
+      cache.identities = identities;
+      cache.listed = std::chrono::steady_clock::now();
+      cache.valid = true;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = logins_.find(job.id);
+  if (found == logins_.end()) {
+    return;
+  }
+  Login& login = found->second;
+  login.listing = false;
+  login.listed = listed;
+  if (listed) {
+    login.identities = std::move(identities);
+    auto preferred = preferred_.find(login.target);
+    if (preferred != preferred_.end()) {
+      login.first = preferred->second;
+    }
+  }
+  Wake(job.id);
+}
+
+void AgentClient::SignWithAgent(const Job& job) {
+  std::string reply = Forward(job.agentPath, job.message);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (static_cast<uint8_t>(reply[0]) == kAgentFailure) {
+    // The key may have been removed from the agent
+    caches_[job.agentPath].valid = false;
+  }
+  auto found = logins_.find(job.id);
+  if (found == logins_.end()) {
+    return;
+  }
+  found->second.signing = false;
+  found->second.signRequest = job.message;
+  found->second.signReply = std::move(reply);
+  Wake(job.id);
+}
+
+void AgentClient::Wake(uint64_t id) {
+  const std::shared_ptr<AgentWake>& wake = logins_[id].wake;
+  if (wake) {
+    SignalWake(wake->fds[1]);
+  }
+}
+
+// One request/response with the agent, reconnecting once if the kept
+// connection has gone stale. Failure() if the agent cannot be reached.
+std::string AgentClient::Forward(const std::string& agentPath, const std::string& message) {
+  std::string reply;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    auto open = agents_.find(agentPath);
+    socket_t fd = open != agents_.end() ? open->second : SSH_INVALID_SOCKET;
+    if (fd == SSH_INVALID_SOCKET) {
+      fd = ConnectAgent(agentPath);
+      if (fd == SSH_INVALID_SOCKET) {
+        break;
+      }
+      agents_[agentPath] = fd;
+
+      // A new connection may be to a restarted agent with other keys
+      std::lock_guard<std::mutex> lock(mutex_);
+      caches_[agentPath].valid = false;
+    }
+    if (Exchange(fd, message, reply)) {
+      return reply;
+    }
+    CloseSocket(fd);
+    agents_.erase(agentPath);
+  }
+  return Failure();
+}
+
+bool AgentClient::Exchange(socket_t fd, const std::string& message, std::string& reply) {
+  std::string frame;
+  PutString(frame, message);
+  if (!SendAll(fd, frame.data(), frame.size())) {
+    return false;
+  }
+
+  char header[4];
+  if (!ReceiveAll(fd, header, sizeof(header))) {
+    return false;
+  }
+  uint32_t length = GetU32(std::string(header, sizeof(header)), 0);
+  if (length == 0 || length > kMaxMessage) {
+    return false;
+  }
+  reply.resize(length);
+  return ReceiveAll(fd, &reply[0], length);
+}
+
+void AgentClient::Reply(socket_t fd, const std::string& message) {
+  std::string frame;
+  PutString(frame, message);
+
+  // The client socket is non-blocking; libssh reads the reply at once
+  size_t offset = 0;
+  while (offset < frame.size()) {
+    int sent = send(fd, frame.data() + offset, static_cast<int>(frame.size() - offset), 0);
+    if (sent > 0) {
+      offset += static_cast<size_t>(sent);
+      continue;
+    }
+    if (sent < 0 && SocketWouldBlock()) {
+      struct pollfd pfd = {fd, POLLOUT, 0};
+#ifdef _WIN32
+      WSAPoll(&pfd, 1, 1000);
+#else
+      poll(&pfd, 1, 1000);
+#endif
+      continue;
+    }
+    return;
+  }
+}
+
+} // namespace libssh_node
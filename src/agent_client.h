@@ -0,0 +1,144 @@
+#ifndef LIBSSH_NODE_AGENT_CLIENT_H
+#define LIBSSH_NODE_AGENT_CLIENT_H
+
+#include <libssh/libssh.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "socket_util.h"
+
+namespace libssh_node {
+
+// Socketpair signalled whenever agent work for a login completes;
+// fds[0] sits in the reactor's event. Shared with the agent thread, so a
+// late signal never lands on a closed socket.
+struct AgentWake {
+  socket_t fds[2] = {SSH_INVALID_SOCKET, SSH_INVALID_SOCKET};
+
+  ~AgentWake() {
+    CloseSocket(fds[0]);
+    CloseSocket(fds[1]);
+  }
+};
+
+// Process-wide front for ssh-agents. Each session talks to it over its
+// own socketpair (ssh_set_agent_socket()). libssh reads the answers on
+// that socket blocking, from the reactor thread, so the proxy thread
+// answers every request at once and never waits for an agent:
+//   - Begin() has the agent thread list the agent's keys, from a cache
+//     refreshed after kIdentityTtl, a failed signature or a failed
+//     login. The key that last logged in to the same user@host:port is
+//     listed first, so libssh's agent authentication tries it first.
+//   - A signature not signed yet is refused at once while the agent
+//     thread asks the agent for it. Deferred() tells the caller to run
+//     ssh_userauth_agent() again once Ready(); the same request is then
+//     answered with the kept signature.
+// Only the agent thread talks to agents, over one connection per agent
+// kept open across sessions. Other requests are refused.
+class AgentClient {
+public:
+  static AgentClient& Get();
+
+  // Reactor thread. A socket speaking the agent protocol for the agent
+  // at agentPath, for ssh_set_agent_socket(), or SSH_INVALID_SOCKET. The
+  // proxy forgets it once libssh closes its end.
+  socket_t Attach(const std::string& agentPath, uint64_t* id);
+
+  // Reactor thread, around each ssh_userauth_agent() run on the socket.
+  // wake is signalled as agent work for the login completes.
+  void Begin(uint64_t id, const std::string& target, std::shared_ptr<AgentWake> wake);
+  void Finish(uint64_t id, bool succeeded);
+
+  // Reactor thread. False while the agent thread is listing keys or
+  // signing for the login: ssh_userauth_agent() would wait for it.
+  bool Ready(uint64_t id);
+  // Reactor thread, after ssh_userauth_agent() failed. True once per
+  // signature the proxy refused because it was not signed yet.
+  bool Deferred(uint64_t id);
+
+private:
+  struct Identity {
+    std::string blob;
+    std::string comment;
+  };
+
+  // Shared with the reactor and agent threads, under mutex_
+  struct Login {
+    std::string agentPath;
+    std::string target;     // user@host:port
+    std::string lastSigned; // Key blob of the last signature handed out
+    std::shared_ptr<AgentWake> wake;
+
+    bool listing = false;
+    bool listed = false;
+    std::vector<Identity> identities;
+    std::string first; // Key blob listed ahead of the others
+
+    bool signing = false;
+    bool deferred = false;
+    std::string signRequest; // Signed, not yet handed out
+    std::string signReply;
+  };
+
+  // Agent thread work
+  struct Job {
+    uint64_t id;
+    std::string agentPath;
+    std::string message; // Sign request, or empty to list keys
+  };
+
+  struct IdentityCache {
+    std::vector<Identity> identities;
+    std::chrono::steady_clock::time_point listed;
+    bool valid = false;
+  };
+
+  // Proxy thread only
+  struct Client {
+    uint64_t id;
+    socket_t fd;
+    std::string input;
+  };
+
+  AgentClient();
+
+  void Run();
+  bool ReadClient(Client& client);
+  void Handle(const Client& client, const std::string& message);
+  std::string Sign(uint64_t id, const std::string& message); // Under mutex_
+  void Queue(Job job);                                       // Under mutex_
+
+  void RunAgent();
+  void List(const Job& job);
+  void SignWithAgent(const Job& job);
+  void Wake(uint64_t id); // Under mutex_
+  std::string Forward(const std::string& agentPath, const std::string& message);
+  bool Exchange(socket_t fd, const std::string& message, std::string& reply);
+  void Reply(socket_t fd, const std::string& message);
+
+  std::mutex mutex_;
+  bool running_;
+  socket_t wake_[2];
+  uint64_t nextId_;
+  std::vector<Client> pending_;                  // Attached, not yet polled
+  std::map<uint64_t, Login> logins_;
+  std::map<std::string, IdentityCache> caches_;  // By agent path
+  std::map<std::string, std::string> preferred_; // Target -> key blob
+  std::deque<Job> jobs_;
+  std::condition_variable jobsReady_;
+  bool agentRunning_;
+
+  std::vector<Client> clients_;            // Proxy thread
+  std::map<std::string, socket_t> agents_; // Agent thread: open agent connections
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_AGENT_CLIENT_H
@@ -1,47 +1,259 @@
 #include "async_workers.h"
+#include "agent_client.h"
+#include "ssh_config.h"
+#include "ssh_session.h"
 #include "utils.h"
+#include <cstdlib>
 
 namespace libssh_node {
 
+namespace {
+
+// Agent attempts re-run once a signature the proxy deferred is ready.
+// Each retry starts on the key that was being signed, so one is enough
+// unless the server turns that key down in between.
+constexpr int kMaxAgentRetries = 3;
+
+int OnAgentReady(socket_t fd, int, void*) {
+  DrainWake(fd);
+  return 0;
+}
+
+} // namespace
+
 // Base SSHAsyncWorker
-SSHAsyncWorker::SSHAsyncWorker(Napi::Env env, ssh_session session)
-    : Napi::AsyncWorker(env), session_(session), result_(SSH_ERROR) {}
+SSHAsyncWorker::SSHAsyncWorker(Napi::Env env, SSHSession* session, const char* operation)
+    : ReactorWorker(env, session->Value(), session->stats_->operations.Get(operation)),
+      owner_(session), session_(session->session_), io_(&session->stats_->io),
+      sessionStats_(session->stats_.get()), result_(SSH_ERROR) {}
 
 // ConnectWorker
-ConnectWorker::ConnectWorker(Napi::Env env, ssh_session session, const Napi::Promise::Deferred& deferred)
-    : SSHAsyncWorker(env, session), deferred_(deferred) {}
+ConnectWorker::ConnectWorker(Napi::Env env, SSHSession* session, const Napi::Promise::Deferred& deferred,
+                             SSHSession* jump)
+    : SSHAsyncWorker(env, session, "connect"), deferred_(deferred), timeoutMs_(session->timeoutMs_),
+      started_(std::chrono::steady_clock::now()), viaJump_(jump != nullptr), jumpOpen_(false), handshakeStarted_(started_) {
+  // ssh_connect() would parse the default config files itself; doing it
+  // here reads them from the cache, and means their HostName, Port and
+  // ProxyCommand are the ones raced below
+  if (!session->configProcessed_) {
+    session->ApplyConfig({SSHConfig::UserConfigPath(), SSHConfig::GlobalConfigPath()});
+  }
+
+  char* host = nullptr;
+  unsigned int port = 22;
+  if (jump != nullptr) {
+    // The jump host resolves and connects; libssh takes the channel's
+    // socket in place of ProxyCommand or its own connect
+    if (ssh_options_get(session_, SSH_OPTIONS_HOST, &host) == SSH_OK) {
+      ssh_options_get_port(session_, &port);
+      jump_ = std::make_shared<JumpTransport>(session->reactor_.get(), jump->session_, jump->stats_, host,
+                                              static_cast<int>(port));
+      ssh_string_free_char(host);
+    }
+    jumpRef_ = Napi::Persistent(jump->Value());
+    return;
+  }
+  if (!session->happyEyeballs_ || session->bindAddress_ || session->proxyJump_) {
+    return;
+  }
+
+  // A proxy command makes its own connection
+  char* proxyCommand = nullptr;
+  if (ssh_options_get(session_, SSH_OPTIONS_PROXYCOMMAND, &proxyCommand) == SSH_OK) {
+    ssh_string_free_char(proxyCommand);
+    return;
+  }
+
+  if (ssh_options_get(session_, SSH_OPTIONS_HOST, &host) != SSH_OK) {
+    return;
+  }
+  ssh_options_get_port(session_, &port);
+  eyeballs_ = std::make_unique<HappyEyeballs>(host, static_cast<int>(port));
+  ssh_string_free_char(host);
+}
+
+bool ConnectWorker::TimedOut() {
+  // libssh does not apply SSH_OPTIONS_TIMEOUT in non-blocking mode
+  auto elapsed = std::chrono::steady_clock::now() - started_;
+  if (timeoutMs_ > 0 && elapsed > std::chrono::milliseconds(timeoutMs_)) {
+    result_ = SSH_ERROR;
+    errorMessage_ = "Connection timed out";
+    return true;
+  }
+  return false;
+}
+
+int ConnectWorker::ConnectSocket() {
+  int result = eyeballs_->Step(reactor()->event());
+  if (result == SSH_AGAIN && !TimedOut()) {
+    return SSH_AGAIN;
+  }
+
+  eyeballs_->Finish();
+  timings_.resolveMs = eyeballs_->resolveMs();
+  timings_.attempts = static_cast<int>(eyeballs_->attempts());
+  if (result != SSH_OK) {
+    if (result == SSH_ERROR) {
+      result_ = SSH_ERROR;
+      errorMessage_ = eyeballs_->error().empty() ? "Connection failed" : eyeballs_->error();
+    }
+    eyeballs_.reset();
+    return result_;
+  }
+
+  timings_.tcpMs = eyeballs_->connectMs();
+  timings_.address = eyeballs_->address();
+  socket_t fd = eyeballs_->TakeSocket();
+  eyeballs_.reset();
+
+  // libssh owns the socket from here and closes it on disconnect
+  if (ssh_options_set(session_, SSH_OPTIONS_FD, &fd) != SSH_OK) {
+    CloseSocket(fd);
+    result_ = SSH_ERROR;
+    errorMessage_ = "Failed to hand the connected socket to libssh";
+    return result_;
+  }
+  handshakeStarted_ = std::chrono::steady_clock::now();
+  return SSH_OK;
+}
+
+int ConnectWorker::OpenJump() {
+  if (!jump_) {
+    result_ = SSH_ERROR;
+    errorMessage_ = "No host to connect to through the jump session";
+    return result_;
+  }
+
+  int result = jump_->Open();
+  if (result == SSH_AGAIN) {
+    return TimedOut() ? result_ : SSH_AGAIN;
+  }
+  if (result != SSH_OK) {
+    result_ = SSH_ERROR;
+    errorMessage_ = jump_->error();
+    return result_;
+  }
+
+  // The channel open is this connection's TCP connect
+  handshakeStarted_ = std::chrono::steady_clock::now();
+  timings_.tcpMs = std::chrono::duration<double, std::milli>(handshakeStarted_ - started_).count();
+  socket_t fd = jump_->TakeSocket();
+  if (ssh_options_set(session_, SSH_OPTIONS_FD, &fd) != SSH_OK) {
+    CloseSocket(fd);
+    result_ = SSH_ERROR;
+    errorMessage_ = "Failed to hand the jump channel's socket to libssh";
+    return result_;
+  }
+  jumpOpen_ = true;
+  return SSH_OK;
+}
+
+int ConnectWorker::Execute() {
+  int result = Connect();
+  if (result == SSH_ERROR) {
+    Reset();
+  }
+  return result;
+}
+
+int ConnectWorker::Connect() {
+  if (eyeballs_) {
+    int result = ConnectSocket();
+    if (result != SSH_OK) {
+      return result;
+    }
+  }
+  if (viaJump_ && !jumpOpen_) {
+    int result = OpenJump();
+    if (result != SSH_OK) {
+      return result;
+    }
+  }
 
-void ConnectWorker::Execute() {
   result_ = ssh_connect(session_);
-  if (result_ != SSH_OK) {
-    const char* error = ssh_get_error(session_);
-    errorMessage_ = error ? error : "Connection failed";
+
+  // The socket exists after the first non-blocking ssh_connect() call;
+  // from then on the reactor polls it
+  reactor()->AddSession(session_, owner_->alive_);
+
+  if (result_ == SSH_AGAIN && !TimedOut()) {
+    return SSH_AGAIN;
   }
+
+  if (result_ == SSH_OK) {
+    owner_->alive_->store(true);
+    timings_.handshakeMs =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - handshakeStarted_).count();
+  } else {
+    if (errorMessage_.empty()) {
+      const char* error = ssh_get_error(session_);
+      errorMessage_ = error ? error : "Connection failed";
+    }
+  }
+  return result_;
 }
 
 void ConnectWorker::OnOK() {
-  deferred_.Resolve(Env().Undefined());
+  owner_->connectTimings_ = timings_;
+  if (result_ == SSH_OK) {
+    owner_->SetJump(jump_, std::move(jumpRef_));
+    owner_->connected_ = true;
+    deferred_.Resolve(Env().Undefined());
+  } else {
+    deferred_.Reject(Napi::Error::New(Env(), errorMessage_).Value());
+  }
+}
+
+void ConnectWorker::Cancel() {
+  Reset();
+}
+
+// Puts the session back as it was before connect(), so it can be retried
+// or disconnected without meeting a half-done handshake
+void ConnectWorker::Reset() {
+  if (eyeballs_) {
+    eyeballs_->Finish();
+    eyeballs_.reset();
+  }
+  if (jump_) {
+    jump_->Close();
+  }
+  reactor()->RemoveSession(session_);
+  ssh_disconnect(session_);
 }
 
 void ConnectWorker::OnError(const Napi::Error& error) {
+  owner_->connectTimings_ = timings_;
+  if (jump_) {
+    // Must close before jumpRef_ can release the jump session
+    std::shared_ptr<JumpTransport> jump = jump_;
+    reactor()->Post([jump]() { jump->Close(); });
+  }
   deferred_.Reject(error.Value());
 }
 
 // AuthPasswordWorker
-AuthPasswordWorker::AuthPasswordWorker(Napi::Env env, ssh_session session,
+AuthPasswordWorker::AuthPasswordWorker(Napi::Env env, SSHSession* session,
                                        const std::string& username, const std::string& password,
                                        const Napi::Promise::Deferred& deferred)
-    : SSHAsyncWorker(env, session), username_(username), password_(password), deferred_(deferred) {}
+    : SSHAsyncWorker(env, session, "authPassword"), username_(username), password_(password), deferred_(deferred),
+      authMs_(-1) {}
 
-void AuthPasswordWorker::Execute() {
+int AuthPasswordWorker::Execute() {
   result_ = ssh_userauth_password(session_, username_.empty() ? nullptr : username_.c_str(), password_.c_str());
+  if (result_ == SSH_AUTH_AGAIN) {
+    return SSH_AGAIN;
+  }
   if (result_ != SSH_AUTH_SUCCESS) {
     const char* error = ssh_get_error(session_);
     errorMessage_ = error ? error : "Authentication failed";
   }
+  authMs_ = ElapsedMs();
+  return SSH_OK;
 }
 
 void AuthPasswordWorker::OnOK() {
+  owner_->connectTimings_.authMs = authMs_;
   if (result_ == SSH_AUTH_SUCCESS) {
     deferred_.Resolve(Env().Undefined());
   } else {
@@ -54,20 +266,105 @@ void AuthPasswordWorker::OnError(const Napi::Error& error) {
 }
 
 // AuthAgentWorker
-AuthAgentWorker::AuthAgentWorker(Napi::Env env, ssh_session session,
+AuthAgentWorker::AuthAgentWorker(Napi::Env env, SSHSession* session,
                                  const std::string& username,
                                  const Napi::Promise::Deferred& deferred)
-    : SSHAsyncWorker(env, session), username_(username), deferred_(deferred) {}
+    : SSHAsyncWorker(env, session, "authAgent"), username_(username), deferred_(deferred), authMs_(-1),
+      agentPath_(session->agentSocket_), started_(false), retries_(0) {
+  if (agentPath_.empty()) {
+    const char* socket = std::getenv("SSH_AUTH_SOCK");
+    agentPath_ = socket != nullptr ? socket : "";
+  }
+
+  std::string user = username_;
+  char* value = nullptr;
+  if (user.empty() && ssh_options_get(session_, SSH_OPTIONS_USER, &value) == SSH_OK) {
+    user = value;
+    ssh_string_free_char(value);
+  }
+  std::string host;
+  if (ssh_options_get(session_, SSH_OPTIONS_HOST, &value) == SSH_OK) {
+    host = value;
+    ssh_string_free_char(value);
+  }
+  unsigned int port = 22;
+  ssh_options_get_port(session_, &port);
+  target_ = user + "@" + host + ":" + std::to_string(port);
+}
+
+// Routes libssh's agent traffic through the shared AgentClient. The
+// socket stays with the session, so this happens once per session.
+void AuthAgentWorker::AttachAgent() {
+  if (owner_->agentClientId_ == 0 && !agentPath_.empty()) {
+    uint64_t id = 0;
+    socket_t fd = AgentClient::Get().Attach(agentPath_, &id);
+    if (fd != SSH_INVALID_SOCKET) {
+      if (ssh_set_agent_socket(session_, fd) == SSH_OK) {
+        owner_->agentClientId_ = id;
+      } else {
+        CloseSocket(fd);
+      }
+    }
+  }
+  if (owner_->agentClientId_ == 0) {
+    return;
+  }
+
+  // The agent thread signals here as it finishes listing or signing, so
+  // the reactor picks the login up without waiting out its poll
+  auto wake = std::make_shared<AgentWake>();
+  if (CreateSocketPair(wake->fds)) {
+    ssh_event_add_fd(reactor()->event(), wake->fds[0], POLLIN, &OnAgentReady, nullptr);
+    wake_ = wake;
+  }
+  AgentClient::Get().Begin(owner_->agentClientId_, target_, wake_);
+}
+
+void AuthAgentWorker::FinishAgent(bool succeeded) {
+  if (wake_) {
+    ssh_event_remove_fd(reactor()->event(), wake_->fds[0]);
+    wake_.reset();
+  }
+  if (owner_->agentClientId_ != 0) {
+    AgentClient::Get().Finish(owner_->agentClientId_, succeeded);
+  }
+}
+
+int AuthAgentWorker::Execute() {
+  if (!started_) {
+    started_ = true;
+    AttachAgent();
+  }
+
+  // libssh waits for the agent's answers on this thread; the proxy only
+  // answers at once while no agent work for the login is outstanding
+  uint64_t id = owner_->agentClientId_;
+  if (id != 0 && !AgentClient::Get().Ready(id)) {
+    return SSH_AGAIN;
+  }
 
-void AuthAgentWorker::Execute() {
   result_ = ssh_userauth_agent(session_, username_.empty() ? nullptr : username_.c_str());
+  if (result_ == SSH_AUTH_AGAIN) {
+    return SSH_AGAIN;
+  }
+  if (result_ != SSH_AUTH_SUCCESS && result_ != SSH_AUTH_PARTIAL && id != 0 &&
+      AgentClient::Get().Deferred(id) && retries_ < kMaxAgentRetries) {
+    // libssh gave up on a signature still being made; it starts over
+    // once the proxy has it
+    retries_++;
+    return SSH_AGAIN;
+  }
+  FinishAgent(result_ == SSH_AUTH_SUCCESS);
   if (result_ != SSH_AUTH_SUCCESS) {
     const char* error = ssh_get_error(session_);
     errorMessage_ = error ? error : "Agent authentication failed";
   }
+  authMs_ = ElapsedMs();
+  return SSH_OK;
 }
 
 void AuthAgentWorker::OnOK() {
+  owner_->connectTimings_.authMs = authMs_;
   if (result_ == SSH_AUTH_SUCCESS) {
     deferred_.Resolve(Env().Undefined());
   } else {
@@ -79,13 +376,22 @@ void AuthAgentWorker::OnError(const Napi::Error& error) {
   deferred_.Reject(error.Value());
 }
 
+void AuthAgentWorker::Cancel() {
+  // The key being tried may be the one at fault
+  if (started_) {
+    FinishAgent(false);
+  }
+}
+
 // DisconnectWorker
-DisconnectWorker::DisconnectWorker(Napi::Env env, ssh_session session, const Napi::Promise::Deferred& deferred)
-    : SSHAsyncWorker(env, session), deferred_(deferred) {}
+DisconnectWorker::DisconnectWorker(Napi::Env env, SSHSession* session, const Napi::Promise::Deferred& deferred)
+    : SSHAsyncWorker(env, session, "disconnect"), deferred_(deferred) {}
 
-void DisconnectWorker::Execute() {
+int DisconnectWorker::Execute() {
+  reactor()->RemoveSession(session_);
   ssh_disconnect(session_);
   result_ = SSH_OK;
+  return result_;
 }
 
 void DisconnectWorker::OnOK() {
@@ -3,18 +3,30 @@
 
 #include <napi.h>
 #include <libssh/libssh.h>
+#include <chrono>
+#include <memory>
 #include <string>
+#include "happy_eyeballs.h"
+#include "jump_transport.h"
+#include "reactor.h"
+#include "stats.h"
 
 namespace libssh_node {
 
-// Base class for SSH async operations
-class SSHAsyncWorker : public Napi::AsyncWorker {
+class SSHSession;
+struct AgentWake;
+
+// Base class for SSH session operations, run on the reactor thread
+class SSHAsyncWorker : public ReactorWorker {
 public:
-  SSHAsyncWorker(Napi::Env env, ssh_session session);
+  SSHAsyncWorker(Napi::Env env, SSHSession* session, const char* operation);
   virtual ~SSHAsyncWorker() = default;
 
 protected:
+  SSHSession* owner_;
   ssh_session session_;
+  IoCounters* io_; // The session's traffic totals
+  SessionStats* sessionStats_;
   int result_;
   std::string errorMessage_;
 };
@@ -22,22 +34,40 @@ protected:
 // Connect operation
 class ConnectWorker : public SSHAsyncWorker {
 public:
-  ConnectWorker(Napi::Env env, ssh_session session, const Napi::Promise::Deferred& deferred);
-  void Execute() override;
+  // With jump, connects through a direct-tcpip channel of that session
+  ConnectWorker(Napi::Env env, SSHSession* session, const Napi::Promise::Deferred& deferred,
+                SSHSession* jump = nullptr);
+  int Execute() override;
   void OnOK() override;
   void OnError(const Napi::Error& error) override;
+  void Cancel() override;
 
 private:
+  int Connect();       // All stages; SSH_ERROR on failure or timeout
+  int ConnectSocket(); // Happy-eyeballs stage; SSH_OK once the session has its socket
+  int OpenJump();      // Jump channel stage, likewise
+  bool TimedOut();
+  void Reset();        // Back to disconnected after a failure, timeout or abort
+
   Napi::Promise::Deferred deferred_;
+  long timeoutMs_;
+  std::chrono::steady_clock::time_point started_;
+  std::unique_ptr<HappyEyeballs> eyeballs_; // Null once done, or when libssh connects itself
+  std::shared_ptr<JumpTransport> jump_;
+  Napi::ObjectReference jumpRef_;
+  bool viaJump_;
+  bool jumpOpen_;
+  std::chrono::steady_clock::time_point handshakeStarted_;
+  ConnectTimings timings_;
 };
 
 // Password authentication
 class AuthPasswordWorker : public SSHAsyncWorker {
 public:
-  AuthPasswordWorker(Napi::Env env, ssh_session session,
+  AuthPasswordWorker(Napi::Env env, SSHSession* session,
                      const std::string& username, const std::string& password,
                      const Napi::Promise::Deferred& deferred);
-  void Execute() override;
+  int Execute() override;
   void OnOK() override;
   void OnError(const Napi::Error& error) override;
 
@@ -45,28 +75,39 @@ private:
   std::string username_;
   std::string password_;
   Napi::Promise::Deferred deferred_;
+  double authMs_;
 };
 
 // Agent authentication
 class AuthAgentWorker : public SSHAsyncWorker {
 public:
-  AuthAgentWorker(Napi::Env env, ssh_session session,
+  AuthAgentWorker(Napi::Env env, SSHSession* session,
                   const std::string& username,
                   const Napi::Promise::Deferred& deferred);
-  void Execute() override;
+  int Execute() override;
   void OnOK() override;
   void OnError(const Napi::Error& error) override;
+  void Cancel() override;
 
 private:
+  void AttachAgent();
+  void FinishAgent(bool succeeded);
+
   std::string username_;
   Napi::Promise::Deferred deferred_;
+  double authMs_;
+  std::string agentPath_;
+  std::string target_; // user@host:port, for the remembered key
+  bool started_;
+  int retries_; // Re-runs after a deferred signature
+  std::shared_ptr<AgentWake> wake_;
 };
 
 // Disconnect operation
 class DisconnectWorker : public SSHAsyncWorker {
 public:
-  DisconnectWorker(Napi::Env env, ssh_session session, const Napi::Promise::Deferred& deferred);
-  void Execute() override;
+  DisconnectWorker(Napi::Env env, SSHSession* session, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
   void OnOK() override;
   void OnError(const Napi::Error& error) override;
 
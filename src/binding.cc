@@ -1,12 +1,19 @@
 #include <napi.h>
+#include "addon_data.h"
 #include "ssh_session.h"
 #include "ssh_channel.h"
+#include "ssh_config.h"
 #include "ssh_sftp.h"
+#include "ssh_tunnel.h"
 
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
+  env.SetInstanceData(new libssh_node::AddonData());
+
   libssh_node::SSHSession::Init(env, exports);
   libssh_node::SSHChannel::Init(env, exports);
   libssh_node::SSHSftp::Init(env, exports);
+  libssh_node::SSHTunnel::Init(env, exports);
+  exports.Set("resolveConfig", Napi::Function::New(env, libssh_node::ResolveConfig, "resolveConfig"));
 
   return exports;
 }
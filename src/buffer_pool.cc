@@ -0,0 +1,81 @@
+#include "buffer_pool.h"
+
+namespace libssh_node {
+
+namespace {
+
+// Below this, copying is cheaper than tying up a whole block
+constexpr size_t kCopyThreshold = 4096;
+
+} // namespace
+
+BufferPool::BufferPool(size_t blockSize, size_t maxFree)
+    : blockSize_(blockSize), maxFree_(maxFree) {}
+
+BufferPool::~BufferPool() {
+  for (char* block : free_) {
+    delete[] block;
+  }
+}
+
+char* BufferPool::Acquire(size_t size) {
+  if (size <= blockSize_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_.empty()) {
+      char* block = free_.back();
+      free_.pop_back();
+      return block;
+    }
+    size = blockSize_;
+  }
+  return new char[size];
+}
+
+void BufferPool::Release(char* block, size_t size) {
+  if (size <= blockSize_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.size() < maxFree_) {
+      free_.push_back(block);
+      return;
+    }
+  }
+  delete[] block;
+}
+
+Napi::Buffer<char> BufferPool::Wrap(Napi::Env env, char* block, size_t size, size_t length) {
+  if (length <= kCopyThreshold) {
+    Napi::Buffer<char> buffer = Napi::Buffer<char>::Copy(env, block, length);
+    Release(block, size);
+    return buffer;
+  }
+
+  // NewOrCopy falls back to a copy (and finalizes immediately) where
+  // external buffers are not allowed, e.g. Electron's V8 sandbox
+  Loan* loan = new Loan{shared_from_this(), size};
+  return Napi::Buffer<char>::NewOrCopy(env, block, length, &BufferPool::Finalize, loan);
+}
+
+void BufferPool::Finalize(Napi::Env env, char* block, Loan* loan) {
+  loan->pool->Release(block, loan->size);
+  delete loan;
+}
+
+// PooledBlock
+PooledBlock::PooledBlock(std::shared_ptr<BufferPool> pool, size_t size)
+    : pool_(std::move(pool)), block_(nullptr), size_(size) {
+  block_ = pool_->Acquire(size_);
+}
+
+PooledBlock::~PooledBlock() {
+  if (block_ != nullptr) {
+    pool_->Release(block_, size_);
+  }
+}
+
+Napi::Buffer<char> PooledBlock::Wrap(Napi::Env env, size_t length) {
+  char* block = block_;
+  block_ = nullptr;
+  return pool_->Wrap(env, block, size_, length);
+}
+
+} // namespace libssh_node
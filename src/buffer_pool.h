@@ -0,0 +1,68 @@
+#ifndef LIBSSH_NODE_BUFFER_POOL_H
+#define LIBSSH_NODE_BUFFER_POOL_H
+
+#include <napi.h>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace libssh_node {
+
+// Recycles fixed-size read blocks so that reads neither allocate nor zero a
+// fresh buffer each time. Blocks are taken on the reactor thread and come
+// back from Buffer finalizers on the JS thread.
+class BufferPool : public std::enable_shared_from_this<BufferPool> {
+public:
+  BufferPool(size_t blockSize, size_t maxFree);
+  ~BufferPool();
+
+  size_t blockSize() const { return blockSize_; }
+
+  // Requests larger than blockSize() get a one-off allocation
+  char* Acquire(size_t size);
+  void Release(char* block, size_t size);
+
+  // Hand `length` bytes of a block to JS. Small results are copied so the
+  // block goes straight back to the pool; larger ones are lent to JS as an
+  // external Buffer and returned when it is collected.
+  Napi::Buffer<char> Wrap(Napi::Env env, char* block, size_t size, size_t length);
+
+private:
+  struct Loan {
+    std::shared_ptr<BufferPool> pool;
+    size_t size;
+  };
+
+  static void Finalize(Napi::Env env, char* block, Loan* loan);
+
+  size_t blockSize_;
+  size_t maxFree_;
+  std::mutex mutex_;
+  std::vector<char*> free_;
+};
+
+// A block on its way from the reactor thread to JS, for events that may be
+// dropped before they run. Goes back to the pool unless Wrap() hands it on.
+class PooledBlock {
+public:
+  PooledBlock(std::shared_ptr<BufferPool> pool, size_t size);
+  ~PooledBlock();
+  PooledBlock(const PooledBlock&) = delete;
+  PooledBlock& operator=(const PooledBlock&) = delete;
+
+  char* data() const { return block_; }
+
+  // JS thread. The first `length` bytes as a Buffer; the block is the
+  // Buffer's from then on.
+  Napi::Buffer<char> Wrap(Napi::Env env, size_t length);
+
+private:
+  std::shared_ptr<BufferPool> pool_;
+  char* block_;
+  size_t size_;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_BUFFER_POOL_H
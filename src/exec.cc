@@ -0,0 +1,401 @@
+#include "exec.h"
+#include "ssh_channel.h"
+#include "ssh_session.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kReadChunkSize = 16384;
+// Bounds the time one chatty command holds the reactor per iteration
+constexpr int kMaxReadsPerStep = 16;
+
+} // namespace
+
+namespace libssh_node {
+
+CapturePolicy ParseCapturePolicy(const Napi::Object& options, size_t defaultMaxBytes) {
+  CapturePolicy policy;
+  policy.maxBytes = static_cast<size_t>(
+    std::max(GetIntOption(options, "maxOutput", static_cast<int>(defaultMaxBytes)), 0));
+
+  if (!options.Has("capture") || !options.Get("capture").IsObject()) {
+    return policy;
+  }
+
+  Napi::Object capture = options.Get("capture").As<Napi::Object>();
+  std::string mode = GetStringOption(capture, "mode", "head");
+  if (mode == "tail") {
+    policy.mode = CapturePolicy::Mode::kTail;
+  } else if (mode == "headTail") {
+    policy.mode = CapturePolicy::Mode::kHeadTail;
+  } else if (mode == "file") {
+    policy.mode = CapturePolicy::Mode::kFile;
+  }
+  policy.maxBytes = static_cast<size_t>(
+    std::max(GetIntOption(capture, "maxBytes", static_cast<int>(policy.maxBytes)), 0));
+  policy.stdoutPath = GetStringOption(capture, "stdoutPath");
+  policy.stderrPath = GetStringOption(capture, "stderrPath");
+  return policy;
+}
+
+// OutputCapture
+OutputCapture::OutputCapture(const CapturePolicy& policy, std::string path)
+    : headLimit_(0), tailLimit_(0), ringStart_(0), file_(nullptr), total_(0) {
+  switch (policy.mode) {
+    case CapturePolicy::Mode::kHead:
+      headLimit_ = policy.maxBytes;
+      break;
+    case CapturePolicy::Mode::kTail:
+      tailLimit_ = policy.maxBytes;
+      break;
+    case CapturePolicy::Mode::kHeadTail:
+      headLimit_ = policy.maxBytes / 2;
+      tailLimit_ = policy.maxBytes - headLimit_;
+      break;
+    case CapturePolicy::Mode::kFile:
+      path_ = std::move(path);
+      break;
+  }
+}
+
+OutputCapture::~OutputCapture() {
+  Close();
+}
+
+bool OutputCapture::Open() {
+  if (path_.empty() || file_ != nullptr) {
+    return true;
+  }
+  file_ = std::fopen(path_.c_str(), "wb");
+  return file_ != nullptr;
+}
+
+bool OutputCapture::Append(const char* data, size_t length) {
+  total_ += length;
+
+  if (file_ != nullptr) {
+    return std::fwrite(data, 1, length, file_) == length;
+  }
+
+  if (head_.size() < headLimit_) {
+    size_t keep = std::min(length, headLimit_ - head_.size());
+    head_.insert(head_.end(), data, data + keep);
+    data += keep;
+    length -= keep;
+  }
+  AppendTail(data, length);
+  return true;
+}
+
+void OutputCapture::AppendTail(const char* data, size_t length) {
+  if (tailLimit_ == 0 || length == 0) {
+    return;
+  }
+
+  if (length >= tailLimit_) {
+    ring_.assign(data + length - tailLimit_, data + length);
+    ringStart_ = 0;
+    return;
+  }
+
+  if (ring_.size() < tailLimit_) {
+    size_t keep = std::min(length, tailLimit_ - ring_.size());
+    ring_.insert(ring_.end(), data, data + keep);
+    data += keep;
+    length -= keep;
+  }
+
+  // The ring is full: overwrite the oldest bytes
+  while (length > 0) {
+    size_t chunk = std::min(length, tailLimit_ - ringStart_);
+    std::memcpy(ring_.data() + ringStart_, data, chunk);
+    ringStart_ = (ringStart_ + chunk) % tailLimit_;
+    data += chunk;
+    length -= chunk;
+  }
+}
+
+void OutputCapture::Close() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+std::vector<char> OutputCapture::Contents() const {
+  std::vector<char> contents;
+  contents.reserve(head_.size() + ring_.size());
+  contents.insert(contents.end(), head_.begin(), head_.end());
+  contents.insert(contents.end(), ring_.begin() + ringStart_, ring_.end());
+  contents.insert(contents.end(), ring_.begin(), ring_.begin() + ringStart_);
+  return contents;
+}
+
+// ExecJob
+ExecJob::ExecJob(std::string command, long timeoutMs, const CapturePolicy& capture)
+    : command_(std::move(command)), timeoutMs_(timeoutMs), session_(nullptr), io_(nullptr), stats_(nullptr),
+      channel_(nullptr), ownsChannel_(true), counted_(false), state_(State::kOpen), stdout_(capture, capture.stdoutPath),
+      stderr_(capture, capture.stderrPath), exitStatusSet_(false),
+      exitStatus_(-1), timedOut_(false) {
+  std::memset(&callbacks_, 0, sizeof(callbacks_));
+  callbacks_.userdata = this;
+  callbacks_.channel_exit_status_function = &ExecJob::OnExitStatus;
+  callbacks_.channel_exit_signal_function = &ExecJob::OnExitSignal;
+  ssh_callbacks_init(&callbacks_);
+}
+
+void ExecJob::Start(ssh_session session, IoCounters* io, SessionStats* stats, ssh_channel channel) {
+  session_ = session;
+  io_ = io;
+  stats_ = stats;
+  deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs_);
+
+  if (!stdout_.Open() || !stderr_.Open()) {
+    Finish("Failed to open output file");
+    return;
+  }
+
+  if (channel != nullptr) {
+    channel_ = channel;
+    ownsChannel_ = false;
+    ssh_add_channel_callbacks(channel_, &callbacks_);
+    state_ = State::kExec;
+  }
+}
+
+bool ExecJob::Step() {
+  if (state_ == State::kDone) {
+    return true;
+  }
+
+  if (timeoutMs_ > 0 && std::chrono::steady_clock::now() >= deadline_) {
+    timedOut_ = true;
+    Finish("");
+    return true;
+  }
+
+  if (state_ == State::kOpen) {
+    if (channel_ == nullptr) {
+      channel_ = ssh_channel_new(session_);
+      if (channel_ == nullptr) {
+        Finish("Failed to create channel");
+        return true;
+      }
+    }
+
+    int rc = ssh_channel_open_session(channel_);
+    if (rc == SSH_AGAIN) {
+      return false;
+    }
+    if (rc != SSH_OK) {
+      Finish("Failed to open channel session");
+      return true;
+    }
+    if (stats_ != nullptr) {
+      stats_->channelsOpen.fetch_add(1, std::memory_order_relaxed);
+      counted_ = true;
+    }
+
+    // Only the exit callbacks are set, so output stays buffered in libssh
+    // for ssh_channel_read_nonblocking()
+    ssh_add_channel_callbacks(channel_, &callbacks_);
+    state_ = State::kExec;
+  }
+
+  if (state_ == State::kExec) {
+    int rc = ssh_channel_request_exec(channel_, command_.c_str());
+    if (rc == SSH_AGAIN) {
+      return false;
+    }
+    if (rc != SSH_OK) {
+      Finish("Failed to execute command");
+      return true;
+    }
+    state_ = State::kRun;
+  }
+
+  bool more = false;
+  if (!Drain(&more)) {
+    return true;
+  }
+
+  // The exit status may follow EOF, and some servers close without one
+  bool closed = ssh_channel_is_closed(channel_);
+  if (!more && (closed || (ssh_channel_is_eof(channel_) && exitStatusSet_))) {
+    Finish("");
+    return true;
+  }
+  return false;
+}
+
+void ExecJob::Abort(const std::string& error) {
+  if (state_ != State::kDone) {
+    Finish(error);
+  }
+}
+
+bool ExecJob::Drain(bool* more) {
+  char buffer[kReadChunkSize];
+
+  // Both streams are read every step: an unread stderr would otherwise
+  // hold the shared window shut
+  for (int isStderr = 0; isStderr <= 1; isStderr++) {
+    OutputCapture& capture = isStderr ? stderr_ : stdout_;
+    int reads = 0;
+    for (; reads < kMaxReadsPerStep; reads++) {
+      int n = ssh_channel_read_nonblocking(channel_, buffer, sizeof(buffer), isStderr);
+      if (n == 0 || n == SSH_EOF) {
+        break;
+      }
+      if (n < 0) {
+        if (ssh_channel_is_closed(channel_)) {
+          break;
+        }
+        Finish("Failed to read command output");
+        return false;
+      }
+      io_->CountRead(static_cast<size_t>(n));
+      if (!capture.Append(buffer, static_cast<size_t>(n))) {
+        Finish("Failed to write output file");
+        return false;
+      }
+    }
+    if (reads == kMaxReadsPerStep) {
+      *more = true;
+    }
+  }
+  return true;
+}
+
+void ExecJob::Finish(const std::string& error) {
+  error_ = error;
+  stdout_.Close();
+  stderr_.Close();
+  if (channel_ != nullptr) {
+    ssh_remove_channel_callbacks(channel_, &callbacks_);
+    if (ownsChannel_) {
+      if (!ssh_channel_is_closed(channel_)) {
+        ssh_channel_close(channel_);
+      }
+      ssh_channel_free(channel_);
+    }
+    channel_ = nullptr;
+  }
+  if (counted_) {
+    stats_->channelsOpen.fetch_sub(1, std::memory_order_relaxed);
+    counted_ = false;
+  }
+  state_ = State::kDone;
+}
+
+void ExecJob::OnExitStatus(ssh_session session, ssh_channel channel, int status, void* userdata) {
+  ExecJob* self = static_cast<ExecJob*>(userdata);
+  self->exitStatusSet_ = true;
+  self->exitStatus_ = status;
+}
+
+void ExecJob::OnExitSignal(ssh_session session, ssh_channel channel, const char* signal,
+                           int core, const char* errmsg, const char* lang, void* userdata) {
+  static_cast<ExecJob*>(userdata)->exitSignal_ = signal ? signal : "";
+}
+
+Napi::Object ExecJob::ToObject(Napi::Env env) const {
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("command", Napi::String::New(env, command_));
+  result.Set("exitCode", exitStatusSet_ ? Napi::Number::New(env, exitStatus_) : env.Null());
+  result.Set("signal", exitSignal_.empty() ? env.Null() : Napi::String::New(env, exitSignal_));
+  std::vector<char> out = stdout_.Contents();
+  std::vector<char> err = stderr_.Contents();
+  result.Set("stdout", Napi::Buffer<char>::Copy(env, out.data(), out.size()));
+  result.Set("stderr", Napi::Buffer<char>::Copy(env, err.data(), err.size()));
+  result.Set("stdoutBytes", Napi::Number::New(env, static_cast<double>(stdout_.total())));
+  result.Set("stderrBytes", Napi::Number::New(env, static_cast<double>(stderr_.total())));
+  if (!stdout_.path().empty()) {
+    result.Set("stdoutPath", Napi::String::New(env, stdout_.path()));
+    result.Set("stderrPath", Napi::String::New(env, stderr_.path()));
+  }
+  result.Set("truncated", Napi::Boolean::New(env, stdout_.truncated() || stderr_.truncated()));
+  result.Set("timedOut", Napi::Boolean::New(env, timedOut_));
+  if (!error_.empty()) {
+    result.Set("error", Napi::String::New(env, error_));
+  }
+  return result;
+}
+
+// ExecManyWorker
+ExecManyWorker::ExecManyWorker(Napi::Env env, SSHSession* session, std::vector<std::unique_ptr<ExecJob>> jobs,
+                               size_t concurrency, const Napi::Promise::Deferred& deferred)
+    : SSHAsyncWorker(env, session, "execMany"), jobs_(std::move(jobs)), next_(0),
+      concurrency_(std::max<size_t>(concurrency, 1)), deferred_(deferred) {}
+
+int ExecManyWorker::Execute() {
+  while (running_.size() < concurrency_ && next_ < jobs_.size()) {
+    ExecJob* job = jobs_[next_++].get();
+    job->Start(session_, io_, sessionStats_);
+    running_.push_back(job);
+  }
+
+  running_.erase(std::remove_if(running_.begin(), running_.end(),
+                                [](ExecJob* job) { return job->Step(); }),
+                 running_.end());
+
+  return running_.empty() && next_ == jobs_.size() ? SSH_OK : SSH_AGAIN;
+}
+
+void ExecManyWorker::OnOK() {
+  Napi::Env env = Env();
+  Napi::Array results = Napi::Array::New(env, jobs_.size());
+  for (size_t i = 0; i < jobs_.size(); i++) {
+    results.Set(static_cast<uint32_t>(i), jobs_[i]->ToObject(env));
+  }
+  deferred_.Resolve(results);
+}
+
+void ExecManyWorker::OnError(const Napi::Error& error) {
+  deferred_.Reject(error.Value());
+}
+
+void ExecManyWorker::Cancel() {
+  // Closes their channels; jobs that never started hold none
+  for (ExecJob* job : running_) {
+    job->Abort("Aborted");
+  }
+  running_.clear();
+}
+
+// ChannelCaptureWorker
+ChannelCaptureWorker::ChannelCaptureWorker(Napi::Env env, SSHChannel* channel, std::unique_ptr<ExecJob> job,
+                                           const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, channel->Value(), channel->Operation("exec")),
+      owner_(channel), job_(std::move(job)), started_(false), deferred_(deferred) {}
+
+int ChannelCaptureWorker::Execute() {
+  if (!started_) {
+    started_ = true;
+    job_->Start(owner_->session_, &owner_->io_, nullptr, owner_->channel_);
+  }
+  return job_->Step() ? SSH_OK : SSH_AGAIN;
+}
+
+// Either way the job has let go of the channel, so it can be read or
+// exec'd on again
+void ChannelCaptureWorker::OnOK() {
+  owner_->capturing_ = false;
+  deferred_.Resolve(job_->ToObject(Env()));
+}
+
+void ChannelCaptureWorker::OnError(const Napi::Error& error) {
+  owner_->capturing_ = false;
+  deferred_.Reject(error.Value());
+}
+
+void ChannelCaptureWorker::Cancel() {
+  // The channel stays open; only the job lets go of it
+  if (started_) {
+    job_->Abort("Aborted");
+  }
+}
+
+} // namespace libssh_node
@@ -0,0 +1,155 @@
+#ifndef LIBSSH_NODE_EXEC_H
+#define LIBSSH_NODE_EXEC_H
+
+#include <napi.h>
+#include <libssh/libssh.h>
+#include <libssh/callbacks.h>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "async_workers.h"
+
+namespace libssh_node {
+
+class SSHChannel;
+
+// How much of each output stream a command keeps
+struct CapturePolicy {
+  enum class Mode {
+    kHead,     // First maxBytes
+    kTail,     // Last maxBytes
+    kHeadTail, // First and last maxBytes / 2
+    kFile      // Everything, written to stdoutPath / stderrPath
+  };
+
+  Mode mode = Mode::kHead;
+  size_t maxBytes = 0;
+  std::string stdoutPath;
+  std::string stderrPath;
+};
+
+// Reads { capture: { mode, maxBytes, stdoutPath, stderrPath }, maxOutput }
+CapturePolicy ParseCapturePolicy(const Napi::Object& options, size_t defaultMaxBytes);
+
+// Bounded copy of one output stream. Keeps a head and/or a tail ring of
+// fixed size, or streams everything to a file, and counts the bytes it
+// dropped, so a runaway command cannot grow the process.
+class OutputCapture {
+public:
+  OutputCapture(const CapturePolicy& policy, std::string path);
+  ~OutputCapture();
+
+  // Reactor thread. Open() is a no-op unless writing to a file.
+  bool Open();
+  bool Append(const char* data, size_t length);
+  void Close();
+
+  std::vector<char> Contents() const; // Head followed by tail
+  uint64_t total() const { return total_; }
+  bool truncated() const { return path_.empty() && total_ > head_.size() + ring_.size(); }
+  const std::string& path() const { return path_; }
+
+private:
+  void AppendTail(const char* data, size_t length);
+
+  size_t headLimit_;
+  size_t tailLimit_;
+  std::vector<char> head_;
+  std::vector<char> ring_; // Grows to tailLimit_, then wraps at ringStart_
+  size_t ringStart_;
+  std::string path_; // Set in file mode only
+  FILE* file_;
+  uint64_t total_;
+};
+
+// One remote command run to completion on the reactor thread: opens a
+// session channel, execs, drains stdout and stderr as they arrive so
+// neither stream can stall the window, and records the exit status.
+class ExecJob {
+public:
+  ExecJob(std::string command, long timeoutMs, const CapturePolicy& capture);
+
+  // Reactor thread. Step() returns true once the job has finished. With
+  // a channel, the job execs on that already-open channel and leaves
+  // closing it to its owner; otherwise the channel it opens counts into
+  // stats->channelsOpen while open. Output read is counted into io.
+  void Start(ssh_session session, IoCounters* io, SessionStats* stats, ssh_channel channel = nullptr);
+  bool Step();
+  // Reactor thread. Finishes a job that is still running with error.
+  void Abort(const std::string& error);
+
+  // JS thread, after the job has finished
+  Napi::Object ToObject(Napi::Env env) const;
+
+private:
+  enum class State { kOpen, kExec, kRun, kDone };
+
+  bool Drain(bool* more);
+  void Finish(const std::string& error);
+
+  static void OnExitStatus(ssh_session session, ssh_channel channel, int status, void* userdata);
+  static void OnExitSignal(ssh_session session, ssh_channel channel, const char* signal,
+                           int core, const char* errmsg, const char* lang, void* userdata);
+
+  std::string command_;
+  long timeoutMs_;
+  ssh_session session_;
+  IoCounters* io_;
+  SessionStats* stats_;
+  ssh_channel channel_;
+  bool ownsChannel_;
+  bool counted_; // In stats_->channelsOpen
+  struct ssh_channel_callbacks_struct callbacks_;
+  State state_;
+  std::chrono::steady_clock::time_point deadline_;
+
+  OutputCapture stdout_;
+  OutputCapture stderr_;
+  bool exitStatusSet_;
+  int exitStatus_;
+  std::string exitSignal_;
+  bool timedOut_;
+  std::string error_;
+};
+
+// Runs a batch of commands on concurrent channels of one session and
+// resolves with every result at once
+class ExecManyWorker : public SSHAsyncWorker {
+public:
+  ExecManyWorker(Napi::Env env, SSHSession* session, std::vector<std::unique_ptr<ExecJob>> jobs,
+                 size_t concurrency, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+  void Cancel() override;
+
+private:
+  std::vector<std::unique_ptr<ExecJob>> jobs_;
+  std::vector<ExecJob*> running_;
+  size_t next_;
+  size_t concurrency_;
+  Napi::Promise::Deferred deferred_;
+};
+
+// Runs one command on an open SSHChannel with the same capture as execMany
+class ChannelCaptureWorker : public ReactorWorker {
+public:
+  ChannelCaptureWorker(Napi::Env env, SSHChannel* channel, std::unique_ptr<ExecJob> job,
+                       const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+  void Cancel() override;
+
+private:
+  SSHChannel* owner_;
+  std::unique_ptr<ExecJob> job_;
+  bool started_;
+  Napi::Promise::Deferred deferred_;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_EXEC_H
@@ -0,0 +1,251 @@
+#include "happy_eyeballs.h"
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <netdb.h>
+#endif
+
+namespace libssh_node {
+
+namespace {
+
+// RFC 8305 recommends 250ms between connection attempts
+constexpr auto kAttemptDelay = std::chrono::milliseconds(250);
+
+// Readiness only needs to wake the reactor; Step() checks the sockets
+int OnReady(socket_t, int, void*) {
+  return 0;
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+bool PollWritable(socket_t fd) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+#ifdef _WIN32
+  int ready = WSAPoll(&pfd, 1, 0);
+#else
+  int ready = poll(&pfd, 1, 0);
+#endif
+  return ready > 0 && (pfd.revents & (POLLOUT | POLLERR | POLLHUP)) != 0;
+}
+
+} // namespace
+
+struct HappyEyeballs::Resolution {
+  std::mutex mutex;
+  bool done = false;
+  std::vector<Address> addresses;
+  std::string error;
+  socket_t wake[2] = {SSH_INVALID_SOCKET, SSH_INVALID_SOCKET};
+
+  ~Resolution() {
+    CloseSocket(wake[0]);
+    CloseSocket(wake[1]);
+  }
+};
+
+HappyEyeballs::HappyEyeballs(std::string host, int port)
+    : host_(std::move(host)), port_(port), event_(nullptr), resolved_(false), next_(0),
+      winner_(SSH_INVALID_SOCKET), resolveMs_(0), connectMs_(0), attempts_(0) {}
+
+HappyEyeballs::~HappyEyeballs() {
+  // Finish() has unregistered everything by now
+  for (Attempt& attempt : inflight_) {
+    CloseSocket(attempt.fd);
+  }
+  CloseSocket(winner_);
+}
+
+// Resolves host:port and orders the result as RFC 8305 asks: alternate
+// families, starting with the one the resolver put first
+std::vector<HappyEyeballs::Address> HappyEyeballs::Lookup(const std::string& host, int port, int flags,
+                                                          std::string& error) {
+  struct addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = flags;
+
+  struct addrinfo* result = nullptr;
+  std::string service = std::to_string(port);
+  int rc = getaddrinfo(host.c_str(), service.c_str(), &hints, &result);
+  if (rc != 0) {
+    error = "Failed to resolve " + host + ": " + gai_strerror(rc);
+    return {};
+  }
+
+  std::vector<Address> preferred;
+  std::vector<Address> other;
+  for (struct addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+    Address address;
+    std::memset(&address.addr, 0, sizeof(address.addr));
+    std::memcpy(&address.addr, ai->ai_addr, ai->ai_addrlen);
+    address.length = static_cast<socklen_t>(ai->ai_addrlen);
+    (ai->ai_family == result->ai_family ? preferred : other).push_back(address);
+  }
+  freeaddrinfo(result);
+
+  std::vector<Address> addresses;
+  for (size_t i = 0; i < preferred.size() || i < other.size(); i++) {
+    if (i < preferred.size()) {
+      addresses.push_back(preferred[i]);
+    }
+    if (i < other.size()) {
+      addresses.push_back(other[i]);
+    }
+  }
+  return addresses;
+}
+
+bool HappyEyeballs::Resolve(ssh_event event) {
+  if (!resolution_) {
+    started_ = std::chrono::steady_clock::now();
+
+    // Literal addresses need no lookup
+    std::string error;
+    addresses_ = Lookup(host_, port_, AI_NUMERICHOST, error);
+    if (addresses_.empty()) {
+      resolution_ = std::make_shared<Resolution>();
+      if (!CreateSocketPair(resolution_->wake)) {
+        error_ = "Failed to create wake-up socket";
+        resolution_.reset();
+        resolved_ = true;
+        return true;
+      }
+      ssh_event_add_fd(event, resolution_->wake[0], POLLIN, &OnReady, nullptr);
+
+      // getaddrinfo() blocks, so it gets a thread of its own. If the
+      // connect is abandoned first, the thread finishes into a state
+      // nobody reads any more.
+      std::shared_ptr<Resolution> resolution = resolution_;
+      std::string host = host_;
+      int port = port_;
+      std::thread([resolution, host, port]() {
+        std::string lookupError;
+        std::vector<Address> addresses = Lookup(host, port, AI_ADDRCONFIG, lookupError);
+        {
+          std::lock_guard<std::mutex> lock(resolution->mutex);
+          resolution->addresses = std::move(addresses);
+          resolution->error = lookupError;
+          resolution->done = true;
+        }
+        SignalWake(resolution->wake[1]);
+      }).detach();
+      return false;
+    }
+  } else {
+    {
+      std::lock_guard<std::mutex> lock(resolution_->mutex);
+      if (!resolution_->done) {
+        return false;
+      }
+      addresses_ = std::move(resolution_->addresses);
+      error_ = resolution_->error;
+    }
+    ssh_event_remove_fd(event, resolution_->wake[0]);
+    resolution_.reset();
+  }
+
+  resolved_ = true;
+  resolveMs_ = ElapsedMs(started_);
+  connectStarted_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+bool HappyEyeballs::StartAttempt(ssh_event event) {
+  const Address& address = addresses_[next_++];
+  const struct sockaddr* addr = reinterpret_cast<const struct sockaddr*>(&address.addr);
+  attempts_++;
+  lastAttempt_ = std::chrono::steady_clock::now();
+
+  std::string error;
+  socket_t fd = StartConnect(addr, address.length, error);
+  if (fd == SSH_INVALID_SOCKET) {
+    error_ = "Failed to connect to " + AddressString(addr) + ": " + error;
+    return false;
+  }
+
+  ssh_event_add_fd(event, fd, POLLOUT, &OnReady, nullptr);
+  inflight_.push_back({fd, AddressString(addr)});
+  return true;
+}
+
+void HappyEyeballs::CloseAttempt(Attempt& attempt) {
+  ssh_event_remove_fd(event_, attempt.fd);
+  CloseSocket(attempt.fd);
+  attempt.fd = SSH_INVALID_SOCKET;
+}
+
+int HappyEyeballs::Step(ssh_event event) {
+  event_ = event;
+  if (!resolved_ && !Resolve(event)) {
+    return SSH_AGAIN;
+  }
+  if (addresses_.empty()) {
+    return SSH_ERROR;
+  }
+
+  for (size_t i = 0; i < inflight_.size();) {
+    Attempt& attempt = inflight_[i];
+    if (!PollWritable(attempt.fd)) {
+      i++;
+      continue;
+    }
+
+    int code = GetSocketError(attempt.fd);
+    if (code == 0) {
+      ssh_event_remove_fd(event_, attempt.fd);
+      winner_ = attempt.fd;
+      address_ = attempt.address;
+      connectMs_ = ElapsedMs(connectStarted_);
+      inflight_.erase(inflight_.begin() + static_cast<std::ptrdiff_t>(i));
+      Finish();
+      return SSH_OK;
+    }
+
+    error_ = "Failed to connect to " + attempt.address + ": " + SocketErrorString(code);
+    CloseAttempt(attempt);
+    inflight_.erase(inflight_.begin() + static_cast<std::ptrdiff_t>(i));
+  }
+
+  // The next address gets its turn as soon as nothing is in flight, or
+  // once the newest attempt has had its head start
+  auto now = std::chrono::steady_clock::now();
+  while (next_ < addresses_.size() && (inflight_.empty() || now - lastAttempt_ >= kAttemptDelay)) {
+    if (StartAttempt(event)) {
+      break;
+    }
+  }
+
+  if (inflight_.empty() && next_ == addresses_.size()) {
+    return SSH_ERROR;
+  }
+  return SSH_AGAIN;
+}
+
+void HappyEyeballs::Finish() {
+  for (Attempt& attempt : inflight_) {
+    CloseAttempt(attempt);
+  }
+  inflight_.clear();
+
+  if (resolution_) {
+    ssh_event_remove_fd(event_, resolution_->wake[0]);
+    resolution_.reset();
+  }
+}
+
+socket_t HappyEyeballs::TakeSocket() {
+  socket_t fd = winner_;
+  winner_ = SSH_INVALID_SOCKET;
+  return fd;
+}
+
+} // namespace libssh_node
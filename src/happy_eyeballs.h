@@ -0,0 +1,83 @@
+#ifndef LIBSSH_NODE_HAPPY_EYEBALLS_H
+#define LIBSSH_NODE_HAPPY_EYEBALLS_H
+
+#include <libssh/libssh.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "socket_util.h"
+
+namespace libssh_node {
+
+// RFC 8305 style TCP connect for the connect stage. Every address of the
+// host is resolved off the reactor thread, then connection attempts are
+// raced: a new one starts whenever the last fails or has been pending
+// for 250ms, alternating address families. The first socket to
+// connect wins and the rest are closed, so a dead IPv6 route costs one
+// attempt delay instead of the whole connect timeout.
+class HappyEyeballs {
+public:
+  HappyEyeballs(std::string host, int port);
+  ~HappyEyeballs();
+
+  // Reactor thread. SSH_AGAIN while resolving or connecting, SSH_OK once
+  // a socket has connected (see TakeSocket()), SSH_ERROR when every
+  // address has failed. Sockets in flight are registered with event so
+  // their completion wakes the reactor.
+  int Step(ssh_event event);
+  // Reactor thread. Unregisters and closes whatever is still in flight;
+  // must run before the race is destroyed.
+  void Finish();
+
+  // The connected socket, now owned by the caller
+  socket_t TakeSocket();
+
+  const std::string& error() const { return error_; }
+  const std::string& address() const { return address_; } // Winning address
+  double resolveMs() const { return resolveMs_; }
+  double connectMs() const { return connectMs_; }
+  size_t attempts() const { return attempts_; }
+
+private:
+  struct Address {
+    struct sockaddr_storage addr;
+    socklen_t length;
+  };
+
+  // Shared with the resolver thread, which may outlive the race
+  struct Resolution;
+
+  struct Attempt {
+    socket_t fd;
+    std::string address;
+  };
+
+  static std::vector<Address> Lookup(const std::string& host, int port, int flags, std::string& error);
+  bool Resolve(ssh_event event);      // True once the address list is known
+  bool StartAttempt(ssh_event event); // False if the attempt failed at once
+  void CloseAttempt(Attempt& attempt);
+
+  std::string host_;
+  int port_;
+  ssh_event event_;
+  std::shared_ptr<Resolution> resolution_;
+  bool resolved_;
+  std::vector<Address> addresses_; // Families interleaved
+  size_t next_;
+  std::vector<Attempt> inflight_;
+  socket_t winner_;
+
+  std::chrono::steady_clock::time_point started_;
+  std::chrono::steady_clock::time_point connectStarted_;
+  std::chrono::steady_clock::time_point lastAttempt_;
+  double resolveMs_;
+  double connectMs_;
+  size_t attempts_;
+  std::string address_;
+  std::string error_;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_HAPPY_EYEBALLS_H
@@ -0,0 +1,70 @@
+#ifndef LIBSSH_NODE_JUMP_TRANSPORT_H
+#define LIBSSH_NODE_JUMP_TRANSPORT_H
+
+#include <libssh/libssh.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "reactor.h"
+#include "socket_util.h"
+
+namespace libssh_node {
+
+// Carries a session over a direct-tcpip channel of another (jump) session
+// instead of a TCP connection. The inner session gets one end of a
+// socketpair through SSH_OPTIONS_FD, and the reactor pumps the other end
+// to and from the channel, so a jump costs neither a process nor a pipe.
+// Chains work the same way: the jump session may itself ride on a
+// transport. The jump session must outlive the transport. While open, the
+// channel counts into the jump session's channelsOpen.
+class JumpTransport : public ReactorPoller {
+public:
+  JumpTransport(Reactor* reactor, ssh_session jump, std::shared_ptr<SessionStats> jumpStats, std::string host,
+                int port);
+  ~JumpTransport();
+
+  // Reactor thread. SSH_AGAIN while the channel opens, SSH_OK once it is
+  // open and pumping (see TakeSocket()), SSH_ERROR on failure.
+  int Open();
+  // Reactor thread. Closes the channel and the socket; idempotent.
+  void Close();
+
+  // The inner session's end of the socketpair, now owned by the caller
+  socket_t TakeSocket();
+
+  const std::string& error() const { return error_; }
+
+private:
+  // Reactor thread
+  bool Poll() override;
+  bool PumpToSocket();
+  bool PumpToChannel();
+  void UpdateInterest();
+
+  static int OnSocketReady(socket_t fd, int revents, void* userdata);
+
+  Reactor* reactor_;
+  ssh_session jump_;
+  std::shared_ptr<SessionStats> jumpStats_;
+  std::string host_;
+  int port_;
+  ssh_channel channel_;
+  socket_t fds_[2]; // Ours, then the inner session's until taken
+  bool open_;
+  bool closed_;
+  bool socketEof_;  // The inner session closed its end
+  bool channelEof_; // EOF from the far side of the channel
+  bool shutdown_;   // Passed that EOF on to the inner session
+  short events_;    // Events currently registered with the ssh_event
+
+  // Bytes accepted from one side that the other side could not take yet
+  std::vector<char> toSocket_;
+  size_t toSocketOffset_;
+  std::vector<char> toChannel_;
+  size_t toChannelOffset_;
+  std::string error_;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_JUMP_TRANSPORT_H
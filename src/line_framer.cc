@@ -0,0 +1,105 @@
+#include "line_framer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace libssh_node {
+
+Napi::Array LineBatch::ToArray(Napi::Env env) const {
+  Napi::Array lines = Napi::Array::New(env, ends.size());
+  size_t start = 0;
+  for (size_t i = 0; i < ends.size(); i++) {
+    lines.Set(static_cast<uint32_t>(i), Napi::String::New(env, text.data() + start, ends[i] - start));
+    start = ends[i];
+  }
+  return lines;
+}
+
+namespace {
+
+// Moves a cut at offset back to the start of the UTF-8 sequence it would
+// split, so neither piece decodes to U+FFFD. Input that is not UTF-8 is
+// cut where asked.
+size_t Utf8Boundary(const std::vector<char>& text, size_t offset) {
+  size_t cut = offset;
+  while (cut > 0 && offset - cut < 3 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) {
+    cut--;
+  }
+  bool lead = (static_cast<unsigned char>(text[cut]) & 0xC0) == 0xC0;
+  return cut > 0 && lead ? cut : offset;
+}
+
+} // namespace
+
+LineFramer::LineFramer(size_t maxBatch, size_t maxLineLength)
+    : maxBatch_(std::max<size_t>(maxBatch, 1)), maxLineLength_(std::max<size_t>(maxLineLength, 1)) {}
+
+void LineFramer::Push(const char* data, size_t length) {
+  const char* end = data + length;
+
+  while (data < end) {
+    // memchr is vectorized by the C library, so long lines scan quickly
+    const char* newline = static_cast<const char*>(std::memchr(data, '\n', end - data));
+    if (newline == nullptr) {
+      partial_.insert(partial_.end(), data, end);
+      // Only once the byte after the cut is here, to see where it falls
+      while (partial_.size() > maxLineLength_) {
+        size_t cut = Utf8Boundary(partial_, maxLineLength_);
+        AddLine(partial_.data(), cut);
+        partial_.erase(partial_.begin(), partial_.begin() + cut);
+      }
+      return;
+    }
+
+    size_t lineLength = newline - data;
+    if (lineLength > 0 && data[lineLength - 1] == '\r') {
+      lineLength--;
+    }
+
+    if (partial_.empty()) {
+      // Common case: the whole line is in this chunk, copy it once
+      AddLine(data, lineLength);
+    } else {
+      partial_.insert(partial_.end(), data, data + lineLength);
+      if (!partial_.empty() && partial_.back() == '\r' && lineLength == 0) {
+        partial_.pop_back();
+      }
+      AddLine(partial_.data(), partial_.size());
+      partial_.clear();
+    }
+    data = newline + 1;
+  }
+}
+
+void LineFramer::Finish() {
+  if (!partial_.empty()) {
+    AddLine(partial_.data(), partial_.size());
+    partial_.clear();
+  }
+}
+
+LineBatch LineFramer::Take() {
+  LineBatch batch;
+  if (!full_.empty()) {
+    batch = std::move(full_.front());
+    full_.pop_front();
+  } else {
+    batch = std::move(current_);
+    current_ = LineBatch();
+  }
+  return batch;
+}
+
+void LineFramer::AddLine(const char* data, size_t length) {
+  if (current_.size() == 0) {
+    firstLineAt_ = std::chrono::steady_clock::now();
+  }
+  current_.text.insert(current_.text.end(), data, data + length);
+  current_.ends.push_back(current_.text.size());
+
+  if (current_.size() >= maxBatch_) {
+    full_.push_back(std::move(current_));
+    current_ = LineBatch();
+  }
+}
+
+} // namespace libssh_node
@@ -0,0 +1,55 @@
+#ifndef LIBSSH_NODE_LINE_FRAMER_H
+#define LIBSSH_NODE_LINE_FRAMER_H
+
+#include <napi.h>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace libssh_node {
+
+// Complete lines packed into one buffer; line i ends at ends[i]
+struct LineBatch {
+  std::vector<char> text;
+  std::vector<size_t> ends;
+
+  size_t size() const { return ends.size(); }
+  Napi::Array ToArray(Napi::Env env) const;
+};
+
+// Splits a byte stream into lines and groups them into batches of up to
+// maxBatch lines. A trailing partial line is carried into the next Push().
+// Lines longer than maxLineLength are split, before a UTF-8 sequence
+// rather than inside it, so a stream without newlines cannot grow without
+// bound. "\r\n" endings are stripped like "\n".
+class LineFramer {
+public:
+  LineFramer(size_t maxBatch, size_t maxLineLength);
+
+  void Push(const char* data, size_t length);
+  void Finish(); // End of stream: the partial line becomes a line
+
+  bool HasFullBatch() const { return !full_.empty(); }
+  bool HasLines() const { return !full_.empty() || current_.size() > 0; }
+
+  // A full batch if one is ready, otherwise the lines gathered so far
+  LineBatch Take();
+
+  // When the oldest line waiting in the current batch arrived
+  std::chrono::steady_clock::time_point firstLineAt() const { return firstLineAt_; }
+
+private:
+  void AddLine(const char* data, size_t length);
+
+  size_t maxBatch_;
+  size_t maxLineLength_;
+  std::vector<char> partial_;
+  LineBatch current_;
+  std::deque<LineBatch> full_;
+  std::chrono::steady_clock::time_point firstLineAt_;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_LINE_FRAMER_H
@@ -0,0 +1,434 @@
+#include "reactor.h"
+#include "addon_data.h"
+#include "socket_util.h"
+#include "utils.h"
+#include <algorithm>
+
+namespace libssh_node {
+
+namespace {
+
+constexpr int kIdlePollMs = 1000;
+// Upper bound on how long a pending operation waits for its retry when no
+// socket event arrives (e.g. a state change libssh made without I/O)
+constexpr int kPendingPollMs = 100;
+
+} // namespace
+
+void ReactorCallJs(Napi::Env env, Napi::Function callback, Reactor* reactor, ReactorJsTask* task) {
+  if (env != nullptr && task != nullptr) {
+    (*task)(env);
+  }
+  delete task;
+}
+
+// ReactorWorker
+ReactorWorker::ReactorWorker(Napi::Env env, Napi::Object owner, OperationStats* stats)
+    : env_(env), reactor_(Reactor::Get(env)), ownerRef_(Napi::Persistent(owner)), errorCode_(nullptr),
+      stats_(stats), running_(false), aborted_(std::make_shared<std::atomic<bool>>(false)),
+      hasDeadline_(false) {
+  if (stats_ != nullptr) {
+    queuedAt_ = std::chrono::steady_clock::now();
+  }
+}
+
+void ReactorWorker::SetCancellation(const Napi::Value& options, bool withTimeout) {
+  if (!options.IsObject()) {
+    return;
+  }
+  Napi::Object object = options.As<Napi::Object>();
+
+  int timeoutMs = withTimeout ? GetIntOption(object, "timeoutMs", 0) : 0;
+  if (timeoutMs > 0) {
+    hasDeadline_ = true;
+    deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  }
+
+  Napi::Value value = object.Get("signal");
+  if (!value.IsObject()) {
+    return;
+  }
+  Napi::Object signal = value.As<Napi::Object>();
+  if (signal.Get("aborted").ToBoolean().Value()) {
+    aborted_->store(true);
+    return;
+  }
+  Napi::Value addEventListener = signal.Get("addEventListener");
+  if (!addEventListener.IsFunction()) {
+    return;
+  }
+
+  // The listener may outlive the operation on a long-lived signal, so it
+  // holds only the flag and a weak reactor
+  std::shared_ptr<std::atomic<bool>> aborted = aborted_;
+  std::weak_ptr<Reactor> weakReactor = reactor_;
+  Napi::Function listener = Napi::Function::New(env_, [aborted, weakReactor](const Napi::CallbackInfo& info) {
+    aborted->store(true);
+    if (std::shared_ptr<Reactor> reactor = weakReactor.lock()) {
+      reactor->Wake();
+    }
+    return info.Env().Undefined();
+  });
+  addEventListener.As<Napi::Function>().Call(signal, {Napi::String::New(env_, "abort"), listener});
+  signalRef_ = Napi::Persistent(signal);
+  abortListener_ = Napi::Persistent(listener);
+}
+
+void ReactorWorker::Queue() {
+  reactor_->Submit(this);
+}
+
+void ReactorWorker::SetError(const std::string& message) {
+  error_ = message;
+}
+
+double ReactorWorker::ElapsedMs() const {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startedAt_).count();
+}
+
+int ReactorWorker::Step() {
+  if (!running_) {
+    running_ = true;
+    startedAt_ = std::chrono::steady_clock::now();
+    if (stats_ != nullptr) {
+      stats_->queueWait.Record(startedAt_ - queuedAt_);
+    }
+  }
+
+  int result = Execute();
+  if (result != SSH_AGAIN && stats_ != nullptr) {
+    stats_->execute.Record(std::chrono::steady_clock::now() - startedAt_);
+  }
+  return result;
+}
+
+bool ReactorWorker::Expire() {
+  if (aborted_->load()) {
+    error_ = "Operation aborted";
+    errorCode_ = "ABORT_ERR";
+  } else if (hasDeadline_ && std::chrono::steady_clock::now() >= deadline_) {
+    error_ = "Operation timed out";
+    errorCode_ = "ETIMEDOUT";
+  } else {
+    return false;
+  }
+
+  Cancel();
+  if (running_ && stats_ != nullptr) {
+    stats_->execute.Record(std::chrono::steady_clock::now() - startedAt_);
+  }
+  return true;
+}
+
+int ReactorWorker::RemainingMs() const {
+  if (!hasDeadline_) {
+    return -1;
+  }
+  auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline_ - std::chrono::steady_clock::now());
+  return static_cast<int>(std::max<int64_t>(remaining.count(), 0));
+}
+
+void ReactorWorker::Complete() {
+  Napi::HandleScope scope(env_);
+  std::shared_ptr<Reactor> reactor = reactor_;
+
+  if (!abortListener_.IsEmpty()) {
+    Napi::Object signal = signalRef_.Value();
+    Napi::Value removeEventListener = signal.Get("removeEventListener");
+    if (removeEventListener.IsFunction()) {
+      removeEventListener.As<Napi::Function>().Call(signal, {Napi::String::New(env_, "abort"),
+                                                             abortListener_.Value()});
+    }
+  }
+
+  if (error_.empty()) {
+    OnOK();
+  } else if (errorCode_ != nullptr) {
+    Napi::Error error = Napi::Error::New(env_, error_);
+    error.Set("code", Napi::String::New(env_, errorCode_));
+    if (std::string(errorCode_) == "ABORT_ERR") {
+      error.Set("name", Napi::String::New(env_, "AbortError"));
+    }
+    OnError(error);
+  } else {
+    OnError(Napi::Error::New(env_, error_));
+  }
+
+  delete this;
+  reactor->Unref();
+}
+
+// Reactor
+std::shared_ptr<Reactor> Reactor::Get(Napi::Env env) {
+  AddonData* data = env.GetInstanceData<AddonData>();
+  if (!data->reactor) {
+    data->reactor = std::shared_ptr<Reactor>(new Reactor(env));
+  }
+  return data->reactor;
+}
+
+Reactor::Reactor(Napi::Env env)
+    : env_(env), refs_(0), stopping_(false), stopped_(false), cleanupHookRegistered_(true),
+      wakeFds_{SSH_INVALID_SOCKET, SSH_INVALID_SOCKET}, event_(nullptr) {
+  jsQueue_ = JsQueue::New(env, "libssh-node reactor", 0, 1, this);
+  // Only hold the event loop open while there is outstanding work
+  jsQueue_.Unref(env);
+
+  // Registered after the threadsafe function so it runs before Node
+  // tears the function down
+  napi_add_env_cleanup_hook(env, &Reactor::OnEnvCleanup, this);
+
+  CreateSocketPair(wakeFds_);
+  event_ = ssh_event_new();
+  ssh_event_add_fd(event_, wakeFds_[0], POLLIN, &Reactor::OnWake, this);
+
+  thread_ = std::thread(&Reactor::Run, this);
+}
+
+Reactor::~Reactor() {
+  Stop();
+  if (cleanupHookRegistered_) {
+    napi_remove_env_cleanup_hook(env_, &Reactor::OnEnvCleanup, this);
+  }
+}
+
+void Reactor::Submit(ReactorWorker* worker) {
+  Ref();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    incoming_.push_back(worker);
+  }
+  SignalWake(wakeFds_[1]);
+}
+
+void Reactor::Submit(const std::vector<ReactorWorker*>& workers) {
+  for (size_t i = 0; i < workers.size(); i++) {
+    Ref();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    incoming_.insert(incoming_.end(), workers.begin(), workers.end());
+  }
+  SignalWake(wakeFds_[1]);
+}
+
+void Reactor::Ref() {
+  if (refs_++ == 0) {
+    jsQueue_.Ref(env_);
+  }
+}
+
+void Reactor::Unref() {
+  if (refs_ > 0 && --refs_ == 0) {
+    jsQueue_.Unref(env_);
+  }
+}
+
+void Reactor::Post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stopped_) {
+      tasks_.push_back(std::move(task));
+      SignalWake(wakeFds_[1]);
+      return;
+    }
+  }
+  task();
+}
+
+void Reactor::Wake() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!stopped_) {
+    SignalWake(wakeFds_[1]);
+  }
+}
+
+void Reactor::CallJs(ReactorJsTask task) {
+  ReactorJsTask* data = new ReactorJsTask(std::move(task));
+  if (jsQueue_.NonBlockingCall(data) != napi_ok) {
+    delete data;
+  }
+}
+
+void Reactor::AddSession(ssh_session session, std::shared_ptr<std::atomic<bool>> alive) {
+  if (sessions_.count(session) > 0 || ssh_get_fd(session) == SSH_INVALID_SOCKET) {
+    return;
+  }
+  if (ssh_event_add_session(event_, session) == SSH_OK) {
+    sessions_.emplace(session, std::move(alive));
+  }
+}
+
+void Reactor::RemoveSession(ssh_session session) {
+  // The session frees its channels itself
+  reaping_.erase(std::remove_if(reaping_.begin(), reaping_.end(),
+                                [session](ssh_channel channel) { return ssh_channel_get_session(channel) == session; }),
+                 reaping_.end());
+
+  auto it = sessions_.find(session);
+  if (it == sessions_.end()) {
+    return;
+  }
+  if (it->second) {
+    it->second->store(false);
+  }
+  sessions_.erase(it);
+  ssh_event_remove_session(event_, session);
+}
+
+void Reactor::AddPoller(ReactorPoller* poller) {
+  pollers_.push_back(poller);
+}
+
+void Reactor::RemovePoller(ReactorPoller* poller) {
+  pollers_.erase(std::remove(pollers_.begin(), pollers_.end(), poller), pollers_.end());
+}
+
+void Reactor::ReapChannel(ssh_channel channel) {
+  reaping_.push_back(channel);
+}
+
+bool Reactor::ReapChannels() {
+  bool progress = false;
+  for (auto it = reaping_.begin(); it != reaping_.end();) {
+    // Only ever called on channels already opening: libssh then just
+    // waits for the server's answer, whatever the channel's type
+    int rc = ssh_channel_open_session(*it);
+    if (rc == SSH_AGAIN) {
+      ++it;
+      continue;
+    }
+    if (rc == SSH_OK) {
+      ssh_channel_close(*it);
+    }
+    ssh_channel_free(*it);
+    it = reaping_.erase(it);
+    progress = true;
+  }
+  return progress;
+}
+
+void Reactor::Run() {
+  std::vector<ReactorWorker*> incoming;
+  std::vector<std::function<void()>> tasks;
+
+  while (!stopping_) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      incoming.swap(incoming_);
+      tasks.swap(tasks_);
+    }
+
+    for (auto& task : tasks) {
+      task();
+    }
+    tasks.clear();
+
+    pending_.insert(pending_.end(), incoming.begin(), incoming.end());
+    incoming.clear();
+
+    bool progress = false;
+
+    // Each operation gets one non-blocking step per iteration; the ones
+    // that finish are handed back to the JS thread in completion order.
+    size_t count = pending_.size();
+    for (size_t i = 0; i < count; i++) {
+      ReactorWorker* worker = pending_.front();
+      pending_.pop_front();
+
+      // Aborted and timed-out operations never take another step
+      if (worker->Expire() || worker->Step() != SSH_AGAIN) {
+        CallJs([worker](Napi::Env) { worker->Complete(); });
+        progress = true;
+      } else {
+        pending_.push_back(worker);
+      }
+    }
+
+    if (ReapChannels()) {
+      progress = true;
+    }
+
+    int timeout = pending_.empty() && reaping_.empty() ? kIdlePollMs : kPendingPollMs;
+    for (ReactorWorker* worker : pending_) {
+      int remaining = worker->RemainingMs();
+      if (remaining >= 0 && remaining < timeout) {
+        timeout = remaining;
+      }
+    }
+    std::vector<ReactorPoller*> pollers = pollers_;
+    for (ReactorPoller* poller : pollers) {
+      if (poller->Poll()) {
+        progress = true;
+      }
+      int pollerTimeout = poller->TimeoutMs();
+      if (pollerTimeout >= 0 && pollerTimeout < timeout) {
+        timeout = pollerTimeout;
+      }
+    }
+
+    if (progress) {
+      timeout = 0;
+    }
+    ssh_event_dopoll(event_, timeout);
+
+    // Connections only drop while libssh reads or writes, i.e. in this thread
+    for (auto& entry : sessions_) {
+      if (entry.second && entry.second->load() && !ssh_is_connected(entry.first)) {
+        entry.second->store(false);
+      }
+    }
+  }
+}
+
+void Reactor::Stop() {
+  if (stopped_) {
+    return;
+  }
+
+  stopping_ = true;
+  SignalWake(wakeFds_[1]);
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  std::vector<std::function<void()>> tasks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    tasks.swap(tasks_);
+  }
+  for (auto& task : tasks) {
+    task();
+  }
+
+  // Hand the sessions back to their default poll contexts so they can
+  // still be disconnected and freed by their owners
+  for (auto& entry : sessions_) {
+    ssh_event_remove_session(event_, entry.first);
+  }
+  sessions_.clear();
+  pollers_.clear();
+  reaping_.clear();
+
+  ssh_event_remove_fd(event_, wakeFds_[0]);
+  ssh_event_free(event_);
+  event_ = nullptr;
+  CloseSocket(wakeFds_[0]);
+  CloseSocket(wakeFds_[1]);
+  wakeFds_[0] = wakeFds_[1] = SSH_INVALID_SOCKET;
+}
+
+void Reactor::OnEnvCleanup(void* arg) {
+  Reactor* reactor = static_cast<Reactor*>(arg);
+  reactor->cleanupHookRegistered_ = false;
+  reactor->Stop();
+  reactor->jsQueue_.Release();
+}
+
+int Reactor::OnWake(socket_t fd, int revents, void* userdata) {
+  DrainWake(fd);
+  return 0;
+}
+
+} // namespace libssh_node
@@ -0,0 +1,174 @@
+#ifndef LIBSSH_NODE_REACTOR_H
+#define LIBSSH_NODE_REACTOR_H
+
+#include <napi.h>
+#include <libssh/libssh.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "stats.h"
+
+namespace libssh_node {
+
+class Reactor;
+
+using ReactorJsTask = std::function<void(Napi::Env)>;
+
+// Dispatches completions queued by the reactor thread onto the JS thread
+void ReactorCallJs(Napi::Env env, Napi::Function callback, Reactor* reactor, ReactorJsTask* task);
+
+// Base class for SSH operations driven by the reactor. Mirrors
+// Napi::AsyncWorker: Execute() runs on the reactor thread, OnOK()/OnError()
+// on the JS thread. Execute() must only make non-blocking libssh calls and
+// returns SSH_AGAIN to be run again after the next poll. With stats, the
+// time spent waiting for the reactor and running is recorded there.
+class ReactorWorker {
+public:
+  ReactorWorker(Napi::Env env, Napi::Object owner, OperationStats* stats = nullptr);
+  virtual ~ReactorWorker() = default;
+
+  // JS thread, before Queue(). Reads { signal, timeoutMs } from options:
+  // the operation fails with an AbortError once the AbortSignal fires, or
+  // with ETIMEDOUT timeoutMs after this call. Without withTimeout only
+  // the signal is read, for operations whose timeoutMs means something
+  // else. Either way the reactor drops the operation at once.
+  void SetCancellation(const Napi::Value& options, bool withTimeout = true);
+
+  // Hand the operation to the reactor (JS thread)
+  void Queue();
+
+  Napi::Env Env() const { return env_; }
+
+protected:
+  virtual int Execute() = 0;
+  virtual void OnOK() = 0;
+  virtual void OnError(const Napi::Error& error) = 0;
+  // Reactor thread. Releases what an aborted or timed-out operation
+  // holds; OnError() follows. Runs whether or not Execute() ever did.
+  virtual void Cancel() {}
+
+  // Complete with OnError() instead of OnOK()
+  void SetError(const std::string& message);
+
+  Reactor* reactor() const { return reactor_.get(); }
+
+  // Reactor thread. Time since Execute() first ran.
+  double ElapsedMs() const;
+
+private:
+  int Step(); // Execute(), timed into stats_
+  bool Expire(); // Reactor thread: Cancel() if aborted or past the deadline
+  int RemainingMs() const; // Until the deadline, or -1 for none
+  void Complete();
+
+  Napi::Env env_;
+  std::shared_ptr<Reactor> reactor_;
+  Napi::ObjectReference ownerRef_; // Keep the owning wrapper alive while queued
+  std::string error_;
+  const char* errorCode_; // Set with error_ when the operation was cancelled
+  OperationStats* stats_;
+  std::chrono::steady_clock::time_point queuedAt_;
+  std::chrono::steady_clock::time_point startedAt_;
+  bool running_;
+
+  // Cancellation. The abort listener on the signal sets aborted_ from the
+  // JS thread and is removed again in Complete().
+  std::shared_ptr<std::atomic<bool>> aborted_;
+  bool hasDeadline_;
+  std::chrono::steady_clock::time_point deadline_;
+  Napi::ObjectReference signalRef_;
+  Napi::FunctionReference abortListener_;
+
+  friend class Reactor;
+};
+
+// Long-lived participants polled on every reactor iteration
+class ReactorPoller {
+public:
+  virtual ~ReactorPoller() = default;
+
+  // Returns true if progress was made, so the reactor polls again
+  // without sleeping
+  virtual bool Poll() = 0;
+
+  // Milliseconds until Poll() has timed work to do, or -1 for none
+  virtual int TimeoutMs() { return -1; }
+};
+
+// One thread per environment that owns every libssh session in
+// non-blocking mode and multiplexes them with a single ssh_event, so that
+// idle channels do not pin libuv threadpool threads. libssh objects are
+// only touched from this thread once a session is handed over.
+class Reactor {
+public:
+  static std::shared_ptr<Reactor> Get(Napi::Env env);
+  ~Reactor();
+
+  // JS thread
+  void Submit(ReactorWorker* worker);
+  void Submit(const std::vector<ReactorWorker*>& workers); // Same reactor iteration
+  void Ref();   // Keep the event loop alive (pending work, running tunnels)
+  void Unref();
+
+  // Any thread. Runs inline once the reactor has stopped.
+  void Post(std::function<void()> task);
+  void Wake(); // Re-run pollers after changing state they read
+  bool IsStopped() const { return stopped_; }
+
+  // Reactor thread
+  void CallJs(ReactorJsTask task);
+  // alive, if given, is set while the session is connected and cleared
+  // once the reactor sees the connection drop or the session is removed,
+  // so the JS thread can ask without calling into libssh
+  void AddSession(ssh_session session, std::shared_ptr<std::atomic<bool>> alive = nullptr);
+  void RemoveSession(ssh_session session);
+  void AddPoller(ReactorPoller* poller);
+  void RemovePoller(ReactorPoller* poller);
+  // Takes over a channel whose open was abandoned while the server had
+  // not answered it yet. It is closed and freed once the answer arrives,
+  // so the server does not keep a channel nobody will ever close.
+  void ReapChannel(ssh_channel channel);
+  ssh_event event() const { return event_; }
+
+private:
+  using JsQueue = Napi::TypedThreadSafeFunction<Reactor, ReactorJsTask, ReactorCallJs>;
+
+  explicit Reactor(Napi::Env env);
+  void Run();
+  bool ReapChannels();
+  void Stop();
+  static void OnEnvCleanup(void* arg);
+  static int OnWake(socket_t fd, int revents, void* userdata);
+
+  Napi::Env env_;
+  JsQueue jsQueue_;
+  int refs_; // JS thread only
+
+  std::thread thread_;
+  std::atomic<bool> stopping_;
+  std::atomic<bool> stopped_;
+  bool cleanupHookRegistered_;
+  socket_t wakeFds_[2];
+  ssh_event event_;
+
+  std::mutex mutex_;
+  std::vector<ReactorWorker*> incoming_;
+  std::vector<std::function<void()>> tasks_;
+
+  // Reactor thread only
+  std::deque<ReactorWorker*> pending_;
+  std::map<ssh_session, std::shared_ptr<std::atomic<bool>>> sessions_;
+  std::vector<ReactorPoller*> pollers_;
+  std::vector<ssh_channel> reaping_;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_REACTOR_H
@@ -0,0 +1,238 @@
+#include "session_options.h"
+#include "utils.h"
+#include <cstdint>
+
+namespace libssh_node {
+
+namespace {
+
+enum class OptionKind {
+  kString,
+  kList,    // Comma-separated string or array of strings
+  kYesNo,   // Boolean, or a string passed through ("yes", "no", algorithms)
+  kInt,
+  kIntFlag, // Boolean passed as int
+  kBool,
+  kUInt32,
+  kUInt64
+};
+
+struct SessionOption {
+  const char* name;
+  OptionKind kind;
+  ssh_options_e option;
+  ssh_options_e serverToClient; // Also set, for options covering both directions
+  bool bothDirections;
+  bool connectTarget; // host/port/user: set before the config file is parsed
+};
+
+constexpr SessionOption kOptions[] = {
+  {"host", OptionKind::kString, SSH_OPTIONS_HOST, SSH_OPTIONS_HOST, false, true},
+  {"port", OptionKind::kInt, SSH_OPTIONS_PORT, SSH_OPTIONS_PORT, false, true},
+  {"user", OptionKind::kString, SSH_OPTIONS_USER, SSH_OPTIONS_USER, false, true},
+  {"agentSocket", OptionKind::kString, SSH_OPTIONS_IDENTITY_AGENT, SSH_OPTIONS_IDENTITY_AGENT, false, false},
+  {"identity", OptionKind::kString, SSH_OPTIONS_ADD_IDENTITY, SSH_OPTIONS_ADD_IDENTITY, false, false},
+  {"sshDir", OptionKind::kString, SSH_OPTIONS_SSH_DIR, SSH_OPTIONS_SSH_DIR, false, false},
+  {"knownHosts", OptionKind::kString, SSH_OPTIONS_KNOWNHOSTS, SSH_OPTIONS_KNOWNHOSTS, false, false},
+  {"globalKnownHosts", OptionKind::kString, SSH_OPTIONS_GLOBAL_KNOWNHOSTS, SSH_OPTIONS_GLOBAL_KNOWNHOSTS,
+   false, false},
+  {"proxyCommand", OptionKind::kString, SSH_OPTIONS_PROXYCOMMAND, SSH_OPTIONS_PROXYCOMMAND, false, false},
+  {"bindAddress", OptionKind::kString, SSH_OPTIONS_BINDADDR, SSH_OPTIONS_BINDADDR, false, false},
+  {"logVerbosity", OptionKind::kInt, SSH_OPTIONS_LOG_VERBOSITY, SSH_OPTIONS_LOG_VERBOSITY, false, false},
+
+  // Algorithm preference lists, most preferred first
+  {"ciphers", OptionKind::kList, SSH_OPTIONS_CIPHERS_C_S, SSH_OPTIONS_CIPHERS_S_C, true, false},
+  {"ciphersClientToServer", OptionKind::kList, SSH_OPTIONS_CIPHERS_C_S, SSH_OPTIONS_CIPHERS_C_S, false, false},
+  {"ciphersServerToClient", OptionKind::kList, SSH_OPTIONS_CIPHERS_S_C, SSH_OPTIONS_CIPHERS_S_C, false, false},
+  {"macs", OptionKind::kList, SSH_OPTIONS_HMAC_C_S, SSH_OPTIONS_HMAC_S_C, true, false},
+  {"macsClientToServer", OptionKind::kList, SSH_OPTIONS_HMAC_C_S, SSH_OPTIONS_HMAC_C_S, false, false},
+  {"macsServerToClient", OptionKind::kList, SSH_OPTIONS_HMAC_S_C, SSH_OPTIONS_HMAC_S_C, false, false},
+  {"kex", OptionKind::kList, SSH_OPTIONS_KEY_EXCHANGE, SSH_OPTIONS_KEY_EXCHANGE, false, false},
+  {"hostKeyAlgorithms", OptionKind::kList, SSH_OPTIONS_HOSTKEYS, SSH_OPTIONS_HOSTKEYS, false, false},
+  {"publicKeyAcceptedTypes", OptionKind::kList, SSH_OPTIONS_PUBLICKEY_ACCEPTED_TYPES,
+   SSH_OPTIONS_PUBLICKEY_ACCEPTED_TYPES, false, false},
+
+  {"compression", OptionKind::kYesNo, SSH_OPTIONS_COMPRESSION, SSH_OPTIONS_COMPRESSION, false, false},
+  {"compressionClientToServer", OptionKind::kYesNo, SSH_OPTIONS_COMPRESSION_C_S, SSH_OPTIONS_COMPRESSION_C_S,
+   false, false},
+  {"compressionServerToClient", OptionKind::kYesNo, SSH_OPTIONS_COMPRESSION_S_C, SSH_OPTIONS_COMPRESSION_S_C,
+   false, false},
+  {"compressionLevel", OptionKind::kInt, SSH_OPTIONS_COMPRESSION_LEVEL, SSH_OPTIONS_COMPRESSION_LEVEL, false, false},
+  {"rekeyData", OptionKind::kUInt64, SSH_OPTIONS_REKEY_DATA, SSH_OPTIONS_REKEY_DATA, false, false},
+  {"rekeyTime", OptionKind::kUInt32, SSH_OPTIONS_REKEY_TIME, SSH_OPTIONS_REKEY_TIME, false, false},
+  {"nodelay", OptionKind::kIntFlag, SSH_OPTIONS_NODELAY, SSH_OPTIONS_NODELAY, false, false},
+
+  {"strictHostKeyChecking", OptionKind::kIntFlag, SSH_OPTIONS_STRICTHOSTKEYCHECK, SSH_OPTIONS_STRICTHOSTKEYCHECK,
+   false, false},
+  {"processConfig", OptionKind::kBool, SSH_OPTIONS_PROCESS_CONFIG, SSH_OPTIONS_PROCESS_CONFIG, false, false},
+  {"passwordAuth", OptionKind::kIntFlag, SSH_OPTIONS_PASSWORD_AUTH, SSH_OPTIONS_PASSWORD_AUTH, false, false},
+  {"publicKeyAuth", OptionKind::kIntFlag, SSH_OPTIONS_PUBKEY_AUTH, SSH_OPTIONS_PUBKEY_AUTH, false, false},
+  {"kbdintAuth", OptionKind::kIntFlag, SSH_OPTIONS_KBDINT_AUTH, SSH_OPTIONS_KBDINT_AUTH, false, false},
+  {"gssapiAuth", OptionKind::kIntFlag, SSH_OPTIONS_GSSAPI_AUTH, SSH_OPTIONS_GSSAPI_AUTH, false, false},
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 10, 0)
+  {"identitiesOnly", OptionKind::kBool, SSH_OPTIONS_IDENTITIES_ONLY, SSH_OPTIONS_IDENTITIES_ONLY, false, false},
+  {"rsaMinSize", OptionKind::kInt, SSH_OPTIONS_RSA_MIN_SIZE, SSH_OPTIONS_RSA_MIN_SIZE, false, false},
+#endif
+};
+
+const SessionOption* FindOption(const std::string& name) {
+  for (const SessionOption& option : kOptions) {
+    if (name == option.name) {
+      return &option;
+    }
+  }
+  return nullptr;
+}
+
+// Converts value for the option's kind and hands it to libssh, storing
+// its result. Returns false when the value has the wrong type.
+bool SetOption(ssh_session session, const SessionOption& option, ssh_options_e which, const Napi::Value& value,
+               int* result) {
+  switch (option.kind) {
+    case OptionKind::kString:
+      if (!value.IsString()) {
+        return false;
+      }
+      *result = ssh_options_set(session, which, value.As<Napi::String>().Utf8Value().c_str());
+      return true;
+
+    case OptionKind::kList: {
+      std::string list;
+      if (value.IsString()) {
+        list = value.As<Napi::String>().Utf8Value();
+      } else if (value.IsArray()) {
+        Napi::Array entries = value.As<Napi::Array>();
+        for (uint32_t i = 0; i < entries.Length(); i++) {
+          Napi::Value entry = entries.Get(i);
+          if (!entry.IsString()) {
+            return false;
+          }
+          list += (i > 0 ? "," : "") + entry.As<Napi::String>().Utf8Value();
+        }
+      } else {
+        return false;
+      }
+      *result = ssh_options_set(session, which, list.c_str());
+      return true;
+    }
+
+    case OptionKind::kYesNo:
+      if (value.IsBoolean()) {
+        *result = ssh_options_set(session, which, value.As<Napi::Boolean>().Value() ? "yes" : "no");
+        return true;
+      }
+      if (!value.IsString()) {
+        return false;
+      }
+      *result = ssh_options_set(session, which, value.As<Napi::String>().Utf8Value().c_str());
+      return true;
+
+    case OptionKind::kInt: {
+      if (!value.IsNumber()) {
+        return false;
+      }
+      int number = value.As<Napi::Number>().Int32Value();
+      *result = ssh_options_set(session, which, &number);
+      return true;
+    }
+
+    case OptionKind::kIntFlag: {
+      if (!value.IsBoolean()) {
+        return false;
+      }
+      int flag = value.As<Napi::Boolean>().Value() ? 1 : 0;
+      *result = ssh_options_set(session, which, &flag);
+      return true;
+    }
+
+    case OptionKind::kBool: {
+      if (!value.IsBoolean()) {
+        return false;
+      }
+      bool flag = value.As<Napi::Boolean>().Value();
+      *result = ssh_options_set(session, which, &flag);
+      return true;
+    }
+
+    case OptionKind::kUInt32: {
+      if (!value.IsNumber() || value.As<Napi::Number>().DoubleValue() < 0) {
+        return false;
+      }
+      uint32_t number = value.As<Napi::Number>().Uint32Value();
+      *result = ssh_options_set(session, which, &number);
+      return true;
+    }
+
+    case OptionKind::kUInt64: {
+      if (!value.IsNumber() || value.As<Napi::Number>().DoubleValue() < 0) {
+        return false;
+      }
+      uint64_t number = static_cast<uint64_t>(value.As<Napi::Number>().DoubleValue());
+      *result = ssh_options_set(session, which, &number);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* KindName(OptionKind kind) {
+  switch (kind) {
+    case OptionKind::kString: return "a string";
+    case OptionKind::kList: return "a string or an array of strings";
+    case OptionKind::kYesNo: return "a boolean or a string";
+    case OptionKind::kInt: return "a number";
+    case OptionKind::kUInt32:
+    case OptionKind::kUInt64: return "a non-negative number";
+    case OptionKind::kIntFlag:
+    case OptionKind::kBool: return "a boolean";
+  }
+  return "a valid value";
+}
+
+bool Set(Napi::Env env, ssh_session session, const SessionOption& option, const Napi::Value& value) {
+  int result = SSH_OK;
+  bool converted = SetOption(session, option, option.option, value, &result);
+  if (converted && result == SSH_OK && option.bothDirections) {
+    converted = SetOption(session, option, option.serverToClient, value, &result);
+  }
+
+  if (!converted) {
+    Napi::TypeError::New(env, std::string("Option ") + option.name + " must be " + KindName(option.kind))
+      .ThrowAsJavaScriptException();
+    return false;
+  }
+  if (result != SSH_OK) {
+    CreateSSHError(env, session, std::string("Failed to set option ") + option.name).ThrowAsJavaScriptException();
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool SetSessionOption(Napi::Env env, ssh_session session, const std::string& name, const Napi::Value& value) {
+  const SessionOption* option = FindOption(name);
+  if (option == nullptr) {
+    Napi::Error::New(env, "Unknown option: " + name).ThrowAsJavaScriptException();
+    return false;
+  }
+  return Set(env, session, *option, value);
+}
+
+bool ApplySessionOptions(Napi::Env env, ssh_session session, const Napi::Object& options) {
+  for (const SessionOption& option : kOptions) {
+    if (option.connectTarget || !options.Has(option.name)) {
+      continue;
+    }
+    Napi::Value value = options.Get(option.name);
+    if (value.IsUndefined() || value.IsNull()) {
+      continue;
+    }
+    if (!Set(env, session, option, value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace libssh_node
@@ -0,0 +1,22 @@
+#ifndef LIBSSH_NODE_SESSION_OPTIONS_H
+#define LIBSSH_NODE_SESSION_OPTIONS_H
+
+#include <napi.h>
+#include <libssh/libssh.h>
+#include <string>
+
+namespace libssh_node {
+
+// Sets one libssh option by its JS name (host, ciphers, kex, rekeyData,
+// ...). Throws and returns false for an unknown name, a value of the
+// wrong type, or a value libssh rejects.
+bool SetSessionOption(Napi::Env env, ssh_session session, const std::string& name, const Napi::Value& value);
+
+// Applies every option in a constructor options object except host, port
+// and user, which have to be set before the config file is parsed.
+// Throws and returns false on the first failure.
+bool ApplySessionOptions(Napi::Env env, ssh_session session, const Napi::Object& options);
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_SESSION_OPTIONS_H
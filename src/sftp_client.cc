@@ -0,0 +1,551 @@
+#include "sftp_client.h"
+#include <algorithm>
+
+namespace libssh_node {
+
+namespace {
+
+constexpr uint32_t kSftpVersion = 3;
+
+// Packet types (draft-ietf-secsh-filexfer-02)
+constexpr uint8_t kFxpInit = 1;
+constexpr uint8_t kFxpVersion = 2;
+constexpr uint8_t kFxpOpen = 3;
+constexpr uint8_t kFxpClose = 4;
+constexpr uint8_t kFxpRead = 5;
+constexpr uint8_t kFxpWrite = 6;
+constexpr uint8_t kFxpOpenDir = 11;
+constexpr uint8_t kFxpReadDir = 12;
+constexpr uint8_t kFxpStat = 17;
+constexpr uint8_t kFxpStatus = 101;
+constexpr uint8_t kFxpHandle = 102;
+constexpr uint8_t kFxpData = 103;
+constexpr uint8_t kFxpName = 104;
+constexpr uint8_t kFxpAttrs = 105;
+constexpr uint8_t kFxpExtended = 200;
+constexpr uint8_t kFxpExtendedReply = 201;
+
+// Attribute flags
+constexpr uint32_t kAttrSize = 0x01;
+constexpr uint32_t kAttrUidGid = 0x02;
+constexpr uint32_t kAttrPermissions = 0x04;
+constexpr uint32_t kAttrAcModTime = 0x08;
+constexpr uint32_t kAttrExtended = 0x80000000;
+
+constexpr const char* kLimitsExtension = "limits@openssh.com";
+
+// OpenSSH's server sends at most 256KB; leave room for others
+constexpr uint32_t kMaxPacketLength = 1024 * 1024;
+constexpr size_t kReadChunkSize = 65536;
+// Consumed bytes kept at the front of a buffer before it is compacted
+constexpr size_t kCompactBytes = 256 * 1024;
+
+const char* const kStatusNames[] = {
+  "Success", "End of file", "No such file", "Permission denied", "Failure",
+  "Bad message", "No connection", "Connection lost", "Operation unsupported"
+};
+
+uint32_t GetU32(const char* data) {
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+void PutU32(std::string& data, uint32_t value) {
+  data.push_back(static_cast<char>(value >> 24));
+  data.push_back(static_cast<char>(value >> 16));
+  data.push_back(static_cast<char>(value >> 8));
+  data.push_back(static_cast<char>(value));
+}
+
+void PutU64(std::string& data, uint64_t value) {
+  PutU32(data, static_cast<uint32_t>(value >> 32));
+  PutU32(data, static_cast<uint32_t>(value));
+}
+
+void PutString(std::string& data, const char* value, size_t length) {
+  PutU32(data, static_cast<uint32_t>(length));
+  data.append(value, length);
+}
+
+void PutString(std::string& data, const std::string& value) {
+  PutString(data, value.data(), value.size());
+}
+
+// Bounds-checked decoding of a reply body
+class Reader {
+public:
+  Reader(const char* data, size_t length) : p_(data), end_(data + length) {}
+  explicit Reader(const std::string& data) : Reader(data.data(), data.size()) {}
+
+  bool AtEnd() const { return p_ == end_; }
+
+  bool U32(uint32_t* value) {
+    if (end_ - p_ < 4) {
+      return false;
+    }
+    *value = GetU32(p_);
+    p_ += 4;
+    return true;
+  }
+
+  bool U64(uint64_t* value) {
+    uint32_t high;
+    uint32_t low;
+    if (!U32(&high) || !U32(&low)) {
+      return false;
+    }
+    *value = (uint64_t(high) << 32) | low;
+    return true;
+  }
+
+  bool String(const char** data, size_t* length) {
+    uint32_t size;
+    if (!U32(&size) || static_cast<size_t>(end_ - p_) < size) {
+      return false;
+    }
+    *data = p_;
+    *length = size;
+    p_ += size;
+    return true;
+  }
+
+  bool String(std::string* value) {
+    const char* data;
+    size_t length;
+    if (!String(&data, &length)) {
+      return false;
+    }
+    value->assign(data, length);
+    return true;
+  }
+
+  bool Attributes(SftpAttributes* attributes) {
+    uint32_t unused;
+    if (!U32(&attributes->flags)) {
+      return false;
+    }
+    if ((attributes->flags & kAttrSize) && !U64(&attributes->size)) {
+      return false;
+    }
+    if ((attributes->flags & kAttrUidGid) && (!U32(&unused) || !U32(&unused))) {
+      return false;
+    }
+    if ((attributes->flags & kAttrPermissions) && !U32(&attributes->permissions)) {
+      return false;
+    }
+    if ((attributes->flags & kAttrAcModTime) && (!U32(&unused) || !U32(&attributes->mtime))) {
+      return false;
+    }
+    if (attributes->flags & kAttrExtended) {
+      uint32_t count;
+      if (!U32(&count)) {
+        return false;
+      }
+      for (uint32_t i = 0; i < count; i++) {
+        const char* data;
+        size_t length;
+        if (!String(&data, &length) || !String(&data, &length)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+private:
+  const char* p_;
+  const char* end_;
+};
+
+std::string WithSshError(ssh_session session, const char* message) {
+  const char* error = ssh_get_error(session);
+  return error && *error ? std::string(message) + ": " + error : message;
+}
+
+} // namespace
+
+// SftpReply
+bool SftpReply::Status(uint32_t* code, std::string* message) const {
+  if (type != kFxpStatus) {
+    return false;
+  }
+  Reader reader(body);
+  if (!reader.U32(code)) {
+    return false;
+  }
+  // Version 3 servers may leave out the message and language tag
+  if (message != nullptr && !reader.String(message)) {
+    message->clear();
+  }
+  return true;
+}
+
+bool SftpReply::Handle(std::string* handle) const {
+  return type == kFxpHandle && Reader(body).String(handle);
+}
+
+bool SftpReply::Data(const char** data, size_t* length) const {
+  return type == kFxpData && Reader(body).String(data, length);
+}
+
+bool SftpReply::Attributes(SftpAttributes* attributes) const {
+  return type == kFxpAttrs && Reader(body).Attributes(attributes);
+}
+
+bool SftpReply::Names(std::vector<SftpName>* names) const {
+  if (type != kFxpName) {
+    return false;
+  }
+  Reader reader(body);
+  uint32_t count;
+  if (!reader.U32(&count)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    SftpName name;
+    const char* longName;
+    size_t longNameLength;
+    if (!reader.String(&name.name) || !reader.String(&longName, &longNameLength) ||
+        !reader.Attributes(&name.attributes)) {
+      return false;
+    }
+    names->push_back(std::move(name));
+  }
+  return true;
+}
+
+std::string SftpReply::Error() const {
+  uint32_t code;
+  std::string message;
+  if (!Status(&code, &message)) {
+    return "Unexpected SFTP reply";
+  }
+  if (!message.empty()) {
+    return message;
+  }
+  return code < sizeof(kStatusNames) / sizeof(kStatusNames[0]) ? kStatusNames[code] : "Unknown error";
+}
+
+// SftpClient
+SftpClient::SftpClient(ssh_session session, std::shared_ptr<SessionStats> stats)
+    : session_(session), stats_(std::move(stats)), channel_(nullptr), counted_(false), state_(State::kOpen),
+      nextId_(1), limitsId_(0), outOffset_(0), packetStart_(0), inOffset_(0) {}
+
+int SftpClient::Start() {
+  if (state_ == State::kOpen) {
+    if (channel_ == nullptr) {
+      channel_ = ssh_channel_new(session_);
+      if (channel_ == nullptr) {
+        Fail(WithSshError(session_, "Failed to create channel"));
+        return SSH_ERROR;
+      }
+    }
+
+    int rc = ssh_channel_open_session(channel_);
+    if (rc == SSH_AGAIN) {
+      return rc;
+    }
+    if (rc != SSH_OK) {
+      Fail(WithSshError(session_, "Failed to open SFTP channel"));
+      return SSH_ERROR;
+    }
+    if (stats_) {
+      stats_->channelsOpen.fetch_add(1, std::memory_order_relaxed);
+      counted_ = true;
+    }
+    state_ = State::kSubsystem;
+  }
+
+  if (state_ == State::kSubsystem) {
+    int rc = ssh_channel_request_subsystem(channel_, "sftp");
+    if (rc == SSH_AGAIN) {
+      return rc;
+    }
+    if (rc != SSH_OK) {
+      Fail(WithSshError(session_, "Failed to start SFTP subsystem"));
+      return SSH_ERROR;
+    }
+
+    // INIT carries the version where other requests have their id
+    PutU32(out_, 5);
+    out_.push_back(static_cast<char>(kFxpInit));
+    PutU32(out_, kSftpVersion);
+    state_ = State::kVersion;
+  }
+
+  Flush();
+  Pump();
+  if (state_ == State::kFailed) {
+    return SSH_ERROR;
+  }
+  return state_ == State::kReady ? SSH_OK : SSH_AGAIN;
+}
+
+void SftpClient::Close() {
+  if (channel_ != nullptr) {
+    ssh_channel_free(channel_);
+    channel_ = nullptr;
+  }
+  if (counted_) {
+    stats_->channelsOpen.fetch_sub(1, std::memory_order_relaxed);
+    counted_ = false;
+  }
+  if (state_ != State::kFailed) {
+    Fail("SFTP session is closed");
+  }
+  replies_.clear();
+  forgotten_.clear();
+}
+
+void SftpClient::Fail(const std::string& message) {
+  state_ = State::kFailed;
+  error_ = message;
+  out_.clear();
+  outOffset_ = 0;
+}
+
+void SftpClient::Pump() {
+  if (channel_ == nullptr || state_ == State::kFailed) {
+    return;
+  }
+
+  char buffer[kReadChunkSize];
+  for (int isStderr = 0; isStderr <= 1; isStderr++) {
+    for (;;) {
+      int n = ssh_channel_read_nonblocking(channel_, buffer, sizeof(buffer), isStderr);
+      if (n == SSH_ERROR) {
+        Fail(WithSshError(session_, "SFTP channel failed"));
+        return;
+      }
+      if (n <= 0) {
+        break;
+      }
+      // Nothing useful arrives on stderr, but left unread it would hold
+      // the window shut
+      if (!isStderr) {
+        in_.append(buffer, static_cast<size_t>(n));
+      }
+    }
+  }
+
+  if (!Parse()) {
+    return;
+  }
+  if (ssh_channel_is_eof(channel_) || ssh_channel_is_closed(channel_)) {
+    Fail("SFTP channel closed");
+  }
+}
+
+bool SftpClient::Parse() {
+  while (in_.size() - inOffset_ >= 4) {
+    uint32_t length = GetU32(in_.data() + inOffset_);
+    if (length == 0 || length > kMaxPacketLength) {
+      Fail("Malformed SFTP packet");
+      return false;
+    }
+    if (in_.size() - inOffset_ - 4 < length) {
+      break;
+    }
+    const char* packet = in_.data() + inOffset_ + 4;
+    inOffset_ += 4 + length;
+    uint8_t type = static_cast<uint8_t>(packet[0]);
+
+    if (type == kFxpVersion) {
+      Reader reader(packet + 1, length - 1);
+      uint32_t version;
+      if (state_ != State::kVersion || !reader.U32(&version) || version < kSftpVersion) {
+        Fail("Unsupported SFTP version");
+        return false;
+      }
+      bool hasLimits = false;
+      while (!reader.AtEnd()) {
+        std::string name;
+        std::string data;
+        if (!reader.String(&name) || !reader.String(&data)) {
+          break;
+        }
+        hasLimits = hasLimits || name == kLimitsExtension;
+      }
+
+      state_ = State::kReady;
+      if (hasLimits) {
+        limitsId_ = Begin(kFxpExtended);
+        PutString(out_, kLimitsExtension);
+        End();
+        Flush();
+        state_ = State::kLimits;
+      }
+      continue;
+    }
+
+    if (length < 5) {
+      Fail("Malformed SFTP packet");
+      return false;
+    }
+    uint32_t id = GetU32(packet + 1);
+
+    if (state_ == State::kLimits && id == limitsId_) {
+      // Servers without it answer with a STATUS and keep their defaults
+      Reader reader(packet + 5, length - 5);
+      uint64_t maxPacket;
+      if (type != kFxpExtendedReply || !reader.U64(&maxPacket) || !reader.U64(&limits_.maxRead) ||
+          !reader.U64(&limits_.maxWrite) || !reader.U64(&limits_.maxOpenHandles)) {
+        limits_ = SftpLimits();
+      }
+      state_ = State::kReady;
+      continue;
+    }
+    if (forgotten_.erase(id) > 0) {
+      continue;
+    }
+
+    SftpReply& reply = replies_[id];
+    reply.type = type;
+    reply.body.assign(packet + 5, length - 5);
+  }
+
+  if (inOffset_ == in_.size()) {
+    in_.clear();
+    inOffset_ = 0;
+  } else if (inOffset_ >= kCompactBytes) {
+    in_.erase(0, inOffset_);
+    inOffset_ = 0;
+  }
+  return true;
+}
+
+void SftpClient::Flush() {
+  if (channel_ == nullptr || state_ == State::kFailed) {
+    return;
+  }
+
+  // Never hand libssh more than the remote window, so that
+  // ssh_channel_write() does not wait for a window adjust
+  while (outOffset_ < out_.size()) {
+    uint32_t window = ssh_channel_window_size(channel_);
+    if (window == 0) {
+      break;
+    }
+    uint32_t pending = static_cast<uint32_t>(std::min<size_t>(out_.size() - outOffset_, UINT32_MAX));
+    int written = ssh_channel_write(channel_, out_.data() + outOffset_, std::min(window, pending));
+    if (written == SSH_ERROR) {
+      Fail(WithSshError(session_, "Failed to send SFTP request"));
+      return;
+    }
+    if (written == 0) {
+      break;
+    }
+    outOffset_ += static_cast<size_t>(written);
+  }
+
+  if (outOffset_ == out_.size()) {
+    out_.clear();
+    outOffset_ = 0;
+  } else if (outOffset_ >= kCompactBytes) {
+    out_.erase(0, outOffset_);
+    outOffset_ = 0;
+  }
+}
+
+uint32_t SftpClient::Begin(uint8_t type) {
+  uint32_t id = nextId_++;
+  if (nextId_ == 0) {
+    nextId_ = 1;
+  }
+
+  packetStart_ = out_.size();
+  PutU32(out_, 0);
+  out_.push_back(static_cast<char>(type));
+  PutU32(out_, id);
+  return id;
+}
+
+void SftpClient::End() {
+  uint32_t length = static_cast<uint32_t>(out_.size() - packetStart_ - 4);
+  for (int i = 0; i < 4; i++) {
+    out_[packetStart_ + i] = static_cast<char>(length >> (24 - 8 * i));
+  }
+  // Requests on a failed channel are never sent; Take() reports why
+  if (state_ == State::kFailed) {
+    out_.clear();
+    outOffset_ = 0;
+  }
+}
+
+uint32_t SftpClient::Open(const std::string& path, uint32_t flags, uint32_t mode) {
+  uint32_t id = Begin(kFxpOpen);
+  PutString(out_, path);
+  PutU32(out_, flags);
+  if (mode != 0) {
+    PutU32(out_, kAttrPermissions);
+    PutU32(out_, mode);
+  } else {
+    PutU32(out_, 0);
+  }
+  End();
+  return id;
+}
+
+uint32_t SftpClient::CloseHandle(const std::string& handle) {
+  uint32_t id = Begin(kFxpClose);
+  PutString(out_, handle);
+  End();
+  return id;
+}
+
+uint32_t SftpClient::Read(const std::string& handle, uint64_t offset, uint32_t length) {
+  uint32_t id = Begin(kFxpRead);
+  PutString(out_, handle);
+  PutU64(out_, offset);
+  PutU32(out_, length);
+  End();
+  return id;
+}
+
+uint32_t SftpClient::Write(const std::string& handle, uint64_t offset, const char* data, size_t length) {
+  uint32_t id = Begin(kFxpWrite);
+  PutString(out_, handle);
+  PutU64(out_, offset);
+  PutString(out_, data, length);
+  End();
+  return id;
+}
+
+uint32_t SftpClient::Stat(const std::string& path) {
+  uint32_t id = Begin(kFxpStat);
+  PutString(out_, path);
+  End();
+  return id;
+}
+
+uint32_t SftpClient::OpenDir(const std::string& path) {
+  uint32_t id = Begin(kFxpOpenDir);
+  PutString(out_, path);
+  End();
+  return id;
+}
+
+uint32_t SftpClient::ReadDir(const std::string& handle) {
+  uint32_t id = Begin(kFxpReadDir);
+  PutString(out_, handle);
+  End();
+  return id;
+}
+
+int SftpClient::Take(uint32_t id, SftpReply* reply) {
+  auto it = replies_.find(id);
+  if (it == replies_.end()) {
+    return state_ == State::kFailed ? SSH_ERROR : SSH_AGAIN;
+  }
+  *reply = std::move(it->second);
+  replies_.erase(it);
+  return SSH_OK;
+}
+
+void SftpClient::Forget(uint32_t id) {
+  if (replies_.erase(id) == 0 && state_ != State::kFailed) {
+    forgotten_.insert(id);
+  }
+}
+
+} // namespace libssh_node
@@ -0,0 +1,139 @@
+#ifndef LIBSSH_NODE_SFTP_CLIENT_H
+#define LIBSSH_NODE_SFTP_CLIENT_H
+
+#include <libssh/libssh.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "stats.h"
+
+namespace libssh_node {
+
+// open() flags (SSH_FXF_*)
+constexpr uint32_t kSftpRead = 0x01;
+constexpr uint32_t kSftpWrite = 0x02;
+constexpr uint32_t kSftpCreate = 0x08;
+constexpr uint32_t kSftpTruncate = 0x10;
+
+// STATUS codes (SSH_FX_*) callers tell apart
+constexpr uint32_t kSftpOk = 0;
+constexpr uint32_t kSftpEof = 1;
+
+struct SftpAttributes {
+  uint32_t flags = 0; // SSH_FILEXFER_ATTR_*
+  uint64_t size = 0;
+  uint32_t permissions = 0;
+  uint32_t mtime = 0;
+
+  bool hasSize() const { return (flags & 0x01) != 0; }
+};
+
+struct SftpName {
+  std::string name;
+  SftpAttributes attributes;
+};
+
+// One reply, matched to its request by id
+struct SftpReply {
+  uint8_t type = 0;
+  std::string body; // Everything after the request id
+
+  // Decode the reply as the given type; false if it is another one or
+  // malformed. A STATUS reply is never an error by itself.
+  bool Status(uint32_t* code, std::string* message = nullptr) const;
+  bool Handle(std::string* handle) const;
+  bool Data(const char** data, size_t* length) const;
+  bool Attributes(SftpAttributes* attributes) const;
+  bool Names(std::vector<SftpName>* names) const;
+
+  // The server's reason for a failed request
+  std::string Error() const;
+};
+
+// limits@openssh.com, or 0 where the server did not say
+struct SftpLimits {
+  uint64_t maxRead = 0;
+  uint64_t maxWrite = 0;
+  uint64_t maxOpenHandles = 0;
+};
+
+// SFTP version 3 (draft-ietf-secsh-filexfer-02) spoken directly on a
+// subsystem channel. libssh's sftp_* calls wait for their reply inside the
+// call, which would stall every session on the reactor. Here a request is
+// only queued and its reply picked up by id once it has arrived, so opens,
+// stats, directory reads, reads, writes and closes all pipeline. Reactor
+// thread only.
+class SftpClient {
+public:
+  // While open, the channel counts into stats->channelsOpen
+  explicit SftpClient(ssh_session session, std::shared_ptr<SessionStats> stats = nullptr);
+  SftpClient(const SftpClient&) = delete;
+  SftpClient& operator=(const SftpClient&) = delete;
+
+  // Opens the channel, starts the subsystem and negotiates the version.
+  // SSH_AGAIN until the server is ready, then SSH_OK or SSH_ERROR.
+  int Start();
+
+  // Frees the channel; the server releases every handle with it. Pending
+  // and later requests fail.
+  void Close();
+
+  // Collects whatever replies have arrived
+  void Pump();
+  // Hands queued requests to the channel, as far as its window allows
+  void Flush();
+
+  // Queue a request and return its id
+  uint32_t Open(const std::string& path, uint32_t flags, uint32_t mode);
+  uint32_t CloseHandle(const std::string& handle);
+  uint32_t Read(const std::string& handle, uint64_t offset, uint32_t length);
+  uint32_t Write(const std::string& handle, uint64_t offset, const char* data, size_t length);
+  uint32_t Stat(const std::string& path);
+  uint32_t OpenDir(const std::string& path);
+  uint32_t ReadDir(const std::string& handle);
+
+  // SSH_OK and the reply once it has arrived, SSH_AGAIN before, or
+  // SSH_ERROR if the channel failed first
+  int Take(uint32_t id, SftpReply* reply);
+  // Drop the reply to id, now or when it arrives
+  void Forget(uint32_t id);
+
+  // Request bytes not yet handed to the channel
+  size_t Backlog() const { return out_.size() - outOffset_; }
+  const SftpLimits& limits() const { return limits_; }
+  const std::string& error() const { return error_; }
+
+private:
+  enum class State { kOpen, kSubsystem, kVersion, kLimits, kReady, kFailed };
+
+  uint32_t Begin(uint8_t type); // Starts a packet with a fresh id
+  void End();                   // Fills in the packet length
+  void Fail(const std::string& message);
+  bool Parse();
+
+  ssh_session session_;
+  std::shared_ptr<SessionStats> stats_;
+  ssh_channel channel_;
+  bool counted_; // In stats_->channelsOpen
+  State state_;
+  std::string error_;
+  SftpLimits limits_;
+  uint32_t nextId_;
+  uint32_t limitsId_;
+
+  std::string out_;
+  size_t outOffset_;
+  size_t packetStart_;
+  std::string in_;
+  size_t inOffset_;
+
+  std::map<uint32_t, SftpReply> replies_;
+  std::set<uint32_t> forgotten_;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_SFTP_CLIENT_H
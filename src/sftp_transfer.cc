@@ -0,0 +1,698 @@
+#include "sftp_transfer.h"
+#include "ssh_sftp.h"
+#include "utils.h"
+#include <algorithm>
+#include <limits>
+#include <sys/stat.h>
+
+namespace {
+
+// OpenSSH's sftp client defaults: 32KB requests, 64 outstanding
+constexpr size_t kDefaultChunkSize = 32768;
+constexpr size_t kDefaultConcurrency = 64;
+// Servers may refuse reads above this; limits@openssh.com reports the
+// real limit where the server supports it
+constexpr size_t kMaxChunkSize = 261120;
+constexpr int kDefaultProgressIntervalMs = 100;
+// Files transferMany() moves over one channel at once, unless the server
+// allows fewer open handles
+constexpr size_t kFilesPerChannel = 8;
+constexpr uint64_t kToEnd = std::numeric_limits<uint64_t>::max();
+
+bool SeekLocal(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+  return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+  return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+bool LocalFileSize(FILE* file, uint64_t* size) {
+#ifdef _WIN32
+  struct _stati64 st;
+  if (_fstati64(_fileno(file), &st) != 0) {
+    return false;
+  }
+#else
+  struct stat st;
+  if (fstat(fileno(file), &st) != 0) {
+    return false;
+  }
+#endif
+  *size = static_cast<uint64_t>(st.st_size);
+  return true;
+}
+
+} // namespace
+
+namespace libssh_node {
+
+TransferSettings ParseTransferSettings(const Napi::Object& options) {
+  TransferSettings settings;
+  int chunkSize = std::max(GetIntOption(options, "chunkSize", kDefaultChunkSize), 1);
+  settings.chunkSize = std::min(static_cast<size_t>(chunkSize), kMaxChunkSize);
+  settings.concurrency = static_cast<size_t>(std::max(GetIntOption(options, "concurrency", kDefaultConcurrency), 1));
+  return settings;
+}
+
+// SftpTransfer
+SftpTransfer::SftpTransfer(std::string remotePath, std::string localPath, const TransferSettings& settings)
+    : remotePath_(std::move(remotePath)), localPath_(std::move(localPath)), settings_(settings), client_(nullptr),
+      io_(nullptr), started_(false), done_(false), isRange_(false), phase_(Phase::kOpen), offset_(0), end_(kToEnd),
+      nextOffset_(0), openId_(0), closeId_(0), local_(nullptr), sizeKnown_(false), size_(0), bytes_(0) {}
+
+// Only an abandoned transfer still has its local file open here
+SftpTransfer::~SftpTransfer() {
+  if (local_ != nullptr) {
+    std::fclose(local_);
+  }
+}
+
+void SftpTransfer::Start(SftpClient* client, IoCounters* io) {
+  client_ = client;
+  io_ = io;
+}
+
+bool SftpTransfer::Step() {
+  if (done_) {
+    return true;
+  }
+
+  if (!started_) {
+    started_ = true;
+    nextOffset_ = offset_;
+    if (!Begin()) {
+      done_ = true;
+      return true;
+    }
+  }
+
+  int rc = SSH_OK;
+  if (phase_ == Phase::kOpen) {
+    rc = Open();
+    if (rc == SSH_OK) {
+      phase_ = Phase::kTransfer;
+    }
+  }
+
+  if (rc == SSH_OK && phase_ == Phase::kTransfer) {
+    rc = Transfer();
+    if (rc == SSH_OK) {
+      closeId_ = client_->CloseHandle(handle_);
+      handle_.clear();
+      phase_ = Phase::kClose;
+      if (!ConfirmClose()) {
+        client_->Forget(closeId_);
+      }
+    }
+  }
+
+  if (rc == SSH_OK && phase_ == Phase::kClose && ConfirmClose()) {
+    SftpReply reply;
+    rc = Await(closeId_, &reply, "Failed to close remote file");
+    uint32_t code;
+    if (rc == SSH_OK && (!reply.Status(&code) || code != kSftpOk)) {
+      Fail("Failed to close remote file", reply.Error());
+      rc = SSH_ERROR;
+    }
+  }
+
+  if (rc == SSH_AGAIN) {
+    return false;
+  }
+  if (rc == SSH_OK && CloseLocal()) {
+    Cleanup();
+  }
+  done_ = true;
+  return true;
+}
+
+// Only a transfer whose remote handle is open: an upload's range must not
+// reach the server before the OPEN that creates and truncates the file
+uint64_t SftpTransfer::Remaining() const {
+  if (done_ || phase_ != Phase::kTransfer || !sizeKnown_ || nextOffset_ >= Limit()) {
+    return 0;
+  }
+  return Limit() - nextOffset_;
+}
+
+std::unique_ptr<SftpTransfer> SftpTransfer::Split(uint64_t minBytes) {
+  uint64_t remaining = Remaining();
+  if (remaining == 0 || remaining / 2 < minBytes) {
+    return nullptr;
+  }
+
+  // Split on a chunk boundary so neither half ends in a runt request
+  uint64_t limit = Limit();
+  uint64_t middle = nextOffset_ + remaining / 2;
+  middle -= middle % settings_.chunkSize;
+  if (middle <= nextOffset_) {
+    return nullptr;
+  }
+
+  std::unique_ptr<SftpTransfer> range = Clone();
+  range->isRange_ = true;
+  range->offset_ = middle;
+  range->end_ = limit;
+  range->sizeKnown_ = true;
+  range->size_ = size_;
+  end_ = middle;
+  return range;
+}
+
+int SftpTransfer::Await(uint32_t id, SftpReply* reply, const char* message) {
+  int rc = client_->Take(id, reply);
+  if (rc == SSH_ERROR) {
+    Fail(message, client_->error());
+  }
+  return rc;
+}
+
+bool SftpTransfer::Fail(const std::string& message, const std::string& reason) {
+  error_ = reason.empty() ? message : message + ": " + reason;
+  Cleanup();
+  return false;
+}
+
+// Buffered writes that fail on the final flush only show up here
+bool SftpTransfer::CloseLocal() {
+  FILE* local = local_;
+  local_ = nullptr;
+  if (local != nullptr && std::fclose(local) != 0) {
+    return Fail("Failed to write local file");
+  }
+  return true;
+}
+
+// The server's replies to what is still outstanding are dropped as they
+// arrive; an open handle is closed without waiting
+void SftpTransfer::Cleanup() {
+  ReleaseRequests();
+
+  if (openId_ != 0) {
+    client_->Forget(openId_);
+    openId_ = 0;
+  }
+  if (!handle_.empty()) {
+    client_->Forget(client_->CloseHandle(handle_));
+    handle_.clear();
+  }
+  if (local_ != nullptr) {
+    std::fclose(local_);
+    local_ = nullptr;
+  }
+}
+
+// SftpDownload
+bool SftpDownload::Begin() {
+  openId_ = client_->Open(remotePath_, kSftpRead, 0);
+
+  // A range already knows the size and request limits from its parent.
+  // The STAT goes out with the OPEN, so both cost one round trip.
+  if (!isRange_) {
+    statId_ = client_->Stat(remotePath_);
+    uint64_t maxRead = client_->limits().maxRead;
+    if (maxRead > 0) {
+      settings_.chunkSize = static_cast<size_t>(std::min<uint64_t>(settings_.chunkSize, maxRead));
+    }
+  }
+  return true;
+}
+
+int SftpDownload::Open() {
+  SftpReply reply;
+  if (openId_ != 0) {
+    int rc = Await(openId_, &reply, "Failed to open remote file");
+    if (rc != SSH_OK) {
+      return rc;
+    }
+    openId_ = 0;
+    if (!reply.Handle(&handle_)) {
+      Fail("Failed to open remote file", reply.Error());
+      return SSH_ERROR;
+    }
+  }
+
+  if (statId_ != 0) {
+    int rc = Await(statId_, &reply, "Failed to open remote file");
+    if (rc != SSH_OK) {
+      return rc;
+    }
+    statId_ = 0;
+    SftpAttributes attributes;
+    if (reply.Attributes(&attributes) && attributes.hasSize()) {
+      sizeKnown_ = true;
+      size_ = attributes.size;
+    }
+  }
+
+  // Ranges write into the file their parent created
+  local_ = std::fopen(localPath_.c_str(), isRange_ ? "r+b" : "wb");
+  if (local_ == nullptr) {
+    Fail("Failed to open local file");
+    return SSH_ERROR;
+  }
+  return SSH_OK;
+}
+
+int SftpDownload::Transfer() {
+  // Keep the window full
+  while (!eof_ && inflight_.size() < settings_.concurrency && nextOffset_ < Limit()) {
+    uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(settings_.chunkSize, Limit() - nextOffset_));
+    Request(nextOffset_, length);
+    nextOffset_ += length;
+  }
+
+  // Collect replies. The server answers in order, so stop at the first
+  // one still outstanding.
+  while (!inflight_.empty()) {
+    ReadRequest request = inflight_.front();
+    SftpReply reply;
+    int rc = Await(request.id, &reply, "Failed to read remote file");
+    if (rc == SSH_AGAIN) {
+      break;
+    }
+    inflight_.pop_front();
+    if (rc != SSH_OK) {
+      return SSH_ERROR;
+    }
+
+    const char* data;
+    size_t n;
+    uint32_t code;
+    if (!reply.Data(&data, &n)) {
+      if (reply.Status(&code) && code == kSftpEof) {
+        eof_ = true;
+        continue;
+      }
+      Fail("Failed to read remote file", reply.Error());
+      return SSH_ERROR;
+    }
+    if (n > request.length) {
+      Fail("Failed to read remote file", "Unexpected SFTP reply");
+      return SSH_ERROR;
+    }
+    // An empty reply would only be asked for again
+    if (n == 0) {
+      eof_ = true;
+      continue;
+    }
+    if (!WriteLocal(request.offset, data, n)) {
+      Fail("Failed to write local file");
+      return SSH_ERROR;
+    }
+    bytes_ += static_cast<uint64_t>(n);
+    io_->CountRead(n);
+
+    // Short read: ask again for the rest of the range
+    if (static_cast<uint32_t>(n) < request.length && !eof_) {
+      Request(request.offset + n, request.length - static_cast<uint32_t>(n));
+    }
+  }
+
+  if (!inflight_.empty() || (!eof_ && nextOffset_ < Limit())) {
+    return SSH_AGAIN;
+  }
+  return SSH_OK;
+}
+
+void SftpDownload::Request(uint64_t offset, uint32_t length) {
+  inflight_.push_back({client_->Read(handle_, offset, length), offset, length});
+}
+
+bool SftpDownload::WriteLocal(uint64_t offset, const char* data, size_t length) {
+  if (offset != localPosition_ && !SeekLocal(local_, offset)) {
+    return false;
+  }
+  if (std::fwrite(data, 1, length, local_) != length) {
+    return false;
+  }
+  localPosition_ = offset + length;
+  return true;
+}
+
+void SftpDownload::ReleaseRequests() {
+  for (const ReadRequest& request : inflight_) {
+    client_->Forget(request.id);
+  }
+  inflight_.clear();
+  if (statId_ != 0) {
+    client_->Forget(statId_);
+    statId_ = 0;
+  }
+}
+
+std::unique_ptr<SftpTransfer> SftpDownload::Clone() const {
+  return std::make_unique<SftpDownload>(remotePath_, localPath_, settings_);
+}
+
+// SftpUpload
+bool SftpUpload::Begin() {
+  local_ = std::fopen(localPath_.c_str(), "rb");
+  if (local_ == nullptr || !LocalFileSize(local_, &size_) || (offset_ > 0 && !SeekLocal(local_, offset_))) {
+    return Fail("Failed to open local file");
+  }
+  sizeKnown_ = true;
+
+  // Ranges write into the file their parent created
+  uint32_t flags = isRange_ ? kSftpWrite : kSftpWrite | kSftpCreate | kSftpTruncate;
+  openId_ = client_->Open(remotePath_, flags, 0644);
+
+  uint64_t maxWrite = client_->limits().maxWrite;
+  if (!isRange_ && maxWrite > 0) {
+    settings_.chunkSize = static_cast<size_t>(std::min<uint64_t>(settings_.chunkSize, maxWrite));
+  }
+  buffer_.resize(settings_.chunkSize);
+  return true;
+}
+
+int SftpUpload::Open() {
+  SftpReply reply;
+  int rc = Await(openId_, &reply, "Failed to open remote file");
+  if (rc != SSH_OK) {
+    return rc;
+  }
+  openId_ = 0;
+  if (!reply.Handle(&handle_)) {
+    Fail("Failed to open remote file", reply.Error());
+    return SSH_ERROR;
+  }
+  return SSH_OK;
+}
+
+int SftpUpload::Transfer() {
+  // Keep the window full, but queue no more than a chunk beyond what the
+  // channel's send window takes, so a slow link does not buffer the file
+  while (inflight_.size() < settings_.concurrency && nextOffset_ < Limit() &&
+         client_->Backlog() < settings_.chunkSize) {
+    size_t length = static_cast<size_t>(std::min<uint64_t>(settings_.chunkSize, Limit() - nextOffset_));
+    if (std::fread(buffer_.data(), 1, length, local_) != length) {
+      Fail("Failed to read local file");
+      return SSH_ERROR;
+    }
+
+    inflight_.push_back({client_->Write(handle_, nextOffset_, buffer_.data(), length), static_cast<uint32_t>(length)});
+    client_->Flush();
+    nextOffset_ += length;
+  }
+
+  // Collect acknowledgements in whatever order they arrive
+  for (size_t i = 0; i < inflight_.size();) {
+    SftpReply reply;
+    int rc = Await(inflight_[i].id, &reply, "Failed to write remote file");
+    if (rc == SSH_AGAIN) {
+      i++;
+      continue;
+    }
+    if (rc != SSH_OK) {
+      return SSH_ERROR;
+    }
+
+    uint32_t length = inflight_[i].length;
+    inflight_[i] = inflight_.back();
+    inflight_.pop_back();
+    uint32_t code;
+    if (!reply.Status(&code) || code != kSftpOk) {
+      Fail("Failed to write remote file", reply.Error());
+      return SSH_ERROR;
+    }
+    bytes_ += length;
+    io_->CountWrite(length);
+  }
+
+  if (!inflight_.empty() || nextOffset_ < Limit()) {
+    return SSH_AGAIN;
+  }
+  return SSH_OK;
+}
+
+void SftpUpload::ReleaseRequests() {
+  for (const WriteRequest& request : inflight_) {
+    client_->Forget(request.id);
+  }
+  inflight_.clear();
+}
+
+std::unique_ptr<SftpTransfer> SftpUpload::Clone() const {
+  return std::make_unique<SftpUpload>(remotePath_, localPath_, settings_);
+}
+
+// TransferProgress
+TransferProgress::TransferProgress(const Napi::Object& options)
+    : interval_(std::max(GetIntOption(options, "progressInterval", kDefaultProgressIntervalMs), 0)) {
+  Napi::Value onProgress = options.Get("onProgress");
+  if (onProgress.IsFunction()) {
+    callback_ = Napi::Persistent(onProgress.As<Napi::Function>());
+  }
+}
+
+bool TransferProgress::Due(bool final) {
+  if (!enabled()) {
+    return false;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (!final && now - last_ < interval_) {
+    return false;
+  }
+  last_ = now;
+  return true;
+}
+
+void TransferProgress::Report(Reactor* reactor, uint64_t bytes, uint64_t total) {
+  reactor->CallJs([this, bytes, total](Napi::Env env) {
+    callback_.Call({
+      Napi::Number::New(env, static_cast<double>(bytes)),
+      Napi::Number::New(env, static_cast<double>(total))
+    });
+  });
+}
+
+// SftpTransferWorker
+SftpTransferWorker::SftpTransferWorker(Napi::Env env, SSHSftp* sftp, const char* operation,
+                                       std::unique_ptr<SftpTransfer> transfer, const Napi::Object& options,
+                                       const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, sftp->Value(), sftp->Operation(operation)), owner_(sftp), transfer_(std::move(transfer)), progress_(options),
+      started_(false), deferred_(deferred) {}
+
+int SftpTransferWorker::Execute() {
+  if (!started_) {
+    started_ = true;
+    client_ = owner_->client_;
+    if (!client_) {
+      SetError("SFTP session is closed");
+      return SSH_ERROR;
+    }
+    transfer_->Start(client_.get(), &owner_->stats_->io);
+  }
+
+  client_->Pump();
+  bool finished = transfer_->Step();
+  client_->Flush();
+  if (finished && !transfer_->ok()) {
+    return SSH_ERROR;
+  }
+  if (progress_.Due(finished)) {
+    progress_.Report(reactor(), transfer_->bytes(), transfer_->sizeKnown() ? transfer_->size() : 0);
+  }
+  return finished ? SSH_OK : SSH_AGAIN;
+}
+
+void SftpTransferWorker::OnOK() {
+  if (transfer_->ok()) {
+    Napi::Object result = Napi::Object::New(Env());
+    result.Set("bytes", Napi::Number::New(Env(), static_cast<double>(transfer_->bytes())));
+    deferred_.Resolve(result);
+  } else {
+    deferred_.Reject(Napi::Error::New(Env(), transfer_->error()).Value());
+  }
+}
+
+void SftpTransferWorker::OnError(const Napi::Error& error) {
+  deferred_.Reject(error.Value());
+}
+
+// SftpTransferManyWorker
+SftpTransferManyWorker::SftpTransferManyWorker(Napi::Env env, SSHSftp* sftp,
+                                               std::vector<std::unique_ptr<SftpTransfer>> transfers,
+                                               size_t channels, uint64_t minSplitBytes,
+                                               const Napi::Object& options,
+                                               const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, sftp->Value(), sftp->Operation("transferMany")), owner_(sftp), transfers_(std::move(transfers)),
+      channelCount_(std::max<size_t>(channels, 1)), minSplitBytes_(minSplitBytes), progress_(options),
+      deferred_(deferred), started_(false), results_(transfers_.size()), next_(0), finishedBytes_(0) {}
+
+int SftpTransferManyWorker::Execute() {
+  if (!started_) {
+    started_ = true;
+    if (!owner_->client_) {
+      SetError("SFTP session is closed");
+      return SSH_ERROR;
+    }
+    StartChannels();
+  }
+
+  // Extra channels start alongside the first transfers. Those beyond
+  // what the server allows (MaxSessions) are dropped.
+  for (size_t i = 1; i < slots_.size();) {
+    Slot& slot = slots_[i];
+    if (!slot.ready) {
+      int rc = slot.client->Start();
+      if (rc == SSH_ERROR) {
+        slot.client->Close();
+        slots_.erase(slots_.begin() + static_cast<std::ptrdiff_t>(i));
+        continue;
+      }
+      slot.ready = rc == SSH_OK;
+    }
+    i++;
+  }
+
+  bool running = false;
+  for (Slot& slot : slots_) {
+    if (!slot.ready) {
+      continue;
+    }
+    slot.client->Pump();
+
+    size_t files = kFilesPerChannel;
+    uint64_t maxHandles = slot.client->limits().maxOpenHandles;
+    if (maxHandles > 0 && maxHandles < files) {
+      files = static_cast<size_t>(maxHandles);
+    }
+    while (slot.running.size() < files && Assign(slot)) {
+    }
+
+    for (size_t i = 0; i < slot.running.size();) {
+      if (slot.running[i].transfer->Step()) {
+        Finish(slot.running[i]);
+        slot.running.erase(slot.running.begin() + static_cast<std::ptrdiff_t>(i));
+      } else {
+        i++;
+      }
+      running = true;
+    }
+    slot.client->Flush();
+  }
+
+  if (running || next_ < transfers_.size()) {
+    ReportProgress(false);
+    return SSH_AGAIN;
+  }
+
+  // The first slot is the SSHSftp's own channel
+  for (size_t i = 1; i < slots_.size(); i++) {
+    slots_[i].client->Close();
+  }
+  slots_.clear();
+
+  ReportProgress(true);
+  return SSH_OK;
+}
+
+void SftpTransferManyWorker::StartChannels() {
+  slots_.push_back({owner_->client_, true, {}});
+  while (slots_.size() < channelCount_) {
+    slots_.push_back({std::make_shared<SftpClient>(owner_->session_, owner_->stats_), false, {}});
+  }
+}
+
+// Gives a channel the next file, or an idle one half of the largest
+// remaining range
+bool SftpTransferManyWorker::Assign(Slot& slot) {
+  Running running;
+  if (next_ < transfers_.size()) {
+    running.file = next_++;
+    running.transfer = transfers_[running.file].get();
+  } else {
+    if (!slot.running.empty()) {
+      return false;
+    }
+
+    const Running* victim = nullptr;
+    uint64_t most = 0;
+    for (const Slot& other : slots_) {
+      for (const Running& candidate : other.running) {
+        if (candidate.transfer->Remaining() > most) {
+          most = candidate.transfer->Remaining();
+          victim = &candidate;
+        }
+      }
+    }
+    if (victim == nullptr) {
+      return false;
+    }
+
+    std::unique_ptr<SftpTransfer> range = victim->transfer->Split(minSplitBytes_);
+    if (!range) {
+      return false;
+    }
+    running.file = victim->file;
+    running.transfer = range.get();
+    ranges_.push_back(std::move(range));
+  }
+
+  results_[running.file].running++;
+  running.transfer->Start(slot.client.get(), &owner_->stats_->io);
+  slot.running.push_back(running);
+  return true;
+}
+
+void SftpTransferManyWorker::Finish(const Running& running) {
+  FileResult& result = results_[running.file];
+  result.bytes += running.transfer->bytes();
+  result.running--;
+  if (!running.transfer->ok() && result.error.empty()) {
+    result.error = running.transfer->error();
+  }
+  finishedBytes_ += running.transfer->bytes();
+}
+
+void SftpTransferManyWorker::ReportProgress(bool final) {
+  if (!progress_.Due(final)) {
+    return;
+  }
+
+  uint64_t bytes = finishedBytes_;
+  for (const Slot& slot : slots_) {
+    for (const Running& running : slot.running) {
+      bytes += running.transfer->bytes();
+    }
+  }
+
+  // Downloads learn their size once opened
+  uint64_t total = 0;
+  for (const auto& transfer : transfers_) {
+    if (transfer->sizeKnown()) {
+      total += transfer->size();
+    }
+  }
+  progress_.Report(reactor(), bytes, total);
+}
+
+void SftpTransferManyWorker::OnOK() {
+  Napi::Env env = Env();
+  Napi::Object result = Napi::Object::New(env);
+  Napi::Array files = Napi::Array::New(env, results_.size());
+
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < results_.size(); i++) {
+    Napi::Object file = Napi::Object::New(env);
+    file.Set("bytes", Napi::Number::New(env, static_cast<double>(results_[i].bytes)));
+    if (!results_[i].error.empty()) {
+      file.Set("error", results_[i].error);
+    }
+    files.Set(static_cast<uint32_t>(i), file);
+    bytes += results_[i].bytes;
+  }
+
+  result.Set("bytes", Napi::Number::New(env, static_cast<double>(bytes)));
+  result.Set("files", files);
+  deferred_.Resolve(result);
+}
+
+void SftpTransferManyWorker::OnError(const Napi::Error& error) {
+  deferred_.Reject(error.Value());
+}
+
+} // namespace libssh_node
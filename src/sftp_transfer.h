@@ -0,0 +1,251 @@
+#ifndef LIBSSH_NODE_SFTP_TRANSFER_H
+#define LIBSSH_NODE_SFTP_TRANSFER_H
+
+#include <napi.h>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "reactor.h"
+#include "sftp_client.h"
+
+namespace libssh_node {
+
+class SSHSftp;
+
+// Request sizing shared by every transfer
+struct TransferSettings {
+  size_t chunkSize;
+  size_t concurrency;
+};
+
+// Reads { chunkSize, concurrency }
+TransferSettings ParseTransferSettings(const Napi::Object& options);
+
+// One file, or one byte range of it, moved over one SFTP channel with a
+// window of requests in flight. Steps on the reactor thread like ExecJob;
+// opening and closing the remote file are requests like any other, so a
+// step never waits for the server.
+class SftpTransfer {
+public:
+  SftpTransfer(std::string remotePath, std::string localPath, const TransferSettings& settings);
+  virtual ~SftpTransfer();
+
+  // Reactor thread. Step() returns true once the transfer has finished;
+  // the caller pumps the client before and flushes it after. File data
+  // moved is counted into io.
+  void Start(SftpClient* client, IoCounters* io);
+  bool Step();
+
+  // Reactor thread. Hands the second half of the range not yet requested
+  // to a new transfer, which writes into the same files, if at least
+  // 2 * minBytes remain and its remote file is open.
+  std::unique_ptr<SftpTransfer> Split(uint64_t minBytes);
+  uint64_t Remaining() const;
+
+  bool done() const { return done_; }
+  bool ok() const { return error_.empty(); }
+  const std::string& error() const { return error_; }
+  uint64_t bytes() const { return bytes_; }
+  bool sizeKnown() const { return sizeKnown_; }
+  uint64_t size() const { return size_; }
+
+protected:
+  enum class Phase { kOpen, kTransfer, kClose };
+
+  // Queue the request opening the remote file; the range is
+  // [offset_, Limit()). False if the transfer failed already.
+  virtual bool Begin() = 0;
+  // SSH_AGAIN until the remote file is open and handle_ set
+  virtual int Open() = 0;
+  // SSH_AGAIN until every byte of the range is acknowledged
+  virtual int Transfer() = 0;
+  // Forget every request still waiting for a reply
+  virtual void ReleaseRequests() = 0;
+  // Whether the transfer waits for the CLOSE reply: a server may report
+  // a failed write only there
+  virtual bool ConfirmClose() const = 0;
+  virtual std::unique_ptr<SftpTransfer> Clone() const = 0;
+
+  uint64_t Limit() const { return sizeKnown_ ? std::min(end_, size_) : end_; }
+  // SSH_AGAIN, or SSH_OK with *reply once the reply to id has arrived.
+  // SSH_ERROR after failing the transfer with "<message>: <reason>".
+  int Await(uint32_t id, SftpReply* reply, const char* message);
+  bool Fail(const std::string& message, const std::string& reason = "");
+  bool CloseLocal();
+  void Cleanup();
+
+  std::string remotePath_;
+  std::string localPath_;
+  TransferSettings settings_;
+
+  // Reactor thread
+  SftpClient* client_;
+  IoCounters* io_;
+  bool started_;
+  bool done_;
+  bool isRange_; // Split off another transfer: never create or truncate
+  Phase phase_;
+  uint64_t offset_;
+  uint64_t end_;
+  uint64_t nextOffset_;
+  uint32_t openId_;  // OPEN awaiting its reply, or 0
+  uint32_t closeId_;
+  std::string handle_;
+  FILE* local_;
+  bool sizeKnown_;
+  uint64_t size_;
+  uint64_t bytes_;
+  std::string error_;
+};
+
+// Remote to local. Replies are written at their own offset, so they may
+// complete in any order.
+class SftpDownload : public SftpTransfer {
+public:
+  using SftpTransfer::SftpTransfer;
+
+protected:
+  bool Begin() override;
+  int Open() override;
+  int Transfer() override;
+  void ReleaseRequests() override;
+  bool ConfirmClose() const override { return false; }
+  std::unique_ptr<SftpTransfer> Clone() const override;
+
+private:
+  struct ReadRequest {
+    uint32_t id;
+    uint64_t offset;
+    uint32_t length;
+  };
+
+  void Request(uint64_t offset, uint32_t length);
+  bool WriteLocal(uint64_t offset, const char* data, size_t length);
+
+  uint32_t statId_ = 0; // STAT sent alongside the OPEN, or 0
+  uint64_t localPosition_ = 0;
+  bool eof_ = false;
+  std::deque<ReadRequest> inflight_;
+};
+
+// Local to remote. The local file is read sequentially; acknowledgements
+// are matched by request id, so a slow reply does not hold back the ones
+// behind it.
+class SftpUpload : public SftpTransfer {
+public:
+  using SftpTransfer::SftpTransfer;
+
+protected:
+  bool Begin() override;
+  int Open() override;
+  int Transfer() override;
+  void ReleaseRequests() override;
+  bool ConfirmClose() const override { return true; }
+  std::unique_ptr<SftpTransfer> Clone() const override;
+
+private:
+  struct WriteRequest {
+    uint32_t id;
+    uint32_t length;
+  };
+
+  std::vector<char> buffer_;
+  std::vector<WriteRequest> inflight_;
+};
+
+// Throttled { onProgress, progressInterval } callback for a transfer
+// worker. Report() runs on the reactor thread; the callback is queued
+// ahead of the worker's completion, so the worker outlives it.
+class TransferProgress {
+public:
+  explicit TransferProgress(const Napi::Object& options);
+
+  bool enabled() const { return !callback_.IsEmpty(); }
+  bool Due(bool final); // Reactor thread
+  void Report(Reactor* reactor, uint64_t bytes, uint64_t total);
+
+private:
+  Napi::FunctionReference callback_; // JS thread
+  std::chrono::milliseconds interval_;
+  std::chrono::steady_clock::time_point last_;
+};
+
+// Runs one transfer on the SSHSftp's own channel and resolves with
+// { bytes }
+class SftpTransferWorker : public ReactorWorker {
+public:
+  SftpTransferWorker(Napi::Env env, SSHSftp* sftp, const char* operation, std::unique_ptr<SftpTransfer> transfer,
+                     const Napi::Object& options, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  SSHSftp* owner_;
+  std::shared_ptr<SftpClient> client_; // Reactor thread
+  std::unique_ptr<SftpTransfer> transfer_;
+  TransferProgress progress_;
+  bool started_;
+  Napi::Promise::Deferred deferred_;
+};
+
+// Spreads many transfers over several SFTP channels of one session. Each
+// channel moves a few files at once, so the OPEN and CLOSE round trips of
+// small files overlap rather than queue up. Once the queue is empty an
+// idle channel steals the untouched half of the largest running transfer,
+// so a few huge files still keep every channel busy. Resolves with
+// per-file results once all have finished.
+class SftpTransferManyWorker : public ReactorWorker {
+public:
+  SftpTransferManyWorker(Napi::Env env, SSHSftp* sftp, std::vector<std::unique_ptr<SftpTransfer>> transfers,
+                         size_t channels, uint64_t minSplitBytes, const Napi::Object& options,
+                         const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  struct Running {
+    SftpTransfer* transfer;
+    size_t file;
+  };
+
+  struct Slot {
+    std::shared_ptr<SftpClient> client;
+    bool ready; // Subsystem started
+    std::vector<Running> running;
+  };
+
+  struct FileResult {
+    uint64_t bytes = 0;
+    size_t running = 0;
+    std::string error;
+  };
+
+  void StartChannels();
+  bool Assign(Slot& slot);
+  void Finish(const Running& running);
+  void ReportProgress(bool final);
+
+  SSHSftp* owner_;
+  std::vector<std::unique_ptr<SftpTransfer>> transfers_; // One per file, in order
+  std::vector<std::unique_ptr<SftpTransfer>> ranges_;    // Split off while running
+  size_t channelCount_;
+  uint64_t minSplitBytes_;
+  TransferProgress progress_;
+  Napi::Promise::Deferred deferred_;
+
+  // Reactor thread
+  bool started_;
+  std::vector<Slot> slots_;
+  std::vector<FileResult> results_;
+  size_t next_;
+  uint64_t finishedBytes_;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_SFTP_TRANSFER_H
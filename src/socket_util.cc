@@ -0,0 +1,293 @@
+#include "socket_util.h"
+#include <cstring>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#endif
+
+namespace libssh_node {
+
+bool SocketInit() {
+#ifdef _WIN32
+  static bool initialized = false;
+  if (!initialized) {
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+      return false;
+    }
+    initialized = true;
+  }
+#endif
+  return true;
+}
+
+int SetNonBlocking(socket_t fd) {
+#ifdef _WIN32
+  u_long mode = 1;
+  return ioctlsocket(fd, FIONBIO, &mode) == 0 ? 0 : -1;
+#else
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0) {
+    return -1;
+  }
+  return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+void CloseSocket(socket_t fd) {
+  if (fd == SSH_INVALID_SOCKET) {
+    return;
+  }
+#ifdef _WIN32
+  closesocket(fd);
+#else
+  close(fd);
+#endif
+}
+
+bool SocketWouldBlock() {
+#ifdef _WIN32
+  int err = WSAGetLastError();
+  return err == WSAEWOULDBLOCK || err == WSAEINTR;
+#else
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+std::string SocketErrorString() {
+#ifdef _WIN32
+  return "socket error " + std::to_string(WSAGetLastError());
+#else
+  return std::strerror(errno);
+#endif
+}
+
+socket_t ListenTcp(const std::string& host, int port, int backlog, std::string& error) {
+  if (!SocketInit()) {
+    error = "Failed to initialize sockets";
+    return SSH_INVALID_SOCKET;
+  }
+
+  struct addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+
+  struct addrinfo* result = nullptr;
+  std::string service = std::to_string(port);
+  int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &result);
+  if (rc != 0) {
+    error = std::string("Failed to resolve ") + host + ": " + gai_strerror(rc);
+    return SSH_INVALID_SOCKET;
+  }
+
+  socket_t fd = SSH_INVALID_SOCKET;
+  for (struct addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd == SSH_INVALID_SOCKET) {
+      continue;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    if (bind(fd, ai->ai_addr, static_cast<int>(ai->ai_addrlen)) == 0 &&
+        listen(fd, backlog) == 0 &&
+        SetNonBlocking(fd) == 0) {
+      break;
+    }
+
+    error = SocketErrorString();
+    CloseSocket(fd);
+    fd = SSH_INVALID_SOCKET;
+  }
+
+  freeaddrinfo(result);
+
+  if (fd == SSH_INVALID_SOCKET && error.empty()) {
+    error = "No usable address for " + host;
+  }
+  return fd;
+}
+
+socket_t AcceptConnection(socket_t listenFd) {
+  socket_t fd = accept(listenFd, nullptr, nullptr);
+  if (fd == SSH_INVALID_SOCKET) {
+    return fd;
+  }
+
+  SetNonBlocking(fd);
+  int nodelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+  return fd;
+}
+
+socket_t StartConnect(const struct sockaddr* addr, socklen_t length, std::string& error) {
+  socket_t fd = socket(addr->sa_family, SOCK_STREAM, IPPROTO_TCP);
+  if (fd == SSH_INVALID_SOCKET || SetNonBlocking(fd) != 0) {
+    error = SocketErrorString();
+    CloseSocket(fd);
+    return SSH_INVALID_SOCKET;
+  }
+
+  int nodelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+
+  if (connect(fd, addr, length) != 0) {
+#ifdef _WIN32
+    bool inProgress = WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    bool inProgress = errno == EINPROGRESS || errno == EINTR;
+#endif
+    if (!inProgress) {
+      error = SocketErrorString();
+      CloseSocket(fd);
+      return SSH_INVALID_SOCKET;
+    }
+  }
+  return fd;
+}
+
+int GetSocketError(socket_t fd) {
+  int code = 0;
+  socklen_t length = sizeof(code);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&code), &length) != 0) {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+  }
+  return code;
+}
+
+std::string SocketErrorString(int code) {
+#ifdef _WIN32
+  return "socket error " + std::to_string(code);
+#else
+  return std::strerror(code);
+#endif
+}
+
+std::string AddressString(const struct sockaddr* addr) {
+  char buffer[INET6_ADDRSTRLEN] = {0};
+  if (addr->sa_family == AF_INET6) {
+    inet_ntop(AF_INET6, &reinterpret_cast<const struct sockaddr_in6*>(addr)->sin6_addr, buffer, sizeof(buffer));
+  } else {
+    inet_ntop(AF_INET, &reinterpret_cast<const struct sockaddr_in*>(addr)->sin_addr, buffer, sizeof(buffer));
+  }
+  return buffer;
+}
+
+void ShutdownWrite(socket_t fd) {
+#ifdef _WIN32
+  shutdown(fd, SD_SEND);
+#else
+  shutdown(fd, SHUT_WR);
+#endif
+}
+
+int GetLocalPort(socket_t fd) {
+  struct sockaddr_storage addr;
+  socklen_t len = sizeof(addr);
+  if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0) {
+    return -1;
+  }
+  if (addr.ss_family == AF_INET6) {
+    return ntohs(reinterpret_cast<struct sockaddr_in6*>(&addr)->sin6_port);
+  }
+  return ntohs(reinterpret_cast<struct sockaddr_in*>(&addr)->sin_port);
+}
+
+bool GetPeerAddress(socket_t fd, std::string& host, int& port) {
+  struct sockaddr_storage addr;
+  socklen_t len = sizeof(addr);
+  if (getpeername(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0) {
+    return false;
+  }
+
+  char buffer[INET6_ADDRSTRLEN] = {0};
+  if (addr.ss_family == AF_INET6) {
+    struct sockaddr_in6* in6 = reinterpret_cast<struct sockaddr_in6*>(&addr);
+    inet_ntop(AF_INET6, &in6->sin6_addr, buffer, sizeof(buffer));
+    port = ntohs(in6->sin6_port);
+  } else {
+    struct sockaddr_in* in4 = reinterpret_cast<struct sockaddr_in*>(&addr);
+    inet_ntop(AF_INET, &in4->sin_addr, buffer, sizeof(buffer));
+    port = ntohs(in4->sin_port);
+  }
+  host = buffer;
+  return true;
+}
+
+bool CreateSocketPair(socket_t fds[2]) {
+  fds[0] = fds[1] = SSH_INVALID_SOCKET;
+  if (!SocketInit()) {
+    return false;
+  }
+
+#ifdef _WIN32
+  // No socketpair() on Windows: connect two loopback TCP sockets
+  std::string error;
+  socket_t listener = ListenTcp("127.0.0.1", 0, 1, error);
+  if (listener == SSH_INVALID_SOCKET) {
+    return false;
+  }
+
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(static_cast<u_short>(GetLocalPort(listener)));
+
+  fds[1] = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fds[1] == SSH_INVALID_SOCKET ||
+      connect(fds[1], reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+    CloseSocket(fds[1]);
+    CloseSocket(listener);
+    fds[1] = SSH_INVALID_SOCKET;
+    return false;
+  }
+
+  u_long blocking = 0;
+  ioctlsocket(listener, FIONBIO, &blocking);
+  fds[0] = accept(listener, nullptr, nullptr);
+  CloseSocket(listener);
+  if (fds[0] == SSH_INVALID_SOCKET) {
+    CloseSocket(fds[1]);
+    fds[1] = SSH_INVALID_SOCKET;
+    return false;
+  }
+#else
+  int pair[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+    return false;
+  }
+  fds[0] = pair[0];
+  fds[1] = pair[1];
+#endif
+
+  SetNonBlocking(fds[0]);
+  SetNonBlocking(fds[1]);
+  return true;
+}
+
+void SignalWake(socket_t fd) {
+  char byte = 1;
+  send(fd, &byte, 1, 0);
+}
+
+void DrainWake(socket_t fd) {
+  char buffer[64];
+  while (recv(fd, buffer, sizeof(buffer), 0) > 0) {
+  }
+}
+
+} // namespace libssh_node
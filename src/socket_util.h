@@ -0,0 +1,53 @@
+#ifndef LIBSSH_NODE_SOCKET_UTIL_H
+#define LIBSSH_NODE_SOCKET_UTIL_H
+
+#include <libssh/libssh.h>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <poll.h>
+#include <sys/socket.h>
+#endif
+
+namespace libssh_node {
+
+// Small portable wrappers around BSD sockets for the native I/O paths
+// (tunnel listeners, wake-up pipes). socket_t comes from libssh.
+
+// Initialize the socket layer (WSAStartup on Windows, no-op elsewhere)
+bool SocketInit();
+
+int SetNonBlocking(socket_t fd);
+void CloseSocket(socket_t fd);
+
+// True if the last socket call failed with EAGAIN/EWOULDBLOCK/EINTR
+bool SocketWouldBlock();
+std::string SocketErrorString();
+
+// Create a non-blocking listening TCP socket bound to host:port
+socket_t ListenTcp(const std::string& host, int port, int backlog, std::string& error);
+// Accept one pending connection as a non-blocking, TCP_NODELAY socket
+socket_t AcceptConnection(socket_t listenFd);
+// Start a non-blocking TCP connect. Returns the socket once the attempt
+// is under way; it polls writable when it completes.
+socket_t StartConnect(const struct sockaddr* addr, socklen_t length, std::string& error);
+// Outcome of a completed connect: 0, or the socket error code
+int GetSocketError(socket_t fd);
+std::string SocketErrorString(int code);
+// Numeric host of an address, without the port
+std::string AddressString(const struct sockaddr* addr);
+void ShutdownWrite(socket_t fd);
+int GetLocalPort(socket_t fd);
+bool GetPeerAddress(socket_t fd, std::string& host, int& port);
+
+// Connected pair of non-blocking sockets used to wake a poll loop
+bool CreateSocketPair(socket_t fds[2]);
+void SignalWake(socket_t fd);
+void DrainWake(socket_t fd);
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_SOCKET_UTIL_H
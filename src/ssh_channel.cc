@@ -1,76 +1,158 @@
 #include "ssh_channel.h"
+#include "addon_data.h"
+#include "exec.h"
 #include "utils.h"
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 
 namespace libssh_node {
 
+namespace {
+
+constexpr uint32_t kStreamChunkSize = 65536;
+// Bound the time spent draining one channel per reactor iteration
+constexpr int kMaxChunksPerDrain = 4;
+// Queued chunks smaller than this are copied together and sent as one
+// packet-sized write instead of one SSH packet each
+constexpr size_t kCoalesceThreshold = 8192;
+constexpr size_t kCoalesceSize = 32768;
+// Default bytes of each stream kept by exec()
+constexpr size_t kDefaultCaptureBytes = 1024 * 1024;
+// Line mode defaults
+constexpr int kDefaultLineBatch = 1000;
+constexpr int kDefaultLineFlushMs = 50;
+constexpr int kDefaultMaxLineLength = 1024 * 1024;
+
+} // namespace
+
 // SSHChannel Implementation
 Napi::Object SSHChannel::Init(Napi::Env env, Napi::Object exports) {
   Napi::Function func = DefineClass(env, "SSHChannel", {
     InstanceMethod("openSession", &SSHChannel::OpenSession),
     InstanceMethod("requestExec", &SSHChannel::RequestExec),
+    InstanceMethod("exec", &SSHChannel::Exec),
     InstanceMethod("requestForwardTcpIp", &SSHChannel::RequestForwardTcpIp),
     InstanceMethod("read", &SSHChannel::Read),
+    InstanceMethod("readInto", &SSHChannel::ReadInto),
     InstanceMethod("write", &SSHChannel::Write),
+    InstanceMethod("writev", &SSHChannel::Writev),
+    InstanceMethod("getWriteQueueSize", &SSHChannel::GetWriteQueueSize),
     InstanceMethod("close", &SSHChannel::Close),
-    InstanceMethod("isOpen", &SSHChannel::IsOpen)
+    InstanceMethod("isOpen", &SSHChannel::IsOpen),
+    InstanceMethod("sendEof", &SSHChannel::SendEof),
+    InstanceMethod("getStats", &SSHChannel::GetStats),
+    InstanceMethod("startStream", &SSHChannel::StartStream),
+    InstanceMethod("readStart", &SSHChannel::ReadStart),
+    InstanceMethod("readStop", &SSHChannel::ReadStop)
   });
 
-  Napi::FunctionReference* constructor = new Napi::FunctionReference();
-  *constructor = Napi::Persistent(func);
-  env.SetInstanceData(constructor);
+  env.GetInstanceData<AddonData>()->channelConstructor = Napi::Persistent(func);
 
   exports.Set("SSHChannel", func);
   return exports;
 }
 
-Napi::Value SSHChannel::NewInstance(Napi::Env env, ssh_session session, Napi::Value sessionRef) {
-  Napi::FunctionReference* constructor = env.GetInstanceData<Napi::FunctionReference>();
-  Napi::Object obj = constructor->New({});
+Napi::Value SSHChannel::NewInstance(Napi::Env env, ssh_session session, std::shared_ptr<std::atomic<bool>> sessionAlive,
+                                    std::shared_ptr<BufferPool> readPool, std::shared_ptr<SessionStats> sessionStats,
+                                    Napi::Value sessionRef) {
+  Napi::Object obj = env.GetInstanceData<AddonData>()->channelConstructor.New({});
 
   SSHChannel* channel = SSHChannel::Unwrap(obj);
   channel->session_ = session;
+  channel->sessionAlive_ = std::move(sessionAlive);
+  channel->readPool_ = std::move(readPool);
+  channel->sessionStats_ = std::move(sessionStats);
+  channel->io_.parent = &channel->sessionStats_->io;
   channel->sessionRef_ = Napi::Reference<Napi::Value>::New(sessionRef, 1);
 
   return obj;
 }
 
 SSHChannel::SSHChannel(const Napi::CallbackInfo& info)
-    : Napi::ObjectWrap<SSHChannel>(info), session_(nullptr), channel_(nullptr), open_(false) {
+    : Napi::ObjectWrap<SSHChannel>(info), session_(nullptr), channel_(nullptr),
+      opening_(false), open_(false), counted_(false), link_(std::make_shared<ChannelLink>()), reactor_(Reactor::Get(info.Env())),
+      windowStalled_(false),
+      streaming_(false), capturing_(false), reading_(false), streamActive_(false), backlog_(false),
+      remoteEof_(false), eofEmitted_(false), remoteClosed_(false),
+      exitStatusSet_(false), exitStatus_(-1), flushInterval_(kDefaultLineFlushMs) {
   // Session will be set by NewInstance
+  std::memset(&callbacks_, 0, sizeof(callbacks_));
+  callbacks_.userdata = this;
+  callbacks_.channel_data_function = &SSHChannel::OnData;
+  callbacks_.channel_eof_function = &SSHChannel::OnEof;
+  callbacks_.channel_close_function = &SSHChannel::OnClose;
+  callbacks_.channel_exit_status_function = &SSHChannel::OnExitStatus;
+  ssh_callbacks_init(&callbacks_);
+
+  std::memset(&link_->callbacks, 0, sizeof(link_->callbacks));
+  link_->callbacks.userdata = link_.get();
+  link_->callbacks.channel_close_function = &SSHChannel::OnLinkClosed;
+  ssh_callbacks_init(&link_->callbacks);
 }
 
 SSHChannel::~SSHChannel() {
-  if (channel_ != nullptr && open_) {
-    ssh_channel_close(channel_);
-    ssh_channel_free(channel_);
-    channel_ = nullptr;
+  Uncount();
+  // Once the reactor has stopped (environment teardown) the session frees
+  // its remaining channels itself
+  if (channel_ != nullptr && !reactor_->IsStopped()) {
+    ssh_channel channel = channel_;
+    std::shared_ptr<ChannelLink> link = link_;
+    reactor_->Post([channel, link]() {
+      if (ssh_channel_is_open(channel)) {
+        ssh_channel_close(channel);
+      }
+      ssh_channel_free(channel);
+    });
   }
+  channel_ = nullptr;
   sessionRef_.Reset();
 }
 
 Napi::Value SSHChannel::OpenSession(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
 
-  if (channel_ != nullptr) {
+  if (opening_ || open_) {
     Napi::Error::New(env, "Channel already opened").ThrowAsJavaScriptException();
     return env.Undefined();
   }
+  opening_ = true;
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  ChannelOpenWorker* worker = new ChannelOpenWorker(env, this, deferred);
+  worker->SetCancellation(info[0]);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+Napi::Value SSHChannel::RequestExec(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!open_) {
+    Napi::Error::New(env, "Channel is not open").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
 
-  channel_ = ssh_channel_new(session_);
-  if (channel_ == nullptr) {
-    Napi::Error::New(env, "Failed to create channel").ThrowAsJavaScriptException();
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::Error::New(env, "Expected command string").ThrowAsJavaScriptException();
     return env.Undefined();
   }
 
+  std::string command = info[0].As<Napi::String>().Utf8Value();
+
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
-  ChannelOpenWorker* worker = new ChannelOpenWorker(env, channel_, deferred);
+  ChannelExecWorker* worker = new ChannelExecWorker(env, this, command, deferred);
+  worker->SetCancellation(info[1]);
   worker->Queue();
 
   return deferred.Promise();
 }
 
-Napi::Value SSHChannel::RequestExec(const Napi::CallbackInfo& info) {
+// Runs a command on this open channel and resolves with its captured
+// output and exit status, like one execMany() entry. Both streams are
+// drained as data arrives. Options: { timeoutMs, capture }.
+Napi::Value SSHChannel::Exec(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
 
   if (!open_) {
@@ -78,15 +160,27 @@ Napi::Value SSHChannel::RequestExec(const Napi::CallbackInfo& info) {
     return env.Undefined();
   }
 
+  if (streaming_ || capturing_) {
+    Napi::Error::New(env, "Channel is already streaming").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
   if (info.Length() < 1 || !info[0].IsString()) {
     Napi::Error::New(env, "Expected command string").ThrowAsJavaScriptException();
     return env.Undefined();
   }
 
   std::string command = info[0].As<Napi::String>().Utf8Value();
+  Napi::Object options = info.Length() > 1 && info[1].IsObject() ? info[1].As<Napi::Object>()
+                                                                 : Napi::Object::New(env);
+  int timeoutMs = std::max(GetIntOption(options, "timeoutMs", 0), 0);
+  capturing_ = true;
 
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
-  ChannelExecWorker* worker = new ChannelExecWorker(env, channel_, command, deferred);
+  std::unique_ptr<ExecJob> job = std::make_unique<ExecJob>(
+    command, timeoutMs, ParseCapturePolicy(options, kDefaultCaptureBytes));
+  ChannelCaptureWorker* worker = new ChannelCaptureWorker(env, this, std::move(job), deferred);
+  worker->SetCancellation(info[1], false);
   worker->Queue();
 
   return deferred.Promise();
@@ -113,17 +207,16 @@ Napi::Value SSHChannel::RequestForwardTcpIp(const Napi::CallbackInfo& info) {
     sourcePort = info[3].As<Napi::Number>().Int32Value();
   }
 
-  if (channel_ == nullptr) {
-    channel_ = ssh_channel_new(session_);
-    if (channel_ == nullptr) {
-      Napi::Error::New(env, "Failed to create channel").ThrowAsJavaScriptException();
-      return env.Undefined();
-    }
+  if (opening_ || open_) {
+    Napi::Error::New(env, "Channel already opened").ThrowAsJavaScriptException();
+    return env.Undefined();
   }
+  opening_ = true;
 
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
   ChannelForwardWorker* worker = new ChannelForwardWorker(
-    env, channel_, remoteHost, remotePort, sourceHost, sourcePort, deferred);
+    env, this, remoteHost, remotePort, sourceHost, sourcePort, deferred);
+  worker->SetCancellation(info[4]);
   worker->Queue();
 
   return deferred.Promise();
@@ -137,13 +230,65 @@ Napi::Value SSHChannel::Read(const Napi::CallbackInfo& info) {
     return env.Undefined();
   }
 
+  if (streaming_ || capturing_) {
+    Napi::Error::New(env, "Channel is in streaming mode").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
   int maxBytes = 65536; // Default 64KB
   if (info.Length() > 0 && info[0].IsNumber()) {
     maxBytes = info[0].As<Napi::Number>().Int32Value();
   }
 
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
-  ChannelReadWorker* worker = new ChannelReadWorker(env, channel_, maxBytes, deferred);
+  ChannelReadWorker* worker = new ChannelReadWorker(env, this, maxBytes, deferred);
+  worker->SetCancellation(info[1]);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+Napi::Value SSHChannel::ReadInto(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!open_) {
+    Napi::Error::New(env, "Channel is not open").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (streaming_ || capturing_) {
+    Napi::Error::New(env, "Channel is in streaming mode").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1 || !info[0].IsBuffer()) {
+    Napi::Error::New(env, "Expected Buffer").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Buffer<char> target = info[0].As<Napi::Buffer<char>>();
+  size_t offset = 0;
+  if (info.Length() > 1 && info[1].IsNumber()) {
+    offset = static_cast<size_t>(info[1].As<Napi::Number>().Int64Value());
+  }
+  if (offset > target.Length()) {
+    Napi::Error::New(env, "Offset is out of range").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  size_t length = target.Length() - offset;
+  if (info.Length() > 2 && info[2].IsNumber()) {
+    int64_t requested = info[2].As<Napi::Number>().Int64Value();
+    if (requested < 0 || static_cast<size_t>(requested) > length) {
+      Napi::Error::New(env, "Length is out of range").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    length = static_cast<size_t>(requested);
+  }
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  ChannelReadWorker* worker = new ChannelReadWorker(env, this, target, offset, length, deferred);
+  worker->SetCancellation(info[3]);
   worker->Queue();
 
   return deferred.Promise();
@@ -162,16 +307,66 @@ Napi::Value SSHChannel::Write(const Napi::CallbackInfo& info) {
     return env.Undefined();
   }
 
-  Napi::Buffer<char> buffer = info[0].As<Napi::Buffer<char>>();
-  std::vector<char> data(buffer.Data(), buffer.Data() + buffer.Length());
+  std::vector<Napi::Buffer<char>> buffers{info[0].As<Napi::Buffer<char>>()};
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  ChannelWriteWorker* worker = new ChannelWriteWorker(env, this, buffers, deferred);
+  io_.AddBuffered(static_cast<int64_t>(worker->length()));
+  worker->SetCancellation(info[1]);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+Napi::Value SSHChannel::Writev(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!open_) {
+    Napi::Error::New(env, "Channel is not open").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1 || !info[0].IsArray()) {
+    Napi::Error::New(env, "Expected array of Buffers").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Array array = info[0].As<Napi::Array>();
+  std::vector<Napi::Buffer<char>> buffers;
+  buffers.reserve(array.Length());
+  for (uint32_t i = 0; i < array.Length(); i++) {
+    Napi::Value value = array.Get(i);
+    if (!value.IsBuffer()) {
+      Napi::Error::New(env, "Expected array of Buffers").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    buffers.push_back(value.As<Napi::Buffer<char>>());
+  }
 
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
-  ChannelWriteWorker* worker = new ChannelWriteWorker(env, channel_, data, deferred);
+  ChannelWriteWorker* worker = new ChannelWriteWorker(env, this, buffers, deferred);
+  io_.AddBuffered(static_cast<int64_t>(worker->length()));
+  worker->SetCancellation(info[1]);
   worker->Queue();
 
   return deferred.Promise();
 }
 
+Napi::Value SSHChannel::GetWriteQueueSize(const Napi::CallbackInfo& info) {
+  return Napi::Number::New(info.Env(), static_cast<double>(io_.bufferedBytes.load(std::memory_order_relaxed)));
+}
+
+// Counters only; cheap enough to poll
+Napi::Value SSHChannel::GetStats(const Napi::CallbackInfo& info) {
+  Napi::Object stats = Napi::Object::New(info.Env());
+  io_.AddTo(stats);
+  return stats;
+}
+
+OperationStats* SSHChannel::Operation(const char* name) {
+  return sessionStats_ ? sessionStats_->operations.Get(name) : nullptr;
+}
+
 Napi::Value SSHChannel::Close(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
 
@@ -180,7 +375,7 @@ Napi::Value SSHChannel::Close(const Napi::CallbackInfo& info) {
   }
 
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
-  ChannelCloseWorker* worker = new ChannelCloseWorker(env, channel_, deferred);
+  ChannelCloseWorker* worker = new ChannelCloseWorker(env, this, deferred);
   worker->Queue();
 
   open_ = false;
@@ -190,28 +385,480 @@ Napi::Value SSHChannel::Close(const Napi::CallbackInfo& info) {
 
 Napi::Value SSHChannel::IsOpen(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  return Napi::Boolean::New(env, open_ && ssh_channel_is_open(channel_));
+  // From flags the reactor keeps; libssh state belongs to its thread
+  bool sessionAlive = sessionAlive_ && sessionAlive_->load();
+  return Napi::Boolean::New(env, open_ && sessionAlive && link_->open.load());
 }
 
-// Async Workers Implementation
+Napi::Value SSHChannel::SendEof(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!open_) {
+    Napi::Error::New(env, "Channel is not open").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  ChannelEofWorker* worker = new ChannelEofWorker(env, this, deferred);
+  worker->SetCancellation(info[0]);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+Napi::Value SSHChannel::StartStream(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!open_) {
+    Napi::Error::New(env, "Channel is not open").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (streaming_ || capturing_) {
+    Napi::Error::New(env, "Channel is already streaming").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1 || !info[0].IsFunction()) {
+    Napi::Error::New(env, "Expected event callback").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // { lines: { maxBatch, flushMs, maxLineLength } } switches to line mode
+  if (info.Length() > 1 && info[1].IsObject()) {
+    Napi::Object options = info[1].As<Napi::Object>();
+    if (options.Has("lines") && options.Get("lines").IsObject()) {
+      Napi::Object lines = options.Get("lines").As<Napi::Object>();
+      size_t maxBatch = static_cast<size_t>(std::max(GetIntOption(lines, "maxBatch", kDefaultLineBatch), 1));
+      size_t maxLineLength = static_cast<size_t>(
+        std::max(GetIntOption(lines, "maxLineLength", kDefaultMaxLineLength), 1));
+      flushInterval_ = std::chrono::milliseconds(std::max(GetIntOption(lines, "flushMs", kDefaultLineFlushMs), 0));
+      lineFramers_[0] = std::make_unique<LineFramer>(maxBatch, maxLineLength);
+      lineFramers_[1] = std::make_unique<LineFramer>(maxBatch, maxLineLength);
+    }
+  }
+
+  streaming_ = true;
+  onEvent_ = Napi::Persistent(info[0].As<Napi::Function>());
+
+  // Stay alive until the stream has finished, even if JS drops the channel
+  Ref();
+  reactor_->Ref();
+
+  // Reading starts paused; the readable side asks for data with readStart()
+  reactor_->Post([this]() {
+    streamActive_ = true;
+    ssh_add_channel_callbacks(channel_, &callbacks_);
+    reactor_->AddPoller(this);
+    // Pick up anything that arrived before the callbacks were registered
+    backlog_ = true;
+  });
+
+  return env.Undefined();
+}
+
+Napi::Value SSHChannel::ReadStart(const Napi::CallbackInfo& info) {
+  if (!reading_.exchange(true)) {
+    reactor_->Wake();
+  }
+  return info.Env().Undefined();
+}
+
+Napi::Value SSHChannel::ReadStop(const Napi::CallbackInfo& info) {
+  reading_ = false;
+  return info.Env().Undefined();
+}
+
+// Write queue (reactor thread)
+
+void SSHChannel::FlushWrites() {
+  while (!writeQueue_.empty()) {
+    if (ssh_channel_is_closed(channel_)) {
+      FailWrites("Failed to write to channel: channel is closed");
+      return;
+    }
+
+    // Never hand libssh more than the remote window, so the write can
+    // complete without waiting for a window adjust
+    uint32_t window = ssh_channel_window_size(channel_);
+    if (window == 0) {
+      if (!windowStalled_) {
+        windowStalled_ = true;
+        io_.CountWindowStall();
+      }
+      return;
+    }
+    windowStalled_ = false;
+
+    ChannelWriteWorker* head = writeQueue_.front();
+    const ChannelWriteWorker::Segment& segment = head->segments_[head->segment_];
+    size_t remaining = segment.length - head->offset_;
+
+    const char* data;
+    size_t chunk;
+    if (remaining >= kCoalesceThreshold) {
+      data = segment.data + head->offset_;
+      chunk = std::min<size_t>(window, remaining);
+    } else {
+      // Gather the small chunks at the front of the queue, stopping at the
+      // first large one, which is sent directly on the next pass
+      size_t limit = std::min<size_t>(window, kCoalesceSize);
+      bool full = false;
+      writeStaging_.clear();
+      for (auto it = writeQueue_.begin(); it != writeQueue_.end() && !full; ++it) {
+        ChannelWriteWorker* worker = *it;
+        size_t offset = worker->offset_;
+        for (size_t i = worker->segment_; i < worker->segments_.size(); i++, offset = 0) {
+          const ChannelWriteWorker::Segment& next = worker->segments_[i];
+          size_t length = next.length - offset;
+          if (!writeStaging_.empty() && length >= kCoalesceThreshold) {
+            full = true;
+            break;
+          }
+          size_t take = std::min(length, limit - writeStaging_.size());
+          writeStaging_.insert(writeStaging_.end(), next.data + offset, next.data + offset + take);
+          if (writeStaging_.size() == limit) {
+            full = true;
+            break;
+          }
+        }
+      }
+      data = writeStaging_.data();
+      chunk = writeStaging_.size();
+    }
+
+    int written = ssh_channel_write(channel_, data, static_cast<uint32_t>(chunk));
+    if (written == SSH_ERROR) {
+      FailWrites("Failed to write to channel");
+      return;
+    }
+
+    // Credit the bytes libssh accepted to the queued writes in order
+    io_.CountWrite(static_cast<size_t>(written));
+    io_.AddBuffered(-static_cast<int64_t>(written));
+    size_t left = static_cast<size_t>(written);
+    while (left > 0) {
+      ChannelWriteWorker* worker = writeQueue_.front();
+      size_t length = worker->segments_[worker->segment_].length;
+      size_t step = std::min(left, length - worker->offset_);
+      worker->offset_ += step;
+      worker->bytesWritten_ += step;
+      left -= step;
+      if (worker->offset_ == length) {
+        worker->segment_++;
+        worker->offset_ = 0;
+      }
+      if (worker->segment_ == worker->segments_.size()) {
+        worker->done_ = true;
+        writeQueue_.pop_front();
+      }
+    }
+
+    if (static_cast<size_t>(written) < chunk) {
+      return;
+    }
+  }
+}
+
+void SSHChannel::FailWrites(const std::string& message) {
+  for (ChannelWriteWorker* worker : writeQueue_) {
+    io_.AddBuffered(-static_cast<int64_t>(worker->length_ - static_cast<size_t>(worker->bytesWritten_)));
+    worker->bytesWritten_ = SSH_ERROR;
+    worker->errorMessage_ = message;
+    worker->done_ = true;
+  }
+  writeQueue_.clear();
+}
+
+// Streaming (reactor thread)
+
+bool SSHChannel::Poll() {
+  if (!streamActive_) {
+    return false;
+  }
+
+  bool progress = false;
+  if (backlog_ && reading_) {
+    progress = DrainStream();
+  }
+  if (lineFramers_[0] && FlushLines(false)) {
+    progress = true;
+  }
+
+  // End-of-stream events wait until buffered data has been delivered
+  if (backlog_) {
+    return progress;
+  }
+
+  if (remoteEof_ && !eofEmitted_) {
+    eofEmitted_ = true;
+    FlushLines(true);
+    EmitStream("eof");
+    progress = true;
+  }
+
+  if (remoteClosed_ || ssh_channel_is_closed(channel_)) {
+    FinishStream();
+    progress = true;
+  }
+
+  return progress;
+}
+
+bool SSHChannel::DrainStream() {
+  bool progress = false;
+  bool more = false;
+  backlog_ = false;
+
+  for (int is_stderr = 0; is_stderr <= 1; is_stderr++) {
+    for (int i = 0; i < kMaxChunksPerDrain; i++) {
+      if (!reading_) {
+        more = true;
+        break;
+      }
+
+      // Read straight into a pooled block that JS then borrows, so a chunk
+      // is neither zeroed nor copied on its way
+      std::shared_ptr<PooledBlock> chunk = std::make_shared<PooledBlock>(readPool_, kStreamChunkSize);
+      int n = ssh_channel_read_nonblocking(channel_, chunk->data(), kStreamChunkSize, is_stderr);
+      if (n <= 0) {
+        break;
+      }
+      io_.CountRead(static_cast<size_t>(n));
+
+      if (lineFramers_[is_stderr]) {
+        Deliver(is_stderr, chunk->data(), static_cast<size_t>(n));
+      } else {
+        EmitData(is_stderr, std::move(chunk), static_cast<size_t>(n));
+      }
+      progress = true;
+      if (i == kMaxChunksPerDrain - 1) {
+        more = true;
+      }
+    }
+  }
+
+  // OnData may have left new data behind while we were reading
+  if (more) {
+    backlog_ = true;
+  }
+  return progress;
+}
+
+void SSHChannel::FinishStream() {
+  if (!streamActive_) {
+    return;
+  }
+  streamActive_ = false;
+
+  ssh_remove_channel_callbacks(channel_, &callbacks_);
+  reactor_->RemovePoller(this);
+
+  if (!eofEmitted_) {
+    eofEmitted_ = true;
+    FlushLines(true);
+    EmitStream("eof");
+  }
+  if (exitStatusSet_) {
+    EmitStream("exit", exitStatus_);
+  }
+  EmitStream("close");
+
+  reactor_->CallJs([this](Napi::Env) {
+    onEvent_.Reset();
+    reactor_->Unref();
+    Unref();
+  });
+}
+
+int SSHChannel::TimeoutMs() {
+  if (!streamActive_ || !lineFramers_[0]) {
+    return -1;
+  }
+
+  // Wake up in time to flush the oldest partial batch
+  int timeout = -1;
+  auto now = std::chrono::steady_clock::now();
+  for (const auto& framer : lineFramers_) {
+    if (framer->HasLines()) {
+      auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(now - framer->firstLineAt());
+      int remaining = static_cast<int>(std::max<int64_t>((flushInterval_ - waited).count(), 0));
+      timeout = timeout < 0 ? remaining : std::min(timeout, remaining);
+    }
+  }
+  return timeout;
+}
+
+void SSHChannel::Deliver(bool isStderr, const char* data, size_t length) {
+  LineFramer* framer = lineFramers_[isStderr ? 1 : 0].get();
+  if (framer == nullptr) {
+    std::shared_ptr<PooledBlock> block = std::make_shared<PooledBlock>(readPool_, length);
+    std::memcpy(block->data(), data, length);
+    EmitData(isStderr, std::move(block), length);
+    return;
+  }
+
+  framer->Push(data, length);
+  while (framer->HasFullBatch()) {
+    EmitLines(isStderr, framer->Take());
+  }
+}
+
+// Emits partial batches whose flush interval has passed, or all remaining
+// lines at end of stream
+bool SSHChannel::FlushLines(bool all) {
+  if (!lineFramers_[0]) {
+    return false;
+  }
+
+  bool progress = false;
+  auto now = std::chrono::steady_clock::now();
+  for (int i = 0; i <= 1; i++) {
+    LineFramer* framer = lineFramers_[i].get();
+    if (all) {
+      framer->Finish();
+    }
+    while (framer->HasLines() && (all || framer->HasFullBatch() ||
+                                  now - framer->firstLineAt() >= flushInterval_)) {
+      EmitLines(i == 1, framer->Take());
+      progress = true;
+    }
+  }
+  return progress;
+}
+
+void SSHChannel::EmitLines(bool isStderr, LineBatch batch) {
+  reactor_->CallJs([this, isStderr, batch = std::move(batch)](Napi::Env env) {
+    if (onEvent_.IsEmpty()) {
+      return;
+    }
+    Napi::Object event = Napi::Object::New(env);
+    event.Set("type", isStderr ? "stderrLines" : "lines");
+    event.Set("lines", batch.ToArray(env));
+    onEvent_.Call({event});
+  });
+}
+
+void SSHChannel::EmitData(bool isStderr, std::shared_ptr<PooledBlock> block, size_t length) {
+  reactor_->CallJs([this, isStderr, block = std::move(block), length](Napi::Env env) {
+    if (onEvent_.IsEmpty()) {
+      return;
+    }
+    Napi::Object event = Napi::Object::New(env);
+    event.Set("type", isStderr ? "stderr" : "data");
+    event.Set("data", block->Wrap(env, length));
+    onEvent_.Call({event});
+  });
+}
+
+void SSHChannel::EmitStream(const char* type, int code) {
+  reactor_->CallJs([this, type, code](Napi::Env env) {
+    if (onEvent_.IsEmpty()) {
+      return;
+    }
+    Napi::Object event = Napi::Object::New(env);
+    event.Set("type", type);
+    if (std::strcmp(type, "exit") == 0) {
+      event.Set("code", Napi::Number::New(env, code));
+    }
+    onEvent_.Call({event});
+  });
+}
+
+int SSHChannel::OnData(ssh_session session, ssh_channel channel, void* data,
+                       uint32_t len, int is_stderr, void* userdata) {
+  SSHChannel* self = static_cast<SSHChannel*>(userdata);
+
+  // Leaving the data in libssh's buffer also stops the window from being
+  // extended, which pushes back on the server
+  if (!self->reading_ || self->backlog_) {
+    self->backlog_ = true;
+    return 0;
+  }
+
+  self->io_.CountRead(len);
+  self->Deliver(is_stderr != 0, static_cast<const char*>(data), len);
+  return static_cast<int>(len);
+}
+
+void SSHChannel::OnEof(ssh_session session, ssh_channel channel, void* userdata) {
+  static_cast<SSHChannel*>(userdata)->remoteEof_ = true;
+}
+
+void SSHChannel::OnClose(ssh_session session, ssh_channel channel, void* userdata) {
+  static_cast<SSHChannel*>(userdata)->remoteClosed_ = true;
+}
+
+void SSHChannel::OnExitStatus(ssh_session session, ssh_channel channel, int status, void* userdata) {
+  SSHChannel* self = static_cast<SSHChannel*>(userdata);
+  self->exitStatusSet_ = true;
+  self->exitStatus_ = status;
+}
+
+void SSHChannel::OnLinkClosed(ssh_session session, ssh_channel channel, void* userdata) {
+  static_cast<ChannelLink*>(userdata)->open.store(false);
+}
+
+// Reactor thread, once an open has succeeded
+void SSHChannel::Opened() {
+  link_->open.store(true);
+  ssh_add_channel_callbacks(channel_, &link_->callbacks);
+  sessionStats_->channelsOpen.fetch_add(1, std::memory_order_relaxed);
+  counted_ = true;
+}
+
+void SSHChannel::Uncount() {
+  if (counted_) {
+    sessionStats_->channelsOpen.fetch_sub(1, std::memory_order_relaxed);
+    counted_ = false;
+  }
+}
+
+// Reactor thread, when an open is aborted or times out. libssh would
+// resume the pending open on the next one, whatever its type, so that
+// starts on a new channel; the server's late answer is dealt with by the
+// reactor.
+void SSHChannel::AbandonOpen() {
+  if (channel_ != nullptr) {
+    reactor_->ReapChannel(channel_);
+    channel_ = nullptr;
+  }
+}
+
+// Reactor Workers Implementation
 
 // ChannelOpenWorker
-ChannelOpenWorker::ChannelOpenWorker(Napi::Env env, ssh_channel channel, const Napi::Promise::Deferred& deferred)
-    : Napi::AsyncWorker(env), channel_(channel), deferred_(deferred), result_(SSH_ERROR) {}
+ChannelOpenWorker::ChannelOpenWorker(Napi::Env env, SSHChannel* channel, const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, channel->Value(), channel->Operation("open")),
+      owner_(channel), deferred_(deferred), result_(SSH_ERROR) {}
+
+int ChannelOpenWorker::Execute() {
+  if (owner_->channel_ == nullptr) {
+    owner_->channel_ = ssh_channel_new(owner_->session_);
+    if (owner_->channel_ == nullptr) {
+      errorMessage_ = "Failed to create channel";
+      return result_;
+    }
+  }
 
-void ChannelOpenWorker::Execute() {
-  result_ = ssh_channel_open_session(channel_);
-  if (result_ != SSH_OK) {
+  result_ = ssh_channel_open_session(owner_->channel_);
+  if (result_ == SSH_AGAIN) {
+    return result_;
+  }
+  if (result_ == SSH_OK) {
+    owner_->Opened();
+  } else {
     errorMessage_ = "Failed to open channel session";
   }
+  SessionStats& stats = *owner_->sessionStats_;
+  (result_ == SSH_OK ? stats.channelsOpened : stats.channelOpenFailures).fetch_add(1, std::memory_order_relaxed);
+  return result_;
 }
 
 void ChannelOpenWorker::OnOK() {
+  owner_->opening_ = false;
   if (result_ == SSH_OK) {
-    SSHChannel* channelObj = static_cast<SSHChannel*>(deferred_.Env().GetInstanceData<void>());
-    if (channelObj) {
-      channelObj->open_ = true;
-    }
+    owner_->open_ = true;
     deferred_.Resolve(Env().Undefined());
   } else {
     deferred_.Reject(Napi::Error::New(Env(), errorMessage_).Value());
@@ -219,28 +866,52 @@ void ChannelOpenWorker::OnOK() {
 }
 
 void ChannelOpenWorker::OnError(const Napi::Error& error) {
+  owner_->opening_ = false;
   deferred_.Reject(error.Value());
 }
 
+void ChannelOpenWorker::Cancel() {
+  owner_->AbandonOpen();
+}
+
 // ChannelForwardWorker
-ChannelForwardWorker::ChannelForwardWorker(Napi::Env env, ssh_channel channel,
+ChannelForwardWorker::ChannelForwardWorker(Napi::Env env, SSHChannel* channel,
                                            const std::string& remoteHost, int remotePort,
                                            const std::string& sourceHost, int sourcePort,
                                            const Napi::Promise::Deferred& deferred)
-    : Napi::AsyncWorker(env), channel_(channel), remoteHost_(remoteHost), remotePort_(remotePort),
+    : ReactorWorker(env, channel->Value(), channel->Operation("openForward")),
+      owner_(channel), remoteHost_(remoteHost), remotePort_(remotePort),
       sourceHost_(sourceHost), sourcePort_(sourcePort), deferred_(deferred), result_(SSH_ERROR) {}
 
-void ChannelForwardWorker::Execute() {
-  result_ = ssh_channel_open_forward(channel_,
-                                      remoteHost_.c_str(), remotePort_,
-                                      sourceHost_.c_str(), sourcePort_);
-  if (result_ != SSH_OK) {
+int ChannelForwardWorker::Execute() {
+  if (owner_->channel_ == nullptr) {
+    owner_->channel_ = ssh_channel_new(owner_->session_);
+    if (owner_->channel_ == nullptr) {
+      errorMessage_ = "Failed to create channel";
+      return result_;
+    }
+  }
+
+  result_ = ssh_channel_open_forward(owner_->channel_,
+                                     remoteHost_.c_str(), remotePort_,
+                                     sourceHost_.c_str(), sourcePort_);
+  if (result_ == SSH_AGAIN) {
+    return result_;
+  }
+  if (result_ == SSH_OK) {
+    owner_->Opened();
+  } else {
     errorMessage_ = "Failed to open forward channel";
   }
+  SessionStats& stats = *owner_->sessionStats_;
+  (result_ == SSH_OK ? stats.channelsOpened : stats.channelOpenFailures).fetch_add(1, std::memory_order_relaxed);
+  return result_;
 }
 
 void ChannelForwardWorker::OnOK() {
+  owner_->opening_ = false;
   if (result_ == SSH_OK) {
+    owner_->open_ = true;
     deferred_.Resolve(Env().Undefined());
   } else {
     deferred_.Reject(Napi::Error::New(Env(), errorMessage_).Value());
@@ -248,30 +919,69 @@ void ChannelForwardWorker::OnOK() {
 }
 
 void ChannelForwardWorker::OnError(const Napi::Error& error) {
+  owner_->opening_ = false;
   deferred_.Reject(error.Value());
 }
 
+void ChannelForwardWorker::Cancel() {
+  owner_->AbandonOpen();
+}
+
 // ChannelReadWorker
-ChannelReadWorker::ChannelReadWorker(Napi::Env env, ssh_channel channel, int maxBytes,
+ChannelReadWorker::ChannelReadWorker(Napi::Env env, SSHChannel* channel, int maxBytes,
                                      const Napi::Promise::Deferred& deferred)
-    : Napi::AsyncWorker(env), channel_(channel), maxBytes_(maxBytes),
-      deferred_(deferred), bytesRead_(0) {
-  buffer_.resize(maxBytes);
+    : ReactorWorker(env, channel->Value(), channel->Operation("read")), owner_(channel), pool_(channel->readPool_),
+      block_(nullptr), blockSize_(std::max(maxBytes, 1)), dest_(nullptr),
+      capacity_(static_cast<uint32_t>(std::max(maxBytes, 0))), deferred_(deferred), bytesRead_(0) {
+  block_ = pool_->Acquire(blockSize_);
+  dest_ = block_;
+}
+
+ChannelReadWorker::ChannelReadWorker(Napi::Env env, SSHChannel* channel, const Napi::Buffer<char>& target,
+                                     size_t offset, size_t length, const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, channel->Value(), channel->Operation("read")), owner_(channel), block_(nullptr), blockSize_(0),
+      targetRef_(Napi::Persistent(target)), dest_(target.Data() + offset),
+      capacity_(static_cast<uint32_t>(std::min<size_t>(length, UINT32_MAX))),
+      deferred_(deferred), bytesRead_(0) {}
+
+ChannelReadWorker::~ChannelReadWorker() {
+  if (block_ != nullptr) {
+    pool_->Release(block_, blockSize_);
+  }
 }
 
-void ChannelReadWorker::Execute() {
-  bytesRead_ = ssh_channel_read(channel_, buffer_.data(), maxBytes_, 0);
+int ChannelReadWorker::Execute() {
+  ssh_channel channel = owner_->channel_;
+
+  bytesRead_ = ssh_channel_read_nonblocking(channel, dest_, capacity_, 0);
+  if (bytesRead_ == SSH_EOF) {
+    bytesRead_ = 0;
+    return SSH_OK;
+  }
   if (bytesRead_ < 0) {
     errorMessage_ = "Failed to read from channel";
+    return SSH_ERROR;
   }
+  if (bytesRead_ > 0) {
+    owner_->io_.CountRead(static_cast<size_t>(bytesRead_));
+  }
+  if (bytesRead_ == 0 && capacity_ > 0 &&
+      !ssh_channel_is_eof(channel) && !ssh_channel_is_closed(channel)) {
+    // Nothing buffered yet; retry once the session socket has data
+    return SSH_AGAIN;
+  }
+  return SSH_OK;
 }
 
 void ChannelReadWorker::OnOK() {
-  if (bytesRead_ >= 0) {
-    Napi::Buffer<char> result = Napi::Buffer<char>::Copy(Env(), buffer_.data(), bytesRead_);
-    deferred_.Resolve(result);
-  } else {
+  if (bytesRead_ < 0) {
     deferred_.Reject(Napi::Error::New(Env(), errorMessage_).Value());
+  } else if (block_ == nullptr) {
+    deferred_.Resolve(Napi::Number::New(Env(), bytesRead_));
+  } else {
+    char* block = block_;
+    block_ = nullptr;
+    deferred_.Resolve(pool_->Wrap(Env(), block, blockSize_, bytesRead_));
   }
 }
 
@@ -280,22 +990,43 @@ void ChannelReadWorker::OnError(const Napi::Error& error) {
 }
 
 // ChannelWriteWorker
-ChannelWriteWorker::ChannelWriteWorker(Napi::Env env, ssh_channel channel,
-                                       const std::vector<char>& data,
+ChannelWriteWorker::ChannelWriteWorker(Napi::Env env, SSHChannel* channel,
+                                       const std::vector<Napi::Buffer<char>>& buffers,
                                        const Napi::Promise::Deferred& deferred)
-    : Napi::AsyncWorker(env), channel_(channel), data_(data),
-      deferred_(deferred), bytesWritten_(0) {}
+    : ReactorWorker(env, channel->Value(), channel->Operation("write")),
+      owner_(channel), length_(0), segment_(0), offset_(0),
+      queued_(false), done_(false), deferred_(deferred), bytesWritten_(0) {
+  bufferRefs_.reserve(buffers.size());
+  segments_.reserve(buffers.size());
+  for (const Napi::Buffer<char>& buffer : buffers) {
+    if (buffer.Length() == 0) {
+      continue;
+    }
+    bufferRefs_.push_back(Napi::Persistent(buffer));
+    segments_.push_back({buffer.Data(), buffer.Length()});
+    length_ += buffer.Length();
+  }
+}
 
-void ChannelWriteWorker::Execute() {
-  bytesWritten_ = ssh_channel_write(channel_, data_.data(), data_.size());
-  if (bytesWritten_ < 0) {
-    errorMessage_ = "Failed to write to channel";
+int ChannelWriteWorker::Execute() {
+  if (!queued_) {
+    if (segments_.empty()) {
+      return SSH_OK;
+    }
+    queued_ = true;
+    owner_->writeQueue_.push_back(this);
   }
+
+  // The first queued write to run in a reactor pass flushes for all of them
+  if (!done_) {
+    owner_->FlushWrites();
+  }
+  return done_ ? SSH_OK : SSH_AGAIN;
 }
 
 void ChannelWriteWorker::OnOK() {
   if (bytesWritten_ >= 0) {
-    deferred_.Resolve(Napi::Number::New(Env(), bytesWritten_));
+    deferred_.Resolve(Napi::Number::New(Env(), static_cast<double>(bytesWritten_)));
   } else {
     deferred_.Reject(Napi::Error::New(Env(), errorMessage_).Value());
   }
@@ -305,18 +1036,35 @@ void ChannelWriteWorker::OnError(const Napi::Error& error) {
   deferred_.Reject(error.Value());
 }
 
+// Bytes already handed to libssh stay sent; the rest is dropped
+void ChannelWriteWorker::Cancel() {
+  if (done_) {
+    return;
+  }
+  if (queued_) {
+    std::deque<ChannelWriteWorker*>& queue = owner_->writeQueue_;
+    queue.erase(std::remove(queue.begin(), queue.end(), this), queue.end());
+  }
+  owner_->io_.AddBuffered(-static_cast<int64_t>(length_ - static_cast<size_t>(bytesWritten_)));
+  done_ = true;
+}
+
 // ChannelExecWorker
-ChannelExecWorker::ChannelExecWorker(Napi::Env env, ssh_channel channel,
+ChannelExecWorker::ChannelExecWorker(Napi::Env env, SSHChannel* channel,
                                      const std::string& command,
                                      const Napi::Promise::Deferred& deferred)
-    : Napi::AsyncWorker(env), channel_(channel), command_(command),
+    : ReactorWorker(env, channel->Value(), channel->Operation("requestExec")), owner_(channel), command_(command),
       deferred_(deferred), result_(SSH_ERROR) {}
 
-void ChannelExecWorker::Execute() {
-  result_ = ssh_channel_request_exec(channel_, command_.c_str());
+int ChannelExecWorker::Execute() {
+  result_ = ssh_channel_request_exec(owner_->channel_, command_.c_str());
+  if (result_ == SSH_AGAIN) {
+    return result_;
+  }
   if (result_ != SSH_OK) {
     errorMessage_ = "Failed to execute command";
   }
+  return result_;
 }
 
 void ChannelExecWorker::OnOK() {
@@ -331,13 +1079,42 @@ void ChannelExecWorker::OnError(const Napi::Error& error) {
   deferred_.Reject(error.Value());
 }
 
-// ChannelCloseWorker
-ChannelCloseWorker::ChannelCloseWorker(Napi::Env env, ssh_channel channel, const Napi::Promise::Deferred& deferred)
-    : Napi::AsyncWorker(env), channel_(channel), deferred_(deferred) {}
+// ChannelEofWorker
+ChannelEofWorker::ChannelEofWorker(Napi::Env env, SSHChannel* channel, const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, channel->Value(), channel->Operation("sendEof")),
+      owner_(channel), deferred_(deferred), result_(SSH_ERROR) {}
 
-void ChannelCloseWorker::Execute() {
-  ssh_channel_send_eof(channel_);
-  ssh_channel_close(channel_);
+int ChannelEofWorker::Execute() {
+  // Earlier writes are already queued, since workers run in submission order
+  if (!owner_->writeQueue_.empty()) {
+    return SSH_AGAIN;
+  }
+  result_ = ssh_channel_send_eof(owner_->channel_);
+  return result_ == SSH_AGAIN ? SSH_AGAIN : SSH_OK;
+}
+
+void ChannelEofWorker::OnOK() {
+  if (result_ == SSH_OK) {
+    deferred_.Resolve(Env().Undefined());
+  } else {
+    deferred_.Reject(Napi::Error::New(Env(), "Failed to send EOF").Value());
+  }
+}
+
+void ChannelEofWorker::OnError(const Napi::Error& error) {
+  deferred_.Reject(error.Value());
+}
+
+// ChannelCloseWorker
+ChannelCloseWorker::ChannelCloseWorker(Napi::Env env, SSHChannel* channel, const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, channel->Value(), channel->Operation("close")), owner_(channel), deferred_(deferred) {}
+
+int ChannelCloseWorker::Execute() {
+  ssh_channel_send_eof(owner_->channel_);
+  ssh_channel_close(owner_->channel_);
+  owner_->Uncount();
+  owner_->FinishStream();
+  return SSH_OK;
 }
 
 void ChannelCloseWorker::OnOK() {
@@ -3,7 +3,17 @@
 
 #include <napi.h>
 #include <libssh/libssh.h>
+#include <libssh/callbacks.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <mutex>
+#include <vector>
+#include "buffer_pool.h"
+#include "line_framer.h"
+#include "reactor.h"
+#include "stats.h"
 
 namespace libssh_node {
 
@@ -14,11 +24,23 @@ class ChannelReadWorker;
 class ChannelWriteWorker;
 class ChannelCloseWorker;
 class ChannelExecWorker;
+class ChannelEofWorker;
+class ChannelCaptureWorker;
 
-class SSHChannel : public Napi::ObjectWrap<SSHChannel> {
+// Whether the far side still has the channel open, kept by the reactor
+// through a close callback. Outlives the wrapper until the channel is
+// freed, since the callback can fire until then.
+struct ChannelLink {
+  std::atomic<bool> open{false};
+  struct ssh_channel_callbacks_struct callbacks;
+};
+
+class SSHChannel : public Napi::ObjectWrap<SSHChannel>, public ReactorPoller {
 public:
   static Napi::Object Init(Napi::Env env, Napi::Object exports);
-  static Napi::Value NewInstance(Napi::Env env, ssh_session session, Napi::Value sessionRef);
+  static Napi::Value NewInstance(Napi::Env env, ssh_session session, std::shared_ptr<std::atomic<bool>> sessionAlive,
+                                 std::shared_ptr<BufferPool> readPool, std::shared_ptr<SessionStats> sessionStats,
+                                 Napi::Value sessionRef);
 
   explicit SSHChannel(const Napi::CallbackInfo& info);
   ~SSHChannel();
@@ -27,17 +49,89 @@ private:
   // Channel methods
   Napi::Value OpenSession(const Napi::CallbackInfo& info);
   Napi::Value RequestExec(const Napi::CallbackInfo& info);
+  Napi::Value Exec(const Napi::CallbackInfo& info);
   Napi::Value RequestForwardTcpIp(const Napi::CallbackInfo& info);
   Napi::Value Read(const Napi::CallbackInfo& info);
+  Napi::Value ReadInto(const Napi::CallbackInfo& info);
   Napi::Value Write(const Napi::CallbackInfo& info);
+  Napi::Value Writev(const Napi::CallbackInfo& info);
+  Napi::Value GetWriteQueueSize(const Napi::CallbackInfo& info);
   Napi::Value Close(const Napi::CallbackInfo& info);
   Napi::Value IsOpen(const Napi::CallbackInfo& info);
+  Napi::Value SendEof(const Napi::CallbackInfo& info);
+  Napi::Value GetStats(const Napi::CallbackInfo& info);
+
+  // Timings for one kind of operation, kept with the session's (JS thread)
+  OperationStats* Operation(const char* name);
+
+  // Push-mode streaming
+  Napi::Value StartStream(const Napi::CallbackInfo& info);
+  Napi::Value ReadStart(const Napi::CallbackInfo& info);
+  Napi::Value ReadStop(const Napi::CallbackInfo& info);
+
+  // Reactor thread
+  void Opened();
+  void AbandonOpen();
+  void Uncount(); // Takes the channel out of the session's channelsOpen
+  void FlushWrites();
+  void FailWrites(const std::string& message);
+  bool Poll() override;
+  int TimeoutMs() override;
+  bool DrainStream();
+  void Deliver(bool isStderr, const char* data, size_t length);
+  bool FlushLines(bool all);
+  void FinishStream();
+  void EmitStream(const char* type, int code = 0);
+  void EmitData(bool isStderr, std::shared_ptr<PooledBlock> block, size_t length);
+  void EmitLines(bool isStderr, LineBatch batch);
+
+  static int OnData(ssh_session session, ssh_channel channel, void* data,
+                    uint32_t len, int is_stderr, void* userdata);
+  static void OnEof(ssh_session session, ssh_channel channel, void* userdata);
+  static void OnClose(ssh_session session, ssh_channel channel, void* userdata);
+  static void OnExitStatus(ssh_session session, ssh_channel channel, int status, void* userdata);
+  static void OnLinkClosed(ssh_session session, ssh_channel channel, void* userdata);
 
   ssh_session session_;
-  ssh_channel channel_;
+  ssh_channel channel_; // Created and used on the reactor thread
   std::mutex mutex_;
+  bool opening_;
   bool open_;
+  bool counted_; // In sessionStats_->channelsOpen
+  std::shared_ptr<ChannelLink> link_;
+  std::shared_ptr<std::atomic<bool>> sessionAlive_; // The session's, kept by the reactor
   Napi::Reference<Napi::Value> sessionRef_; // Keep session alive
+  std::shared_ptr<Reactor> reactor_;
+  std::shared_ptr<BufferPool> readPool_;
+  std::shared_ptr<SessionStats> sessionStats_;
+  IoCounters io_; // Counts into the session's totals too
+
+  // Writes are flushed in order from one queue so concurrent write() calls
+  // cannot interleave, and small chunks are coalesced into one packet
+  std::deque<ChannelWriteWorker*> writeQueue_; // Reactor thread
+  std::vector<char> writeStaging_;             // Reactor thread
+  bool windowStalled_;                         // Reactor thread
+
+  // Streaming state. libssh callbacks can fire from inside any libssh call
+  // on the reactor thread, so they only consume data and set flags; Poll()
+  // does the rest.
+  bool streaming_;                  // JS thread
+  bool capturing_;                  // JS thread; exec() owns the channel's output
+  Napi::FunctionReference onEvent_; // JS thread
+  std::atomic<bool> reading_;       // Cleared while the JS readable is full
+  struct ssh_channel_callbacks_struct callbacks_;
+  bool streamActive_;
+  bool backlog_;                    // Data left buffered in libssh while paused
+  bool remoteEof_;
+  bool eofEmitted_;
+  bool remoteClosed_;
+  bool exitStatusSet_;
+  int exitStatus_;
+
+  // Line mode: output is split into lines natively and delivered in
+  // batches of up to maxBatch lines, or after flushInterval_
+  std::unique_ptr<LineFramer> lineFramers_[2]; // stdout, stderr
+  std::chrono::milliseconds flushInterval_;
 
   friend class ChannelOpenWorker;
   friend class ChannelForwardWorker;
@@ -45,35 +139,40 @@ private:
   friend class ChannelWriteWorker;
   friend class ChannelCloseWorker;
   friend class ChannelExecWorker;
+  friend class ChannelEofWorker;
+  friend class ChannelCaptureWorker;
+  friend class SSHSession;
 };
 
-// Async workers for channel operations
-class ChannelOpenWorker : public Napi::AsyncWorker {
+// Reactor workers for channel operations
+class ChannelOpenWorker : public ReactorWorker {
 public:
-  ChannelOpenWorker(Napi::Env env, ssh_channel channel, const Napi::Promise::Deferred& deferred);
-  void Execute() override;
+  ChannelOpenWorker(Napi::Env env, SSHChannel* channel, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
   void OnOK() override;
   void OnError(const Napi::Error& error) override;
+  void Cancel() override;
 
 private:
-  ssh_channel channel_;
+  SSHChannel* owner_;
   Napi::Promise::Deferred deferred_;
   int result_;
   std::string errorMessage_;
 };
 
-class ChannelForwardWorker : public Napi::AsyncWorker {
+class ChannelForwardWorker : public ReactorWorker {
 public:
-  ChannelForwardWorker(Napi::Env env, ssh_channel channel,
+  ChannelForwardWorker(Napi::Env env, SSHChannel* channel,
                        const std::string& remoteHost, int remotePort,
                        const std::string& sourceHost, int sourcePort,
                        const Napi::Promise::Deferred& deferred);
-  void Execute() override;
+  int Execute() override;
   void OnOK() override;
   void OnError(const Napi::Error& error) override;
+  void Cancel() override;
 
 private:
-  ssh_channel channel_;
+  SSHChannel* owner_;
   std::string remoteHost_;
   int remotePort_;
   std::string sourceHost_;
@@ -83,66 +182,107 @@ private:
   std::string errorMessage_;
 };
 
-class ChannelReadWorker : public Napi::AsyncWorker {
+class ChannelReadWorker : public ReactorWorker {
 public:
-  ChannelReadWorker(Napi::Env env, ssh_channel channel, int maxBytes,
+  // Read into a block from the session's pool
+  ChannelReadWorker(Napi::Env env, SSHChannel* channel, int maxBytes,
                     const Napi::Promise::Deferred& deferred);
-  void Execute() override;
+  // Read into part of a caller-supplied Buffer; resolves with the byte count
+  ChannelReadWorker(Napi::Env env, SSHChannel* channel, const Napi::Buffer<char>& target,
+                    size_t offset, size_t length, const Napi::Promise::Deferred& deferred);
+  ~ChannelReadWorker();
+  int Execute() override;
   void OnOK() override;
   void OnError(const Napi::Error& error) override;
 
 private:
-  ssh_channel channel_;
-  int maxBytes_;
+  SSHChannel* owner_;
+  std::shared_ptr<BufferPool> pool_;
+  char* block_; // Pooled block, owned until handed to JS
+  size_t blockSize_;
+  Napi::Reference<Napi::Buffer<char>> targetRef_;
+  char* dest_;
+  uint32_t capacity_;
   Napi::Promise::Deferred deferred_;
-  std::vector<char> buffer_;
   int bytesRead_;
   std::string errorMessage_;
 };
 
-class ChannelWriteWorker : public Napi::AsyncWorker {
+// Writes one or more Buffers without copying them. The caller's Buffers are
+// referenced until the write completes and must not be modified meanwhile.
+// The data itself is sent by SSHChannel::FlushWrites().
+class ChannelWriteWorker : public ReactorWorker {
 public:
-  ChannelWriteWorker(Napi::Env env, ssh_channel channel,
-                     const std::vector<char>& data,
+  ChannelWriteWorker(Napi::Env env, SSHChannel* channel,
+                     const std::vector<Napi::Buffer<char>>& buffers,
                      const Napi::Promise::Deferred& deferred);
-  void Execute() override;
+  int Execute() override;
   void OnOK() override;
   void OnError(const Napi::Error& error) override;
+  void Cancel() override;
+
+  size_t length() const { return length_; }
 
 private:
-  ssh_channel channel_;
-  std::vector<char> data_;
+  struct Segment {
+    const char* data;
+    size_t length;
+  };
+
+  SSHChannel* owner_;
+  std::vector<Napi::Reference<Napi::Buffer<char>>> bufferRefs_;
+  std::vector<Segment> segments_;
+  size_t length_;
+  size_t segment_;
+  size_t offset_;
+  bool queued_;
+  bool done_;
   Napi::Promise::Deferred deferred_;
-  int bytesWritten_;
+  int64_t bytesWritten_;
   std::string errorMessage_;
+
+  friend class SSHChannel;
 };
 
-class ChannelExecWorker : public Napi::AsyncWorker {
+class ChannelExecWorker : public ReactorWorker {
 public:
-  ChannelExecWorker(Napi::Env env, ssh_channel channel,
+  ChannelExecWorker(Napi::Env env, SSHChannel* channel,
                     const std::string& command,
                     const Napi::Promise::Deferred& deferred);
-  void Execute() override;
+  int Execute() override;
   void OnOK() override;
   void OnError(const Napi::Error& error) override;
 
 private:
-  ssh_channel channel_;
+  SSHChannel* owner_;
   std::string command_;
   Napi::Promise::Deferred deferred_;
   int result_;
   std::string errorMessage_;
 };
 
-class ChannelCloseWorker : public Napi::AsyncWorker {
+class ChannelEofWorker : public ReactorWorker {
+public:
+  ChannelEofWorker(Napi::Env env, SSHChannel* channel, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  SSHChannel* owner_;
+  Napi::Promise::Deferred deferred_;
+  int result_;
+};
+
+class ChannelCloseWorker : public ReactorWorker {
 public:
-  ChannelCloseWorker(Napi::Env env, ssh_channel channel, const Napi::Promise::Deferred& deferred);
-  void Execute() override;
+  ChannelCloseWorker(Napi::Env env, SSHChannel* channel, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
   void OnOK() override;
   void OnError(const Napi::Error& error) override;
 
 private:
-  ssh_channel channel_;
+  SSHChannel* owner_;
   Napi::Promise::Deferred deferred_;
 };
 
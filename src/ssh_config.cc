@@ -0,0 +1,633 @@
+#include "ssh_config.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+
+#ifndef _WIN32
+#include <glob.h>
+#endif
+
+namespace libssh_node {
+
+namespace {
+
+// OpenSSH's limit on nested Include directives
+constexpr int kMaxIncludeDepth = 16;
+
+// How long a parsed file is trusted before its mtimes are checked again
+constexpr auto kRecheckInterval = std::chrono::seconds(1);
+
+// Keywords whose every occurrence counts, instead of only the first
+const std::set<std::string> kAccumulating = {
+  "identityfile", "certificatefile", "localforward", "remoteforward", "dynamicforward", "sendenv",
+};
+
+std::string Lower(std::string text) {
+  std::transform(text.begin(), text.end(), text.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return text;
+}
+
+std::string HomeDirectory() {
+  const char* home = std::getenv("HOME");
+#ifdef _WIN32
+  if (home == nullptr) {
+    home = std::getenv("USERPROFILE");
+  }
+#endif
+  return home != nullptr ? home : "";
+}
+
+std::string ExpandHome(const std::string& path) {
+  if (path == "~" || path.compare(0, 2, "~/") == 0) {
+    return HomeDirectory() + path.substr(1);
+  }
+  return path;
+}
+
+bool IsAbsolute(const std::string& path) {
+#ifdef _WIN32
+  return (path.size() > 1 && path[1] == ':') || (!path.empty() && (path[0] == '\\' || path[0] == '/'));
+#else
+  return !path.empty() && path[0] == '/';
+#endif
+}
+
+std::string DirectoryOf(const std::string& path) {
+  size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+std::string Join(const std::vector<std::string>& words) {
+  std::string joined;
+  for (size_t i = 0; i < words.size(); i++) {
+    joined += (i > 0 ? " " : "") + words[i];
+  }
+  return joined;
+}
+
+// Splits a config line into its keyword and arguments. Accepts
+// "Keyword value" and "Keyword=value", double-quoted arguments, and a #
+// at the start of a word as the start of a comment.
+bool SplitLine(const std::string& line, std::string& keyword, std::vector<std::string>& args) {
+  size_t i = 0;
+  auto skipSpace = [&]() {
+    while (i < line.size() && std::isspace(static_cast<unsigned char>(line[i]))) {
+      i++;
+    }
+  };
+
+  skipSpace();
+  size_t start = i;
+  while (i < line.size() && !std::isspace(static_cast<unsigned char>(line[i])) && line[i] != '=') {
+    i++;
+  }
+  if (i == start || line[start] == '#') {
+    return false;
+  }
+  keyword = Lower(line.substr(start, i - start));
+
+  skipSpace();
+  if (i < line.size() && line[i] == '=') {
+    i++;
+  }
+
+  args.clear();
+  for (;;) {
+    skipSpace();
+    if (i >= line.size() || line[i] == '#') {
+      break;
+    }
+    std::string word;
+    if (line[i] == '"') {
+      size_t close = line.find('"', i + 1);
+      if (close == std::string::npos) {
+        close = line.size();
+      }
+      word = line.substr(i + 1, close - i - 1);
+      i = std::min(close + 1, line.size());
+    } else {
+      start = i;
+      while (i < line.size() && !std::isspace(static_cast<unsigned char>(line[i]))) {
+        i++;
+      }
+      word = line.substr(start, i - start);
+    }
+    args.push_back(word);
+  }
+  return true;
+}
+
+// ssh(1) wildcards: * for any run of characters, ? for one
+bool GlobMatch(const std::string& pattern, const std::string& text) {
+  size_t p = 0;
+  size_t t = 0;
+  size_t star = std::string::npos;
+  size_t mark = 0;
+  while (t < text.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+      p++;
+      t++;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      mark = t;
+    } else if (star != std::string::npos) {
+      p = star + 1;
+      t = ++mark;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    p++;
+  }
+  return p == pattern.size();
+}
+
+std::string LocalUser() {
+  const char* user = std::getenv("USER");
+  if (user == nullptr) {
+    user = std::getenv("USERNAME");
+  }
+  return user != nullptr ? Lower(user) : "";
+}
+
+} // namespace
+
+void SSHConfig::Resolve(const std::string& host, const std::string& user, SSHConfigOptions& options) const {
+  std::string name = Lower(host);
+  static const std::vector<uint32_t> kNone;
+  auto found = literalHosts_.find(name);
+  const std::vector<uint32_t>& literal = found != literalHosts_.end() ? found->second : kNone;
+
+  // Both lists are in file order; merging them keeps "first value wins"
+  size_t i = 0;
+  size_t j = 0;
+  while (i < scanned_.size() || j < literal.size()) {
+    uint32_t index;
+    if (j >= literal.size() || (i < scanned_.size() && scanned_[i] < literal[j])) {
+      index = scanned_[i++];
+    } else {
+      index = literal[j++];
+    }
+
+    const Block& block = blocks_[index];
+    if (!Matches(block, name, user, options)) {
+      continue;
+    }
+    for (const auto& option : block.options) {
+      if (kAccumulating.count(option.first) > 0) {
+        options[option.first].push_back(Join(option.second));
+      } else if (options.find(option.first) == options.end()) {
+        options[option.first] = {Join(option.second)};
+      }
+    }
+  }
+}
+
+bool SSHConfig::Matches(const Block& block, const std::string& host, const std::string& user,
+                        const SSHConfigOptions& options) const {
+  for (const Condition& condition : block.conditions) {
+    std::string subject;
+    switch (condition.kind) {
+      case Condition::kAll:
+        continue;
+      case Condition::kNever:
+        return false;
+      case Condition::kHost:
+        subject = host;
+        break;
+      case Condition::kUser: {
+        auto configured = options.find("user");
+        subject = Lower(configured != options.end() ? configured->second.front() : user);
+        break;
+      }
+      case Condition::kLocalUser:
+        subject = LocalUser();
+        break;
+    }
+
+    // A negated match rules the condition out, whatever else matches
+    bool matched = false;
+    for (const Pattern& pattern : condition.patterns) {
+      if (pattern.wildcard ? GlobMatch(pattern.glob, subject) : pattern.glob == subject) {
+        if (pattern.negated) {
+          return false;
+        }
+        matched = true;
+      }
+    }
+    if (!matched) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t SSHConfig::AddBlock(std::vector<Condition> conditions) {
+  blocks_.push_back({std::move(conditions), {}});
+  return blocks_.size() - 1;
+}
+
+namespace {
+
+// Host takes one pattern per word, Match a comma-separated list
+void AddPatterns(const std::string& text, bool commas, std::vector<std::string>& out) {
+  if (!commas) {
+    out.push_back(text);
+    return;
+  }
+  size_t start = 0;
+  for (;;) {
+    size_t comma = text.find(',', start);
+    std::string pattern = text.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+    if (!pattern.empty()) {
+      out.push_back(pattern);
+    }
+    if (comma == std::string::npos) {
+      break;
+    }
+    start = comma + 1;
+  }
+}
+
+} // namespace
+
+void SSHConfig::ParseFile(const std::string& path, const std::string& baseDir, size_t block, int depth) {
+  files_.push_back(Stamp(path));
+  std::ifstream file(path);
+  if (!file) {
+    return;
+  }
+
+  auto compile = [](const std::vector<std::string>& words, bool commas, Condition::Kind kind) {
+    std::vector<std::string> texts;
+    for (const std::string& word : words) {
+      AddPatterns(word, commas, texts);
+    }
+    Condition condition{kind, {}};
+    for (const std::string& text : texts) {
+      bool negated = text[0] == '!';
+      std::string glob = Lower(negated ? text.substr(1) : text);
+      bool wildcard = glob.find_first_of("*?") != std::string::npos;
+      condition.patterns.push_back({glob, negated, wildcard});
+    }
+    return condition;
+  };
+
+  std::string line;
+  std::string keyword;
+  std::vector<std::string> args;
+  while (std::getline(file, line)) {
+    if (!SplitLine(line, keyword, args)) {
+      continue;
+    }
+
+    if (keyword == "host") {
+      block = AddBlock({compile(args, false, Condition::kHost)});
+    } else if (keyword == "match") {
+      std::vector<Condition> conditions;
+      for (size_t i = 0; i < args.size(); i++) {
+        std::string criterion = Lower(args[i]);
+        if (criterion == "all" || criterion == "final") {
+          // Resolution is a single, final pass
+          conditions.push_back({Condition::kAll, {}});
+          continue;
+        }
+        std::vector<std::string> value;
+        if (i + 1 < args.size()) {
+          value.push_back(args[++i]);
+        }
+        if (criterion == "host" || criterion == "originalhost") {
+          conditions.push_back(compile(value, true, Condition::kHost));
+        } else if (criterion == "user") {
+          conditions.push_back(compile(value, true, Condition::kUser));
+        } else if (criterion == "localuser") {
+          conditions.push_back(compile(value, true, Condition::kLocalUser));
+        } else {
+          // exec, canonical and anything newer: never matches, as in libssh
+          conditions.push_back({Condition::kNever, {}});
+        }
+      }
+      block = AddBlock(std::move(conditions));
+    } else if (keyword == "include") {
+      for (const std::string& pattern : args) {
+        Include(pattern, baseDir, block, depth + 1);
+      }
+      // Lines after the Include still belong to the block it sat in
+      if (block != blocks_.size() - 1) {
+        std::vector<Condition> conditions = blocks_[block].conditions;
+        block = AddBlock(std::move(conditions));
+      }
+    } else {
+      blocks_[block].options.push_back({keyword, args});
+    }
+  }
+}
+
+void SSHConfig::Include(const std::string& pattern, const std::string& baseDir, size_t block, int depth) {
+  if (depth > kMaxIncludeDepth) {
+    return;
+  }
+
+  // Relative paths are relative to the directory of the top-level
+  // config, which for ~/.ssh/config is ~/.ssh as in ssh(1)
+  std::string path = ExpandHome(pattern);
+  if (!IsAbsolute(path)) {
+    path = baseDir + "/" + path;
+  }
+
+#ifndef _WIN32
+  if (path.find_first_of("*?[") != std::string::npos) {
+    // A new file in the directory changes its mtime
+    files_.push_back(Stamp(DirectoryOf(path)));
+    glob_t matches;
+    if (glob(path.c_str(), 0, nullptr, &matches) == 0) {
+      for (size_t i = 0; i < matches.gl_pathc; i++) {
+        ParseFile(matches.gl_pathv[i], baseDir, block, depth);
+      }
+    }
+    globfree(&matches);
+    return;
+  }
+#endif
+  ParseFile(path, baseDir, block, depth);
+}
+
+void SSHConfig::Index() {
+  for (uint32_t i = 0; i < blocks_.size(); i++) {
+    const Block& block = blocks_[i];
+    if (block.options.empty()) {
+      continue;
+    }
+
+    // Host lines of plain names are found by name; anything else is
+    // checked for every host
+    bool literal = block.conditions.size() == 1 && block.conditions[0].kind == Condition::kHost;
+    bool positive = false;
+    if (literal) {
+      for (const Pattern& pattern : block.conditions[0].patterns) {
+        literal = literal && !pattern.wildcard;
+        positive = positive || !pattern.negated;
+      }
+    }
+    if (!literal || !positive) {
+      scanned_.push_back(i);
+      continue;
+    }
+    for (const Pattern& pattern : block.conditions[0].patterns) {
+      if (!pattern.negated) {
+        std::vector<uint32_t>& entries = literalHosts_[pattern.glob];
+        if (entries.empty() || entries.back() != i) {
+          entries.push_back(i);
+        }
+      }
+    }
+  }
+}
+
+SSHConfig::FileStamp SSHConfig::Stamp(const std::string& path) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    return {path, 0, 0, false};
+  }
+  return {path, static_cast<int64_t>(info.st_mtime), static_cast<int64_t>(info.st_size), true};
+}
+
+bool SSHConfig::Changed() const {
+  for (const FileStamp& file : files_) {
+    FileStamp current = Stamp(file.path);
+    if (current.exists != file.exists || current.mtime != file.mtime || current.size != file.size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::shared_ptr<const SSHConfig> SSHConfig::Load(const std::string& path) {
+  struct CacheEntry {
+    std::shared_ptr<const SSHConfig> config;
+    std::chrono::steady_clock::time_point checked;
+  };
+  static std::mutex mutex;
+  static std::unordered_map<std::string, CacheEntry> cache;
+
+  std::string file = ExpandHome(path);
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(mutex);
+
+  CacheEntry& entry = cache[file];
+  if (entry.config && now - entry.checked < kRecheckInterval) {
+    return entry.config;
+  }
+  entry.checked = now;
+  if (entry.config && !entry.config->Changed()) {
+    return entry.config;
+  }
+
+  auto config = std::make_shared<SSHConfig>();
+  size_t global = config->AddBlock({}); // Options before the first Host apply to every host
+  config->ParseFile(file, DirectoryOf(file), global, 0);
+  config->Index();
+  entry.config = config;
+  return entry.config;
+}
+
+std::string SSHConfig::UserConfigPath() {
+  return HomeDirectory() + "/.ssh/config";
+}
+
+std::string SSHConfig::GlobalConfigPath() {
+#ifdef _WIN32
+  const char* programData = std::getenv("PROGRAMDATA");
+  return std::string(programData != nullptr ? programData : "C:\\ProgramData") + "\\ssh\\ssh_config";
+#else
+  return "/etc/ssh/ssh_config";
+#endif
+}
+
+namespace {
+
+enum class ConfigKind {
+  kString,
+  kBothDirections, // Set for client-to-server and server-to-client
+  kFirstWord,      // Only the first of several values is used
+  kYesNo,          // int 1/0
+  kYesNoBool,      // bool
+};
+
+struct ConfigOption {
+  const char* keyword;
+  const char* jsName; // Session option that overrides it when set explicitly
+  ssh_options_e option;
+  ssh_options_e serverToClient;
+  ConfigKind kind;
+};
+
+constexpr ConfigOption kConfigOptions[] = {
+  {"port", "port", SSH_OPTIONS_PORT_STR, SSH_OPTIONS_PORT_STR, ConfigKind::kString},
+  {"user", "user", SSH_OPTIONS_USER, SSH_OPTIONS_USER, ConfigKind::kString},
+  {"identityfile", "identity", SSH_OPTIONS_ADD_IDENTITY, SSH_OPTIONS_ADD_IDENTITY, ConfigKind::kString},
+  {"identityagent", "agentSocket", SSH_OPTIONS_IDENTITY_AGENT, SSH_OPTIONS_IDENTITY_AGENT, ConfigKind::kString},
+  {"ciphers", "ciphers", SSH_OPTIONS_CIPHERS_C_S, SSH_OPTIONS_CIPHERS_S_C, ConfigKind::kBothDirections},
+  {"macs", "macs", SSH_OPTIONS_HMAC_C_S, SSH_OPTIONS_HMAC_S_C, ConfigKind::kBothDirections},
+  {"kexalgorithms", "kex", SSH_OPTIONS_KEY_EXCHANGE, SSH_OPTIONS_KEY_EXCHANGE, ConfigKind::kString},
+  {"hostkeyalgorithms", "hostKeyAlgorithms", SSH_OPTIONS_HOSTKEYS, SSH_OPTIONS_HOSTKEYS, ConfigKind::kString},
+  {"pubkeyacceptedalgorithms", "publicKeyAcceptedTypes", SSH_OPTIONS_PUBLICKEY_ACCEPTED_TYPES,
+   SSH_OPTIONS_PUBLICKEY_ACCEPTED_TYPES, ConfigKind::kString},
+  {"pubkeyacceptedkeytypes", "publicKeyAcceptedTypes", SSH_OPTIONS_PUBLICKEY_ACCEPTED_TYPES,
+   SSH_OPTIONS_PUBLICKEY_ACCEPTED_TYPES, ConfigKind::kString},
+  {"compression", "compression", SSH_OPTIONS_COMPRESSION, SSH_OPTIONS_COMPRESSION, ConfigKind::kString},
+  {"userknownhostsfile", "knownHosts", SSH_OPTIONS_KNOWNHOSTS, SSH_OPTIONS_KNOWNHOSTS, ConfigKind::kFirstWord},
+  {"globalknownhostsfile", "globalKnownHosts", SSH_OPTIONS_GLOBAL_KNOWNHOSTS, SSH_OPTIONS_GLOBAL_KNOWNHOSTS,
+   ConfigKind::kFirstWord},
+  {"stricthostkeychecking", "strictHostKeyChecking", SSH_OPTIONS_STRICTHOSTKEYCHECK,
+   SSH_OPTIONS_STRICTHOSTKEYCHECK, ConfigKind::kYesNo},
+  {"passwordauthentication", "passwordAuth", SSH_OPTIONS_PASSWORD_AUTH, SSH_OPTIONS_PASSWORD_AUTH,
+   ConfigKind::kYesNo},
+  {"pubkeyauthentication", "publicKeyAuth", SSH_OPTIONS_PUBKEY_AUTH, SSH_OPTIONS_PUBKEY_AUTH, ConfigKind::kYesNo},
+  {"kbdinteractiveauthentication", "kbdintAuth", SSH_OPTIONS_KBDINT_AUTH, SSH_OPTIONS_KBDINT_AUTH,
+   ConfigKind::kYesNo},
+  {"gssapiauthentication", "gssapiAuth", SSH_OPTIONS_GSSAPI_AUTH, SSH_OPTIONS_GSSAPI_AUTH, ConfigKind::kYesNo},
+  {"bindaddress", "bindAddress", SSH_OPTIONS_BINDADDR, SSH_OPTIONS_BINDADDR, ConfigKind::kString},
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 10, 0)
+  {"identitiesonly", "identitiesOnly", SSH_OPTIONS_IDENTITIES_ONLY, SSH_OPTIONS_IDENTITIES_ONLY,
+   ConfigKind::kYesNoBool},
+#endif
+};
+
+// -1 for anything but yes/no (e.g. StrictHostKeyChecking accept-new)
+int YesNo(const std::string& value) {
+  std::string lower = Lower(value);
+  if (lower == "yes" || lower == "true") {
+    return 1;
+  }
+  if (lower == "no" || lower == "false") {
+    return 0;
+  }
+  return -1;
+}
+
+void ApplyValue(ssh_session session, const ConfigOption& option, const std::string& value) {
+  switch (option.kind) {
+    case ConfigKind::kString:
+      ssh_options_set(session, option.option, value.c_str());
+      break;
+    case ConfigKind::kBothDirections:
+      ssh_options_set(session, option.option, value.c_str());
+      ssh_options_set(session, option.serverToClient, value.c_str());
+      break;
+    case ConfigKind::kFirstWord: {
+      std::string first = value.substr(0, value.find(' '));
+      ssh_options_set(session, option.option, first.c_str());
+      break;
+    }
+    case ConfigKind::kYesNo: {
+      int flag = YesNo(value);
+      if (flag >= 0) {
+        ssh_options_set(session, option.option, &flag);
+      }
+      break;
+    }
+    case ConfigKind::kYesNoBool: {
+      int flag = YesNo(value);
+      if (flag >= 0) {
+        bool enabled = flag == 1;
+        ssh_options_set(session, option.option, &enabled);
+      }
+      break;
+    }
+  }
+}
+
+// libssh before 0.11 has no ProxyJump of its own and, like its config
+// parser, goes through ssh -W instead
+void ApplyProxyJump(ssh_session session, const std::string& jump) {
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 11, 0)
+  ssh_options_set(session, SSH_OPTIONS_PROXYJUMP, jump.c_str());
+#else
+  size_t last = jump.rfind(',');
+  std::string command = "ssh ";
+  if (last != std::string::npos) {
+    command += "-J " + jump.substr(0, last) + " ";
+  }
+  command += "-W '[%h]:%p' " + jump.substr(last == std::string::npos ? 0 : last + 1);
+  ssh_options_set(session, SSH_OPTIONS_PROXYCOMMAND, command.c_str());
+#endif
+}
+
+} // namespace
+
+void ApplySSHConfig(ssh_session session, const SSHConfigOptions& options, const std::string& host,
+                    const std::set<std::string>& explicitOptions) {
+  auto hostName = options.find("hostname");
+  if (hostName != options.end()) {
+    // %h is the name that was looked up
+    std::string name;
+    const std::string& value = hostName->second.front();
+    for (size_t i = 0; i < value.size(); i++) {
+      if (value[i] == '%' && i + 1 < value.size() && (value[i + 1] == 'h' || value[i + 1] == '%')) {
+        name += value[i + 1] == 'h' ? host : "%";
+        i++;
+      } else {
+        name += value[i];
+      }
+    }
+    ssh_options_set(session, SSH_OPTIONS_HOST, name.c_str());
+  }
+
+  for (const ConfigOption& option : kConfigOptions) {
+    auto found = options.find(option.keyword);
+    if (found == options.end() || explicitOptions.count(option.jsName) > 0) {
+      continue;
+    }
+    for (const std::string& value : found->second) {
+      ApplyValue(session, option, value);
+    }
+  }
+
+  // ProxyCommand and ProxyJump exclude each other
+  auto proxyCommand = options.find("proxycommand");
+  auto proxyJump = options.find("proxyjump");
+  // An explicit proxyJump is chained over native jump sessions instead
+  if (explicitOptions.count("proxyCommand") > 0 || explicitOptions.count("proxyJump") > 0) {
+    return;
+  }
+  if (proxyCommand != options.end() && Lower(proxyCommand->second.front()) != "none") {
+    ssh_options_set(session, SSH_OPTIONS_PROXYCOMMAND, proxyCommand->second.front().c_str());
+  } else if (proxyJump != options.end() && Lower(proxyJump->second.front()) != "none") {
+    ApplyProxyJump(session, proxyJump->second.front());
+  }
+}
+
+Napi::Value ResolveConfig(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "Expected a host name").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  std::string host = info[0].As<Napi::String>().Utf8Value();
+  std::string path = info.Length() > 1 && info[1].IsString() ? info[1].As<Napi::String>().Utf8Value()
+                                                               : SSHConfig::UserConfigPath();
+
+  SSHConfigOptions options;
+  SSHConfig::Load(path)->Resolve(host, "", options);
+
+  Napi::Object result = Napi::Object::New(env);
+  for (const auto& option : options) {
+    Napi::Array values = Napi::Array::New(env, option.second.size());
+    for (size_t i = 0; i < option.second.size(); i++) {
+      values.Set(static_cast<uint32_t>(i), Napi::String::New(env, option.second[i]));
+    }
+    result.Set(option.first, values);
+  }
+  return result;
+}
+
+} // namespace libssh_node
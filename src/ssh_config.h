@@ -0,0 +1,95 @@
+#ifndef LIBSSH_NODE_SSH_CONFIG_H
+#define LIBSSH_NODE_SSH_CONFIG_H
+
+#include <napi.h>
+#include <libssh/libssh.h>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace libssh_node {
+
+// Effective options for one host, by lowercase keyword
+using SSHConfigOptions = std::map<std::string, std::vector<std::string>>;
+
+// An ssh_config file and everything it includes, parsed once into blocks
+// with precompiled Host/Match patterns. Host blocks with only literal
+// names are indexed by name, so resolving a host costs one hash lookup
+// plus the wildcard and Match blocks, however many hosts the file lists.
+class SSHConfig {
+public:
+  // The parsed file at path (~ expanded), shared process-wide. Reparsed
+  // once the file, an included file or a globbed directory has a new
+  // mtime or size; checked at most once a second. A missing file gives
+  // an empty config.
+  static std::shared_ptr<const SSHConfig> Load(const std::string& path);
+
+  // Default config files in the order libssh reads them
+  static std::string UserConfigPath();
+  static std::string GlobalConfigPath();
+
+  // Adds the options for host to options, keeping values already there:
+  // as with ssh(1), the first value obtained wins, except for keywords
+  // such as IdentityFile that accumulate. user is the remote user for
+  // Match user when the config does not set one first.
+  void Resolve(const std::string& host, const std::string& user, SSHConfigOptions& options) const;
+
+private:
+  struct Pattern {
+    std::string glob; // Lowercase
+    bool negated;
+    bool wildcard;    // Contains * or ?; otherwise compared as a string
+  };
+
+  // Host patterns, or one Match criterion and its pattern list
+  struct Condition {
+    enum Kind { kAll, kHost, kUser, kLocalUser, kNever } kind;
+    std::vector<Pattern> patterns;
+  };
+
+  struct Block {
+    std::vector<Condition> conditions; // All must match; none for the global block
+    std::vector<std::pair<std::string, std::vector<std::string>>> options;
+  };
+
+  struct FileStamp {
+    std::string path;
+    int64_t mtime;
+    int64_t size;
+    bool exists;
+  };
+
+  void ParseFile(const std::string& path, const std::string& baseDir, size_t block, int depth);
+  void Include(const std::string& pattern, const std::string& baseDir, size_t block, int depth);
+  size_t AddBlock(std::vector<Condition> conditions);
+  void Index();
+  bool Matches(const Block& block, const std::string& host, const std::string& user,
+               const SSHConfigOptions& options) const;
+  bool Changed() const;
+
+  static FileStamp Stamp(const std::string& path);
+
+  std::vector<Block> blocks_;
+  std::unordered_map<std::string, std::vector<uint32_t>> literalHosts_; // Lowercase name -> blocks
+  std::vector<uint32_t> scanned_;                                       // Blocks checked for every host
+  std::vector<FileStamp> files_;                                        // Files and globbed directories read
+};
+
+// Applies an ssh_config to a session as libssh's own parser would, for
+// options the session has not set explicitly (explicit holds their JS
+// names). HostName replaces the host; Match and Host use host.
+void ApplySSHConfig(ssh_session session, const SSHConfigOptions& options, const std::string& host,
+                    const std::set<std::string>& explicitOptions);
+
+// resolveConfig(host, configPath?): effective options for host from the
+// given config, or ~/.ssh/config, as { keyword: [values] }
+Napi::Value ResolveConfig(const Napi::CallbackInfo& info);
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_SSH_CONFIG_H
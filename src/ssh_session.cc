@@ -1,33 +1,55 @@
 #include "ssh_session.h"
 #include "ssh_channel.h"
 #include "async_workers.h"
+#include "exec.h"
+#include "jump_transport.h"
+#include "addon_data.h"
+#include "session_options.h"
+#include "ssh_config.h"
 #include "utils.h"
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 
+namespace {
+
+constexpr size_t kReadBlockSize = 65536;
+constexpr size_t kMaxFreeReadBlocks = 16;
+// Stays under OpenSSH's default MaxSessions (10) so other channels fit
+constexpr int kDefaultExecConcurrency = 8;
+constexpr size_t kDefaultExecMaxOutput = 1024 * 1024;
+
+} // namespace
+
 namespace libssh_node {
 
 Napi::Object SSHSession::Init(Napi::Env env, Napi::Object exports) {
   Napi::Function func = DefineClass(env, "SSHSession", {
     InstanceMethod("setOption", &SSHSession::SetOption),
     InstanceMethod("connect", &SSHSession::Connect),
+    InstanceMethod("connectVia", &SSHSession::ConnectVia),
     InstanceMethod("disconnect", &SSHSession::Disconnect),
     InstanceMethod("authenticatePassword", &SSHSession::AuthenticatePassword),
     InstanceMethod("authenticateAgent", &SSHSession::AuthenticateAgent),
     InstanceMethod("parseConfig", &SSHSession::ParseConfig),
     InstanceMethod("isConnected", &SSHSession::IsConnected),
-    InstanceMethod("createChannel", &SSHSession::CreateChannel)
+    InstanceMethod("createChannel", &SSHSession::CreateChannel),
+    InstanceMethod("openChannels", &SSHSession::OpenChannels),
+    InstanceMethod("execMany", &SSHSession::ExecMany),
+    InstanceMethod("getStats", &SSHSession::GetStats)
   });
 
-  Napi::FunctionReference* constructor = new Napi::FunctionReference();
-  *constructor = Napi::Persistent(func);
-  env.SetInstanceData(constructor);
+  env.GetInstanceData<AddonData>()->sessionConstructor = Napi::Persistent(func);
 
   exports.Set("SSHSession", func);
   return exports;
 }
 
 SSHSession::SSHSession(const Napi::CallbackInfo& info)
-    : Napi::ObjectWrap<SSHSession>(info), session_(nullptr), connected_(false) {
+    : Napi::ObjectWrap<SSHSession>(info), session_(nullptr), connected_(false),
+      alive_(std::make_shared<std::atomic<bool>>(false)), timeoutMs_(0),
+      happyEyeballs_(true), bindAddress_(false), proxyJump_(false), configProcessed_(false), agentClientId_(0),
+      stats_(std::make_shared<SessionStats>()) {
   Napi::Env env = info.Env();
 
   session_ = ssh_new();
@@ -36,17 +58,31 @@ SSHSession::SSHSession(const Napi::CallbackInfo& info)
     return;
   }
 
+  // All I/O happens on the reactor thread, which needs every libssh call
+  // to return SSH_AGAIN instead of blocking
+  ssh_set_blocking(session_, 0);
+  reactor_ = Reactor::Get(env);
+  readPool_ = std::make_shared<BufferPool>(kReadBlockSize, kMaxFreeReadBlocks);
+
   // Set default options from constructor argument
   if (info.Length() > 0 && info[0].IsObject()) {
     Napi::Object options = info[0].As<Napi::Object>();
+    Napi::Array names = options.GetPropertyNames();
+    for (uint32_t i = 0; i < names.Length(); i++) {
+      std::string name = names.Get(i).As<Napi::String>().Utf8Value();
+      NoteOption(name, options.Get(name));
+    }
 
     std::string host = GetStringOption(options, "host");
     if (!host.empty()) {
       ssh_options_set(session_, SSH_OPTIONS_HOST, host.c_str());
     }
 
-    int port = GetIntOption(options, "port", 22);
-    ssh_options_set(session_, SSH_OPTIONS_PORT, &port);
+    // Left unset, so a Port from the config file applies
+    int port = GetIntOption(options, "port", 0);
+    if (port > 0) {
+      ssh_options_set(session_, SSH_OPTIONS_PORT, &port);
+    }
 
     std::string user = GetStringOption(options, "user");
     if (!user.empty()) {
@@ -55,28 +91,46 @@ SSHSession::SSHSession(const Napi::CallbackInfo& info)
 
     std::string configFile = GetStringOption(options, "configFile");
     if (!configFile.empty()) {
-      ssh_options_parse_config(session_, configFile.c_str());
+      ApplyConfig({configFile});
     }
 
-    std::string agentSocket = GetStringOption(options, "agentSocket");
-    if (!agentSocket.empty()) {
-      ssh_options_set(session_, SSH_OPTIONS_IDENTITY_AGENT, agentSocket.c_str());
+    // Everything else, after the config file so explicit values win
+    if (!ApplySessionOptions(env, session_, options)) {
+      return;
     }
+    happyEyeballs_ = GetBoolOption(options, "happyEyeballs", true);
 
     int timeout = GetIntOption(options, "timeout", 0);
     if (timeout > 0) {
-      long timeoutLong = timeout;
-      ssh_options_set(session_, SSH_OPTIONS_TIMEOUT, &timeoutLong);
+      // The option is in milliseconds; libssh takes seconds plus microseconds
+      long timeoutSec = timeout / 1000;
+      long timeoutUsec = (timeout % 1000) * 1000;
+      ssh_options_set(session_, SSH_OPTIONS_TIMEOUT, &timeoutSec);
+      ssh_options_set(session_, SSH_OPTIONS_TIMEOUT_USEC, &timeoutUsec);
+      timeoutMs_ = timeout;
     }
   }
 }
 
 SSHSession::~SSHSession() {
   if (session_ != nullptr) {
-    if (connected_) {
-      ssh_disconnect(session_);
-    }
-    ssh_free(session_);
+    // Channels keep their session alive, so any channel cleanup posted
+    // earlier has already run by the time this task does
+    ssh_session session = session_;
+    bool connected = connected_;
+    std::shared_ptr<Reactor> reactor = reactor_;
+    std::shared_ptr<JumpTransport> jump = jump_;
+    reactor_->Post([reactor, session, connected, jump]() {
+      reactor->RemoveSession(session);
+      if (connected) {
+        ssh_disconnect(session);
+      }
+      ssh_free(session);
+      // Before jumpRef_ lets the jump session go
+      if (jump) {
+        jump->Close();
+      }
+    });
     session_ = nullptr;
   }
 }
@@ -90,49 +144,129 @@ Napi::Value SSHSession::SetOption(const Napi::CallbackInfo& info) {
   }
 
   std::string option = info[0].As<Napi::String>().Utf8Value();
-  int result = SSH_ERROR;
-
-  if (option == "host") {
-    std::string value = info[1].As<Napi::String>().Utf8Value();
-    result = ssh_options_set(session_, SSH_OPTIONS_HOST, value.c_str());
-  } else if (option == "port") {
-    int value = info[1].As<Napi::Number>().Int32Value();
-    result = ssh_options_set(session_, SSH_OPTIONS_PORT, &value);
-  } else if (option == "user") {
-    std::string value = info[1].As<Napi::String>().Utf8Value();
-    result = ssh_options_set(session_, SSH_OPTIONS_USER, value.c_str());
-  } else if (option == "agentSocket") {
-    std::string value = info[1].As<Napi::String>().Utf8Value();
-    result = ssh_options_set(session_, SSH_OPTIONS_IDENTITY_AGENT, value.c_str());
-  } else {
-    Napi::Error::New(env, "Unknown option: " + option).ThrowAsJavaScriptException();
+  if (option == "happyEyeballs") {
+    if (!info[1].IsBoolean()) {
+      Napi::TypeError::New(env, "Option happyEyeballs must be a boolean").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    happyEyeballs_ = info[1].As<Napi::Boolean>().Value();
     return env.Undefined();
   }
 
-  if (result != SSH_OK) {
-    CreateSSHError(env, session_, "Failed to set option").ThrowAsJavaScriptException();
+  if (SetSessionOption(env, session_, option, info[1])) {
+    NoteOption(option, info[1]);
   }
-
   return env.Undefined();
 }
 
+void SSHSession::NoteOption(const std::string& name, const Napi::Value& value) {
+  if (value.IsUndefined() || value.IsNull()) {
+    return;
+  }
+  explicitOptions_.insert(name);
+
+  if (name == "host" && value.IsString()) {
+    configHost_ = value.As<Napi::String>().Utf8Value();
+  } else if (name == "agentSocket" && value.IsString()) {
+    agentSocket_ = value.As<Napi::String>().Utf8Value();
+  } else if (name == "processConfig" && value.IsBoolean()) {
+    // libssh treats processConfig=false as "already processed"
+    configProcessed_ = !value.As<Napi::Boolean>().Value();
+  } else if (name == "bindAddress" && value.IsString()) {
+    bindAddress_ = true;
+  }
+}
+
+// Goes through the shared SSHConfig cache rather than libssh's parser,
+// which would read every file again for every session
+void SSHSession::ApplyConfig(const std::vector<std::string>& files) {
+  std::string user;
+  char* current = nullptr;
+  if (ssh_options_get(session_, SSH_OPTIONS_USER, &current) == SSH_OK) {
+    user = current;
+    ssh_string_free_char(current);
+  }
+
+  SSHConfigOptions options;
+  for (const std::string& file : files) {
+    SSHConfig::Load(file)->Resolve(configHost_, user, options);
+  }
+  ApplySSHConfig(session_, options, configHost_, explicitOptions_);
+  if (options.count("bindaddress") > 0 && explicitOptions_.count("bindAddress") == 0) {
+    bindAddress_ = true;
+  }
+  auto agent = options.find("identityagent");
+  if (agent != options.end() && explicitOptions_.count("agentSocket") == 0 &&
+      agent->second.front() != "SSH_AUTH_SOCK") {
+    agentSocket_ = agent->second.front();
+  }
+  auto jump = options.find("proxyjump");
+  proxyJump_ = jump != options.end() && jump->second.front() != "none" &&
+               explicitOptions_.count("proxyCommand") == 0 && explicitOptions_.count("proxyJump") == 0;
+
+  // Otherwise ssh_connect() parses ~/.ssh/config itself
+  bool process = false;
+  ssh_options_set(session_, SSH_OPTIONS_PROCESS_CONFIG, &process);
+  configProcessed_ = true;
+}
+
 Napi::Value SSHSession::Connect(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
 
-  ConnectWorker* worker = new ConnectWorker(env, session_, deferred);
+  ConnectWorker* worker = new ConnectWorker(env, this, deferred);
+  worker->SetCancellation(info[0]);
   worker->Queue();
 
-  connected_ = true; // Will be set to false if connection fails
+  return deferred.Promise();
+}
+
+// Connects over a direct-tcpip channel of a connected, authenticated
+// jump session rather than over TCP
+Napi::Value SSHSession::ConnectVia(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    Napi::Error::New(env, "Expected a jump session").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Object jumpObj = info[0].As<Napi::Object>();
+  SSHSession* jump = SSHSession::Unwrap(jumpObj);
+  if (jump == nullptr || jump == this || jump->session_ == nullptr) {
+    Napi::Error::New(env, "Invalid jump session").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!jump->connected_) {
+    Napi::Error::New(env, "Jump session is not connected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+  ConnectWorker* worker = new ConnectWorker(env, this, deferred, jump);
+  worker->SetCancellation(info[1]);
+  worker->Queue();
 
   return deferred.Promise();
 }
 
+// The transport of the previous connection, if any, closes on the
+// reactor thread before its jump session can be released
+void SSHSession::SetJump(std::shared_ptr<JumpTransport> transport, Napi::ObjectReference jumpRef) {
+  if (jump_) {
+    std::shared_ptr<JumpTransport> previous = jump_;
+    reactor_->Post([previous]() { previous->Close(); });
+  }
+  jump_ = std::move(transport);
+  jumpRef_ = std::move(jumpRef);
+}
+
 Napi::Value SSHSession::Disconnect(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
 
-  DisconnectWorker* worker = new DisconnectWorker(env, session_, deferred);
+  DisconnectWorker* worker = new DisconnectWorker(env, this, deferred);
   worker->Queue();
 
   connected_ = false;
@@ -153,7 +287,8 @@ Napi::Value SSHSession::AuthenticatePassword(const Napi::CallbackInfo& info) {
 
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
 
-  AuthPasswordWorker* worker = new AuthPasswordWorker(env, session_, username, password, deferred);
+  AuthPasswordWorker* worker = new AuthPasswordWorker(env, this, username, password, deferred);
+  worker->SetCancellation(info[2]);
   worker->Queue();
 
   return deferred.Promise();
@@ -169,7 +304,8 @@ Napi::Value SSHSession::AuthenticateAgent(const Napi::CallbackInfo& info) {
 
   Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
 
-  AuthAgentWorker* worker = new AuthAgentWorker(env, session_, username, deferred);
+  AuthAgentWorker* worker = new AuthAgentWorker(env, this, username, deferred);
+  worker->SetCancellation(info[1]);
   worker->Queue();
 
   return deferred.Promise();
@@ -178,15 +314,10 @@ Napi::Value SSHSession::AuthenticateAgent(const Napi::CallbackInfo& info) {
 Napi::Value SSHSession::ParseConfig(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
 
-  const char* configFile = nullptr;
   if (info.Length() > 0 && info[0].IsString()) {
-    std::string file = info[0].As<Napi::String>().Utf8Value();
-    configFile = file.c_str();
-  }
-
-  int result = ssh_options_parse_config(session_, configFile);
-  if (result != SSH_OK) {
-    CreateSSHError(env, session_, "Failed to parse SSH config").ThrowAsJavaScriptException();
+    ApplyConfig({info[0].As<Napi::String>().Utf8Value()});
+  } else {
+    ApplyConfig({SSHConfig::UserConfigPath(), SSHConfig::GlobalConfigPath()});
   }
 
   return env.Undefined();
@@ -194,7 +325,7 @@ Napi::Value SSHSession::ParseConfig(const Napi::CallbackInfo& info) {
 
 Napi::Value SSHSession::IsConnected(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  return Napi::Boolean::New(env, connected_ && ssh_is_connected(session_));
+  return Napi::Boolean::New(env, connected_ && alive_->load());
 }
 
 Napi::Value SSHSession::CreateChannel(const Napi::CallbackInfo& info) {
@@ -205,13 +336,135 @@ Napi::Value SSHSession::CreateChannel(const Napi::CallbackInfo& info) {
     return env.Undefined();
   }
 
-  Napi::FunctionReference* channelConstructor = env.GetInstanceData<Napi::FunctionReference>();
-  if (channelConstructor == nullptr) {
+  if (env.GetInstanceData<AddonData>()->channelConstructor.IsEmpty()) {
     Napi::Error::New(env, "Channel constructor not available").ThrowAsJavaScriptException();
     return env.Undefined();
   }
 
-  return SSHChannel::NewInstance(env, session_, Value());
+  return SSHChannel::NewInstance(env, session_, alive_, readPool_, stats_, Value());
+}
+
+// Opens one channel per target. Every open is handed to the reactor in a
+// single batch, so all CHANNEL_OPEN requests are written before the first
+// confirmation is awaited and the burst costs about one round trip.
+// Targets with a remoteHost open direct-tcpip channels; others open
+// session channels. Returns [{ channel, opened }] in target order.
+Napi::Value SSHSession::OpenChannels(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!connected_) {
+    Napi::Error::New(env, "Session is not connected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1 || !info[0].IsArray()) {
+    Napi::Error::New(env, "Expected an array of channel targets").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Array targets = info[0].As<Napi::Array>();
+  Napi::Array result = Napi::Array::New(env, targets.Length());
+  std::vector<ReactorWorker*> workers;
+  workers.reserve(targets.Length());
+
+  for (uint32_t i = 0; i < targets.Length(); i++) {
+    Napi::Value target = targets.Get(i);
+    Napi::Object options = target.IsObject() ? target.As<Napi::Object>() : Napi::Object::New(env);
+
+    Napi::Object obj = SSHChannel::NewInstance(env, session_, alive_, readPool_, stats_, Value()).As<Napi::Object>();
+    SSHChannel* channel = SSHChannel::Unwrap(obj);
+    channel->opening_ = true;
+
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+    std::string remoteHost = GetStringOption(options, "remoteHost");
+    if (remoteHost.empty()) {
+      workers.push_back(new ChannelOpenWorker(env, channel, deferred));
+    } else {
+      workers.push_back(new ChannelForwardWorker(
+        env, channel, remoteHost, GetIntOption(options, "remotePort", 0),
+        GetStringOption(options, "sourceHost", "127.0.0.1"), GetIntOption(options, "sourcePort", 0),
+        deferred));
+    }
+    // One signal or deadline covers the whole batch
+    workers.back()->SetCancellation(info[1]);
+
+    Napi::Object entry = Napi::Object::New(env);
+    entry.Set("channel", obj);
+    entry.Set("opened", deferred.Promise());
+    result.Set(i, entry);
+  }
+
+  reactor_->Submit(workers);
+  return result;
+}
+
+// Runs every command on its own channel, at most `concurrency` at a time,
+// and resolves once with [{ command, exitCode, signal, stdout, stderr,
+// truncated, timedOut, error? }] in command order
+Napi::Value SSHSession::ExecMany(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!connected_) {
+    Napi::Error::New(env, "Session is not connected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1 || !info[0].IsArray()) {
+    Napi::Error::New(env, "Expected an array of commands").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Array commands = info[0].As<Napi::Array>();
+  std::vector<std::unique_ptr<ExecJob>> jobs;
+  jobs.reserve(commands.Length());
+
+  for (uint32_t i = 0; i < commands.Length(); i++) {
+    Napi::Value entry = commands.Get(i);
+    if (entry.IsString()) {
+      CapturePolicy capture;
+      capture.maxBytes = kDefaultExecMaxOutput;
+      jobs.push_back(std::make_unique<ExecJob>(entry.As<Napi::String>().Utf8Value(), 0, capture));
+      continue;
+    }
+
+    Napi::Object options = entry.IsObject() ? entry.As<Napi::Object>() : Napi::Object::New(env);
+    std::string command = GetStringOption(options, "command");
+    if (command.empty()) {
+      Napi::Error::New(env, "Each command needs a command string").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    int timeoutMs = std::max(GetIntOption(options, "timeoutMs", 0), 0);
+    jobs.push_back(std::make_unique<ExecJob>(command, timeoutMs,
+                                             ParseCapturePolicy(options, kDefaultExecMaxOutput)));
+  }
+
+  int concurrency = kDefaultExecConcurrency;
+  if (info.Length() > 1 && info[1].IsObject()) {
+    concurrency = GetIntOption(info[1].As<Napi::Object>(), "concurrency", kDefaultExecConcurrency);
+  }
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  ExecManyWorker* worker = new ExecManyWorker(env, this, std::move(jobs),
+                                              static_cast<size_t>(std::max(concurrency, 1)), deferred);
+  worker->SetCancellation(info[1]);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+// Traffic of every channel, exec and SFTP transfer on the session,
+// queue-wait and execute histograms per operation, and the phases of the
+// last connect. Never waits on the reactor.
+Napi::Value SSHSession::GetStats(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::Object stats = Napi::Object::New(env);
+  stats_->io.AddTo(stats);
+  stats.Set("channelsOpened", static_cast<double>(stats_->channelsOpened.load(std::memory_order_relaxed)));
+  stats.Set("channelOpenFailures", static_cast<double>(stats_->channelOpenFailures.load(std::memory_order_relaxed)));
+  stats.Set("channelsOpen", static_cast<double>(stats_->channelsOpen.load(std::memory_order_relaxed)));
+  stats.Set("operations", stats_->operations.ToObject(env));
+  stats.Set("connect", connectTimings_.ToObject(env));
+  return stats;
 }
 
 } // namespace libssh_node
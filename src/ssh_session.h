@@ -3,10 +3,21 @@
 
 #include <napi.h>
 #include <libssh/libssh.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "buffer_pool.h"
+#include "reactor.h"
+#include "stats.h"
 
 namespace libssh_node {
 
+class JumpTransport;
+
 class SSHSession : public Napi::ObjectWrap<SSHSession> {
 public:
   static Napi::Object Init(Napi::Env env, Napi::Object exports);
@@ -17,18 +28,52 @@ private:
   // Session methods
   Napi::Value SetOption(const Napi::CallbackInfo& info);
   Napi::Value Connect(const Napi::CallbackInfo& info);
+  Napi::Value ConnectVia(const Napi::CallbackInfo& info);
   Napi::Value Disconnect(const Napi::CallbackInfo& info);
   Napi::Value AuthenticatePassword(const Napi::CallbackInfo& info);
   Napi::Value AuthenticateAgent(const Napi::CallbackInfo& info);
   Napi::Value ParseConfig(const Napi::CallbackInfo& info);
   Napi::Value IsConnected(const Napi::CallbackInfo& info);
   Napi::Value CreateChannel(const Napi::CallbackInfo& info);
+  Napi::Value OpenChannels(const Napi::CallbackInfo& info);
+  Napi::Value ExecMany(const Napi::CallbackInfo& info);
+  Napi::Value GetStats(const Napi::CallbackInfo& info);
+
+  // Keeps the fields below in step with options libssh cannot report back
+  void NoteOption(const std::string& name, const Napi::Value& value);
+  // Applies ssh_config files for configHost_ and marks config processed
+  void ApplyConfig(const std::vector<std::string>& files);
+  // Swaps in the jump transport and session of a new connection
+  void SetJump(std::shared_ptr<JumpTransport> transport, Napi::ObjectReference jumpRef);
 
   ssh_session session_;
   std::mutex mutex_;
   bool connected_;
+  std::shared_ptr<std::atomic<bool>> alive_; // Kept by the reactor: the connection is up
+  long timeoutMs_;
+  bool happyEyeballs_;   // Race the TCP connect across resolved addresses
+  bool bindAddress_;     // A local address is set, which only libssh's connect honours
+  bool proxyJump_;       // The config file routes through a jump host
+  bool configProcessed_; // ssh_connect() would not parse ~/.ssh/config any more
+  ConnectTimings connectTimings_;
+  std::shared_ptr<JumpTransport> jump_; // Carries the connection when made through connectVia()
+  Napi::ObjectReference jumpRef_;       // Keeps the jump session alive while jump_ uses it
+  std::string agentSocket_;                // From agentSocket or IdentityAgent; SSH_AUTH_SOCK if empty
+  uint64_t agentClientId_;                 // Reactor thread: AgentClient login of this session, or 0
+  std::string configHost_;                 // Host as given, which Host and Match patterns see
+  std::set<std::string> explicitOptions_; // Set by the caller, so the config file leaves them alone
+  std::shared_ptr<Reactor> reactor_;
+  std::shared_ptr<BufferPool> readPool_; // Shared by this session's channels
+  std::shared_ptr<SessionStats> stats_;   // Shared by this session's channels
 
   friend class SSHChannel;
+  friend class SSHTunnel;
+  friend class SSHSftp;
+  friend class SSHAsyncWorker;
+  friend class ConnectWorker;
+  friend class AuthPasswordWorker;
+  friend class AuthAgentWorker;
+  friend class DisconnectWorker;
 };
 
 } // namespace libssh_node
@@ -1,27 +1,560 @@
 #include "ssh_sftp.h"
+#include "ssh_session.h"
+#include "addon_data.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kDefaultDirBatch = 1000;
+// READDIRs kept in flight per directory handle. OpenSSH answers each with
+// about 100 entries, so a batch takes a few round trips instead of ten.
+constexpr size_t kDirReadAhead = 4;
+constexpr int kDefaultTransferChannels = 4;
+// Ranges smaller than this are not worth another file open
+constexpr int kDefaultMinSplitBytes = 8 * 1024 * 1024;
+
+template <typename T>
+Napi::TypedArrayOf<T> CopyToTypedArray(Napi::Env env, const std::vector<T>& values) {
+  Napi::TypedArrayOf<T> array = Napi::TypedArrayOf<T>::New(env, values.size());
+  if (!values.empty()) {
+    std::memcpy(array.Data(), values.data(), values.size() * sizeof(T));
+  }
+  return array;
+}
+
+} // namespace
 
 namespace libssh_node {
 
+namespace {
+
+// The server answers requests on one handle in order, so READDIRs sent
+// back to back return consecutive runs of entries
+void ReadAhead(SftpDir& dir, SftpClient* client) {
+  if (dir.eof) {
+    return;
+  }
+  while (dir.requests.size() < kDirReadAhead) {
+    dir.requests.push_back(client->ReadDir(dir.handle));
+  }
+  client->Flush();
+}
+
+// Drops the replies still on their way
+void ForgetRequests(SftpDir& dir, SftpClient* client) {
+  for (uint32_t request : dir.requests) {
+    client->Forget(request);
+  }
+  dir.requests.clear();
+}
+
+} // namespace
+
 Napi::Object SSHSftp::Init(Napi::Env env, Napi::Object exports) {
-  Napi::Function func = DefineClass(env, "SSHSftp", {});
+  Napi::Function func = DefineClass(env, "SSHSftp", {
+    InstanceMethod("open", &SSHSftp::Open),
+    InstanceMethod("close", &SSHSftp::Close),
+    InstanceMethod("download", &SSHSftp::Download),
+    InstanceMethod("upload", &SSHSftp::Upload),
+    InstanceMethod("transferMany", &SSHSftp::TransferMany),
+    InstanceMethod("openDir", &SSHSftp::OpenDir),
+    InstanceMethod("readDir", &SSHSftp::ReadDir),
+    InstanceMethod("closeDir", &SSHSftp::CloseDir)
+  });
 
-  Napi::FunctionReference* constructor = new Napi::FunctionReference();
-  *constructor = Napi::Persistent(func);
+  env.GetInstanceData<AddonData>()->sftpConstructor = Napi::Persistent(func);
 
   exports.Set("SSHSftp", func);
   return exports;
 }
 
 SSHSftp::SSHSftp(const Napi::CallbackInfo& info)
-    : Napi::ObjectWrap<SSHSftp>(info), sftp_(nullptr) {
-  // To be implemented in Phase 5
+    : Napi::ObjectWrap<SSHSftp>(info), session_(nullptr),
+      reactor_(Reactor::Get(info.Env())), opening_(false), open_(false),
+      nextDirId_(1) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    Napi::Error::New(env, "Expected session").ThrowAsJavaScriptException();
+    return;
+  }
+
+  Napi::Object sessionObj = info[0].As<Napi::Object>();
+  SSHSession* session = SSHSession::Unwrap(sessionObj);
+  if (session == nullptr || session->session_ == nullptr) {
+    Napi::Error::New(env, "Invalid SSH session").ThrowAsJavaScriptException();
+    return;
+  }
+  session_ = session->session_;
+  stats_ = session->stats_;
+  sessionRef_ = Napi::Persistent(sessionObj);
 }
 
 SSHSftp::~SSHSftp() {
-  if (sftp_ != nullptr) {
-    sftp_free(sftp_);
-    sftp_ = nullptr;
+  // Once the reactor has stopped (environment teardown) the session frees
+  // the subsystem's channel itself. Closing the channel releases every
+  // directory handle on the server.
+  if (client_ && !reactor_->IsStopped()) {
+    reactor_->Post([client = std::move(client_)]() { client->Close(); });
+  }
+  sessionRef_.Reset();
+}
+
+bool SSHSftp::CheckOpen(Napi::Env env) {
+  if (!open_) {
+    Napi::Error::New(env, "SFTP session is not open").ThrowAsJavaScriptException();
+    return false;
+  }
+  return true;
+}
+
+OperationStats* SSHSftp::Operation(const char* name) {
+  return stats_ ? stats_->operations.Get(name) : nullptr;
+}
+
+Napi::Value SSHSftp::Open(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (opening_ || open_) {
+    Napi::Error::New(env, "SFTP session already opened").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  opening_ = true;
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  SftpOpenWorker* worker = new SftpOpenWorker(env, this, deferred);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+Napi::Value SSHSftp::Close(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+  if (!open_) {
+    deferred.Resolve(env.Undefined());
+    return deferred.Promise();
+  }
+  open_ = false;
+
+  SftpCloseWorker* worker = new SftpCloseWorker(env, this, deferred);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+// download(remotePath, localPath, { chunkSize, concurrency, onProgress, progressInterval })
+Napi::Value SSHSftp::Download(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!CheckOpen(env)) {
+    return env.Undefined();
+  }
+
+  if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+    Napi::Error::New(env, "Expected remotePath and localPath").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  std::string remotePath = info[0].As<Napi::String>().Utf8Value();
+  std::string localPath = info[1].As<Napi::String>().Utf8Value();
+  Napi::Object options = info.Length() > 2 && info[2].IsObject() ? info[2].As<Napi::Object>() : Napi::Object::New(env);
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  SftpTransferWorker* worker = new SftpTransferWorker(
+    env, this, "download", std::make_unique<SftpDownload>(remotePath, localPath, ParseTransferSettings(options)), options, deferred);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+// upload(localPath, remotePath, { chunkSize, concurrency, onProgress, progressInterval })
+Napi::Value SSHSftp::Upload(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!CheckOpen(env)) {
+    return env.Undefined();
   }
+
+  if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+    Napi::Error::New(env, "Expected localPath and remotePath").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  std::string localPath = info[0].As<Napi::String>().Utf8Value();
+  std::string remotePath = info[1].As<Napi::String>().Utf8Value();
+  Napi::Object options = info.Length() > 2 && info[2].IsObject() ? info[2].As<Napi::Object>() : Napi::Object::New(env);
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  SftpTransferWorker* worker = new SftpTransferWorker(
+    env, this, "upload", std::make_unique<SftpUpload>(remotePath, localPath, ParseTransferSettings(options)), options, deferred);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+// transferMany([{ direction, remotePath, localPath }], { channels, minSplitSize, ...transfer options })
+Napi::Value SSHSftp::TransferMany(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!CheckOpen(env)) {
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1 || !info[0].IsArray()) {
+    Napi::Error::New(env, "Expected array of transfers").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Object options = info.Length() > 1 && info[1].IsObject() ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+  TransferSettings settings = ParseTransferSettings(options);
+  size_t channels = static_cast<size_t>(std::max(GetIntOption(options, "channels", kDefaultTransferChannels), 1));
+  uint64_t minSplitBytes = static_cast<uint64_t>(
+    std::max(GetIntOption(options, "minSplitSize", kDefaultMinSplitBytes), 1));
+
+  Napi::Array jobs = info[0].As<Napi::Array>();
+  std::vector<std::unique_ptr<SftpTransfer>> transfers;
+  transfers.reserve(jobs.Length());
+
+  for (uint32_t i = 0; i < jobs.Length(); i++) {
+    Napi::Value value = jobs.Get(i);
+    if (!value.IsObject()) {
+      Napi::Error::New(env, "Expected transfer object").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    Napi::Object job = value.As<Napi::Object>();
+    std::string direction = GetStringOption(job, "direction");
+    std::string remotePath = GetStringOption(job, "remotePath");
+    std::string localPath = GetStringOption(job, "localPath");
+    if (remotePath.empty() || localPath.empty()) {
+      Napi::Error::New(env, "Expected remotePath and localPath").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+
+    if (direction == "download") {
+      transfers.push_back(std::make_unique<SftpDownload>(remotePath, localPath, settings));
+    } else if (direction == "upload") {
+      transfers.push_back(std::make_unique<SftpUpload>(remotePath, localPath, settings));
+    } else {
+      Napi::Error::New(env, "Expected direction 'download' or 'upload'").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  SftpTransferManyWorker* worker = new SftpTransferManyWorker(
+    env, this, std::move(transfers), channels, minSplitBytes, options, deferred);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+// openDir(path) resolves with a handle id for readDir/closeDir
+Napi::Value SSHSftp::OpenDir(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!CheckOpen(env)) {
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::Error::New(env, "Expected path").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  SftpOpenDirWorker* worker = new SftpOpenDirWorker(
+    env, this, info[0].As<Napi::String>().Utf8Value(), nextDirId_++, deferred);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+// readDir(handle, batchSize)
+Napi::Value SSHSftp::ReadDir(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!CheckOpen(env)) {
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1 || !info[0].IsNumber()) {
+    Napi::Error::New(env, "Expected directory handle").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  uint32_t id = info[0].As<Napi::Number>().Uint32Value();
+  size_t batchSize = kDefaultDirBatch;
+  if (info.Length() > 1 && info[1].IsNumber()) {
+    batchSize = static_cast<size_t>(std::max(info[1].As<Napi::Number>().Int32Value(), 1));
+  }
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  SftpReadDirWorker* worker = new SftpReadDirWorker(env, this, id, batchSize, deferred);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+// closeDir(handle)
+Napi::Value SSHSftp::CloseDir(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+  // Closing the subsystem already released every handle
+  if (!open_ || info.Length() < 1 || !info[0].IsNumber()) {
+    deferred.Resolve(env.Undefined());
+    return deferred.Promise();
+  }
+
+  SftpCloseDirWorker* worker = new SftpCloseDirWorker(env, this, info[0].As<Napi::Number>().Uint32Value(), deferred);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+
+// Reactor Workers Implementation
+
+// SftpOpenWorker
+SftpOpenWorker::SftpOpenWorker(Napi::Env env, SSHSftp* sftp, const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, sftp->Value(), sftp->Operation("sftpOpen")),
+      owner_(sftp), deferred_(deferred), result_(SSH_ERROR) {}
+
+int SftpOpenWorker::Execute() {
+  if (!client_) {
+    client_ = std::make_shared<SftpClient>(owner_->session_, owner_->stats_);
+  }
+
+  result_ = client_->Start();
+  if (result_ == SSH_AGAIN) {
+    return result_;
+  }
+  if (result_ != SSH_OK) {
+    errorMessage_ = client_->error();
+    client_->Close();
+    client_.reset();
+    return result_;
+  }
+
+  owner_->client_ = std::move(client_);
+  return result_;
+}
+
+void SftpOpenWorker::OnOK() {
+  owner_->opening_ = false;
+  if (result_ == SSH_OK) {
+    owner_->open_ = true;
+    deferred_.Resolve(Env().Undefined());
+  } else {
+    deferred_.Reject(Napi::Error::New(Env(), errorMessage_).Value());
+  }
+}
+
+void SftpOpenWorker::OnError(const Napi::Error& error) {
+  owner_->opening_ = false;
+  deferred_.Reject(error.Value());
+}
+
+// SftpCloseWorker
+SftpCloseWorker::SftpCloseWorker(Napi::Env env, SSHSftp* sftp, const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, sftp->Value(), sftp->Operation("sftpClose")), owner_(sftp), deferred_(deferred) {}
+
+// Closing the channel releases every directory handle on the server;
+// requests still running on it fail
+int SftpCloseWorker::Execute() {
+  if (owner_->client_) {
+    owner_->client_->Close();
+    owner_->client_.reset();
+  }
+  owner_->dirs_.clear();
+  return SSH_OK;
+}
+
+void SftpCloseWorker::OnOK() {
+  deferred_.Resolve(Env().Undefined());
+}
+
+void SftpCloseWorker::OnError(const Napi::Error& error) {
+  deferred_.Reject(error.Value());
+}
+
+// DirBatch
+void DirBatch::Add(const SftpName& entry) {
+  const SftpAttributes& attributes = entry.attributes;
+  names.insert(names.end(), entry.name.begin(), entry.name.end());
+  nameEnds.push_back(static_cast<uint32_t>(names.size()));
+  sizes.push_back(attributes.hasSize() ? static_cast<double>(attributes.size) : 0);
+  mtimes.push_back(static_cast<double>(attributes.mtime));
+  modes.push_back(attributes.permissions);
+}
+
+Napi::Object DirBatch::ToObject(Napi::Env env) const {
+  Napi::Object batch = Napi::Object::New(env);
+  batch.Set("names", Napi::Buffer<char>::Copy(env, names.data(), names.size()));
+  batch.Set("nameEnds", CopyToTypedArray(env, nameEnds));
+  batch.Set("sizes", CopyToTypedArray(env, sizes));
+  batch.Set("mtimes", CopyToTypedArray(env, mtimes));
+  batch.Set("modes", CopyToTypedArray(env, modes));
+  return batch;
+}
+
+// SftpOpenDirWorker
+SftpOpenDirWorker::SftpOpenDirWorker(Napi::Env env, SSHSftp* sftp, const std::string& path, uint32_t id,
+                                     const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, sftp->Value(), sftp->Operation("openDir")),
+      owner_(sftp), path_(path), id_(id), request_(0), deferred_(deferred), result_(SSH_ERROR) {}
+
+int SftpOpenDirWorker::Execute() {
+  if (!client_) {
+    client_ = owner_->client_;
+    if (!client_) {
+      errorMessage_ = "SFTP session is closed";
+      return result_;
+    }
+    request_ = client_->OpenDir(path_);
+    client_->Flush();
+  }
+
+  client_->Pump();
+  SftpReply reply;
+  int rc = client_->Take(request_, &reply);
+  if (rc == SSH_AGAIN) {
+    return rc;
+  }
+
+  std::string handle;
+  if (rc != SSH_OK || !reply.Handle(&handle)) {
+    errorMessage_ = "Failed to open directory: " + (rc != SSH_OK ? client_->error() : reply.Error());
+    return result_;
+  }
+  // Closed meanwhile: the handle went with the channel
+  if (owner_->client_ != client_) {
+    errorMessage_ = "SFTP session is closed";
+    return result_;
+  }
+
+  // The first entries are on their way before readDir() asks
+  SftpDir& dir = owner_->dirs_[id_];
+  dir.handle = std::move(handle);
+  ReadAhead(dir, client_.get());
+  result_ = SSH_OK;
+  return result_;
+}
+
+void SftpOpenDirWorker::OnOK() {
+  if (result_ == SSH_OK) {
+    deferred_.Resolve(Napi::Number::New(Env(), id_));
+  } else {
+    deferred_.Reject(Napi::Error::New(Env(), errorMessage_).Value());
+  }
+}
+
+void SftpOpenDirWorker::OnError(const Napi::Error& error) {
+  deferred_.Reject(error.Value());
+}
+
+// SftpReadDirWorker
+SftpReadDirWorker::SftpReadDirWorker(Napi::Env env, SSHSftp* sftp, uint32_t id, size_t batchSize,
+                                     const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, sftp->Value(), sftp->Operation("readDir")),
+      owner_(sftp), id_(id), batchSize_(batchSize), deferred_(deferred), eof_(false), result_(SSH_ERROR) {}
+
+int SftpReadDirWorker::Execute() {
+  auto it = owner_->dirs_.find(id_);
+  if (it == owner_->dirs_.end()) {
+    errorMessage_ = "Directory handle is closed";
+    return result_;
+  }
+  SftpDir& dir = it->second;
+  SftpClient* client = owner_->client_.get();
+  client->Pump();
+
+  // Each READDIR reply carries a run of entries
+  while (batch_.size() < batchSize_) {
+    if (dir.next < dir.entries.size()) {
+      const SftpName& entry = dir.entries[dir.next++];
+      if (entry.name != "." && entry.name != "..") {
+        batch_.Add(entry);
+      }
+      continue;
+    }
+    if (dir.eof) {
+      eof_ = true;
+      break;
+    }
+
+    ReadAhead(dir, client);
+    SftpReply reply;
+    int rc = client->Take(dir.requests.front(), &reply);
+    if (rc == SSH_AGAIN) {
+      return rc;
+    }
+    dir.requests.pop_front();
+    dir.entries.clear();
+    dir.next = 0;
+
+    uint32_t code;
+    if (rc == SSH_OK && reply.Names(&dir.entries)) {
+      continue;
+    }
+    // The READDIRs sent after the end only get EOF themselves
+    if (rc == SSH_OK && reply.Status(&code) && code == kSftpEof) {
+      dir.eof = true;
+      ForgetRequests(dir, client);
+      continue;
+    }
+    dir.entries.clear();
+    ForgetRequests(dir, client);
+    errorMessage_ = "Failed to read directory: " + (rc != SSH_OK ? client->error() : reply.Error());
+    return result_;
+  }
+
+  result_ = SSH_OK;
+  return result_;
+}
+
+void SftpReadDirWorker::OnOK() {
+  if (result_ != SSH_OK) {
+    deferred_.Reject(Napi::Error::New(Env(), errorMessage_).Value());
+  } else if (batch_.size() == 0 && eof_) {
+    deferred_.Resolve(Env().Null());
+  } else {
+    deferred_.Resolve(batch_.ToObject(Env()));
+  }
+}
+
+void SftpReadDirWorker::OnError(const Napi::Error& error) {
+  deferred_.Reject(error.Value());
+}
+
+// SftpCloseDirWorker
+SftpCloseDirWorker::SftpCloseDirWorker(Napi::Env env, SSHSftp* sftp, uint32_t id,
+                                       const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, sftp->Value(), sftp->Operation("closeDir")), owner_(sftp), id_(id), deferred_(deferred) {}
+
+// Nothing waits for the CLOSE reply; the handle is gone either way
+int SftpCloseDirWorker::Execute() {
+  auto it = owner_->dirs_.find(id_);
+  if (it != owner_->dirs_.end()) {
+    SftpClient* client = owner_->client_.get();
+    ForgetRequests(it->second, client);
+    client->Forget(client->CloseHandle(it->second.handle));
+    client->Flush();
+    owner_->dirs_.erase(it);
+  }
+  return SSH_OK;
+}
+
+void SftpCloseDirWorker::OnOK() {
+  deferred_.Resolve(Env().Undefined());
+}
+
+void SftpCloseDirWorker::OnError(const Napi::Error& error) {
+  deferred_.Reject(error.Value());
 }
 
 } // namespace libssh_node
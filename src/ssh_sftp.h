@@ -3,11 +3,37 @@
 
 #include <napi.h>
 #include <libssh/libssh.h>
-#include <libssh/sftp.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "reactor.h"
+#include "sftp_client.h"
+#include "sftp_transfer.h"
 
 namespace libssh_node {
 
-// Placeholder for Phase 5
+class SftpOpenWorker;
+class SftpCloseWorker;
+class SftpOpenDirWorker;
+class SftpReadDirWorker;
+class SftpCloseDirWorker;
+
+// An open directory handle, the entries of its last READDIR reply not yet
+// handed out and the READDIRs sent ahead of them. Reactor thread.
+struct SftpDir {
+  std::string handle;
+  std::vector<SftpName> entries;
+  size_t next = 0;
+  std::deque<uint32_t> requests; // Awaiting their replies, oldest first
+  bool eof = false;
+};
+
+// SFTP subsystem on a connected session. All requests run on the reactor
+// thread without waiting for the server; file transfers keep a window of
+// read/write requests in flight so throughput is not bounded by one round
+// trip per chunk.
 class SSHSftp : public Napi::ObjectWrap<SSHSftp> {
 public:
   static Napi::Object Init(Napi::Env env, Napi::Object exports);
@@ -15,7 +41,135 @@ public:
   ~SSHSftp();
 
 private:
-  sftp_session sftp_;
+  Napi::Value Open(const Napi::CallbackInfo& info);
+  Napi::Value Close(const Napi::CallbackInfo& info);
+  Napi::Value Download(const Napi::CallbackInfo& info);
+  Napi::Value Upload(const Napi::CallbackInfo& info);
+  Napi::Value TransferMany(const Napi::CallbackInfo& info);
+  Napi::Value OpenDir(const Napi::CallbackInfo& info);
+  Napi::Value ReadDir(const Napi::CallbackInfo& info);
+  Napi::Value CloseDir(const Napi::CallbackInfo& info);
+
+  // Throws and returns false unless the subsystem is open (JS thread)
+  bool CheckOpen(Napi::Env env);
+  // Timings for one kind of request, kept with the session's
+  OperationStats* Operation(const char* name);
+
+  ssh_session session_;
+  Napi::ObjectReference sessionRef_; // Keep session alive
+  std::shared_ptr<SessionStats> stats_; // The session's; file data counts as its traffic
+  std::shared_ptr<SftpClient> client_; // Reactor thread; shared with running requests
+  std::shared_ptr<Reactor> reactor_;
+  bool opening_; // JS thread
+  bool open_;    // JS thread
+  std::map<uint32_t, SftpDir> dirs_; // Reactor thread, by handle id
+  uint32_t nextDirId_;                // JS thread
+
+  friend class SftpOpenWorker;
+  friend class SftpCloseWorker;
+  friend class SftpTransferWorker;
+  friend class SftpTransferManyWorker;
+  friend class SftpOpenDirWorker;
+  friend class SftpReadDirWorker;
+  friend class SftpCloseDirWorker;
+};
+
+// Starts the SFTP subsystem
+class SftpOpenWorker : public ReactorWorker {
+public:
+  SftpOpenWorker(Napi::Env env, SSHSftp* sftp, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  SSHSftp* owner_;
+  std::shared_ptr<SftpClient> client_; // Until started
+  Napi::Promise::Deferred deferred_;
+  int result_;
+  std::string errorMessage_;
+};
+
+// Shuts the SFTP subsystem down and closes its channel
+class SftpCloseWorker : public ReactorWorker {
+public:
+  SftpCloseWorker(Napi::Env env, SSHSftp* sftp, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  SSHSftp* owner_;
+  Napi::Promise::Deferred deferred_;
+};
+
+// One chunk of a directory listing in columnar form, so a huge directory
+// costs a handful of JS allocations per batch instead of one per entry
+struct DirBatch {
+  std::vector<char> names;        // UTF-8, back to back
+  std::vector<uint32_t> nameEnds; // End offset of each name
+  std::vector<double> sizes;
+  std::vector<double> mtimes;     // Seconds since the epoch
+  std::vector<uint32_t> modes;    // Permissions including file type bits
+
+  size_t size() const { return nameEnds.size(); }
+  void Add(const SftpName& entry);
+  Napi::Object ToObject(Napi::Env env) const;
+};
+
+// Opens a directory handle
+class SftpOpenDirWorker : public ReactorWorker {
+public:
+  SftpOpenDirWorker(Napi::Env env, SSHSftp* sftp, const std::string& path, uint32_t id,
+                    const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  SSHSftp* owner_;
+  std::shared_ptr<SftpClient> client_;
+  std::string path_;
+  uint32_t id_;
+  uint32_t request_;
+  Napi::Promise::Deferred deferred_;
+  int result_;
+  std::string errorMessage_;
+};
+
+// Reads up to batchSize entries, skipping "." and "..". Resolves with
+// null once the listing is exhausted.
+class SftpReadDirWorker : public ReactorWorker {
+public:
+  SftpReadDirWorker(Napi::Env env, SSHSftp* sftp, uint32_t id, size_t batchSize,
+                    const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  SSHSftp* owner_;
+  uint32_t id_;
+  size_t batchSize_;
+  Napi::Promise::Deferred deferred_;
+  DirBatch batch_;
+  bool eof_;
+  int result_;
+  std::string errorMessage_;
+};
+
+// Closes a directory handle
+class SftpCloseDirWorker : public ReactorWorker {
+public:
+  SftpCloseDirWorker(Napi::Env env, SSHSftp* sftp, uint32_t id, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  SSHSftp* owner_;
+  uint32_t id_;
+  Napi::Promise::Deferred deferred_;
 };
 
 } // namespace libssh_node
@@ -0,0 +1,743 @@
+#include "ssh_tunnel.h"
+#include "ssh_session.h"
+#include "socket_util.h"
+#include "utils.h"
+#include <algorithm>
+
+namespace libssh_node {
+
+namespace {
+
+constexpr size_t kChunkSize = 65536;      // Matches the default SSHChannel read size
+constexpr int kMaxChunksPerPump = 4;      // Keep one busy connection from starving the rest
+constexpr int kListenBacklog = 128;
+// Wait before re-opening warm channels after the server refused one
+constexpr std::chrono::seconds kWarmRetryDelay(1);
+
+} // namespace
+
+struct SSHTunnel::Connection {
+  uint32_t id = 0;
+  socket_t fd = SSH_INVALID_SOCKET;
+  ssh_channel channel = nullptr;
+  std::string peerHost;
+  int peerPort = 0;
+
+  bool open = false;
+  bool closed = false;
+  bool localEof = false;      // Client shut down its write side
+  bool remoteEof = false;     // Channel EOF received from the server
+  bool localShutdown = false; // We shut down the client's read side
+  short events = 0;           // Events currently registered with the ssh_event
+  size_t buffered = 0;        // Share of bufferedBytes_
+
+  // Bytes accepted from one side that the other side could not take yet
+  std::vector<char> toLocal;
+  size_t toLocalOffset = 0;
+  std::vector<char> toRemote;
+  size_t toRemoteOffset = 0;
+
+  uint64_t bytesSent = 0;
+  uint64_t bytesReceived = 0;
+};
+
+// A forward channel opened ahead of time, before its client connects
+struct SSHTunnel::WarmChannel {
+  ssh_channel channel = nullptr;
+  bool open = false;
+};
+
+struct SSHTunnel::TunnelEvent {
+  std::string type;
+  uint32_t id = 0;
+  std::string address;
+  int port = 0;
+  uint64_t bytesSent = 0;
+  uint64_t bytesReceived = 0;
+  std::string message;
+};
+
+Napi::Object SSHTunnel::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function func = DefineClass(env, "SSHTunnel", {
+    InstanceMethod("start", &SSHTunnel::Start),
+    InstanceMethod("stop", &SSHTunnel::Stop),
+    InstanceMethod("getStats", &SSHTunnel::GetStats),
+    InstanceMethod("getConnections", &SSHTunnel::GetConnections),
+    InstanceMethod("isRunning", &SSHTunnel::IsRunning)
+  });
+
+  exports.Set("SSHTunnel", func);
+  return exports;
+}
+
+SSHTunnel::SSHTunnel(const Napi::CallbackInfo& info)
+    : Napi::ObjectWrap<SSHTunnel>(info), session_(nullptr), localPort_(0), remotePort_(0), prewarm_(0),
+      reactor_(Reactor::Get(info.Env())), started_(false), running_(false),
+      listenFd_(SSH_INVALID_SOCKET), acceptPending_(false), shutdown_(true), nextConnectionId_(0),
+      totalConnections_(0), activeConnections_(0), bytesSent_(0), bytesReceived_(0), bufferedBytes_(0),
+      warmChannels_(0) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
+    Napi::Error::New(env, "Expected session and options").ThrowAsJavaScriptException();
+    return;
+  }
+
+  Napi::Object sessionObj = info[0].As<Napi::Object>();
+  SSHSession* session = SSHSession::Unwrap(sessionObj);
+  if (session == nullptr || session->session_ == nullptr) {
+    Napi::Error::New(env, "Invalid SSH session").ThrowAsJavaScriptException();
+    return;
+  }
+  session_ = session->session_;
+  sessionRef_ = Napi::Persistent(sessionObj);
+  sessionAlive_ = session->alive_;
+  sessionStats_ = session->stats_;
+
+  Napi::Object options = info[1].As<Napi::Object>();
+  localHost_ = GetStringOption(options, "localHost", "127.0.0.1");
+  localPort_ = GetIntOption(options, "localPort", 0);
+  remoteHost_ = GetStringOption(options, "remoteHost");
+  remotePort_ = GetIntOption(options, "remotePort", 0);
+  prewarm_ = static_cast<size_t>(std::max(GetIntOption(options, "prewarm", 0), 0));
+
+  if (remoteHost_.empty() || remotePort_ <= 0) {
+    Napi::Error::New(env, "Expected remoteHost and remotePort").ThrowAsJavaScriptException();
+    return;
+  }
+}
+
+SSHTunnel::~SSHTunnel() {
+  // A started tunnel pins its wrapper until stopped, so the reactor no
+  // longer references this object here
+  sessionRef_.Reset();
+}
+
+Napi::Value SSHTunnel::Start(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (started_) {
+    Napi::Error::New(env, "Tunnel is already started").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 1 || !info[0].IsFunction()) {
+    Napi::Error::New(env, "Expected event callback").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // libssh's own state is the reactor thread's to read
+  if (!sessionAlive_->load()) {
+    Napi::Error::New(env, "SSH session is not connected").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  std::string error;
+  listenFd_ = ListenTcp(localHost_, localPort_, kListenBacklog, error);
+  if (listenFd_ == SSH_INVALID_SOCKET) {
+    Napi::Error::New(env, "Failed to listen on " + localHost_ + ":" +
+                     std::to_string(localPort_) + ": " + error).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  localPort_ = GetLocalPort(listenFd_);
+
+  onEvent_ = Napi::Persistent(info[0].As<Napi::Function>());
+
+  // Pin the wrapper and keep the event loop alive while the reactor
+  // services the tunnel
+  Ref();
+  reactor_->Ref();
+  started_ = true;
+  running_ = true;
+  shutdown_ = false;
+
+  reactor_->Post([this]() {
+    ssh_event_add_fd(reactor_->event(), listenFd_, POLLIN, &SSHTunnel::OnListenReady, this);
+    reactor_->AddPoller(this);
+  });
+
+  return Napi::Number::New(env, localPort_);
+}
+
+Napi::Value SSHTunnel::Stop(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+  if (!started_) {
+    deferred.Resolve(env.Undefined());
+    return deferred.Promise();
+  }
+  started_ = false;
+
+  TunnelStopWorker* worker = new TunnelStopWorker(env, this, deferred);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+Napi::Value SSHTunnel::GetStats(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::Object stats = Napi::Object::New(env);
+  stats.Set("activeConnections", Napi::Number::New(env, static_cast<double>(activeConnections_.load())));
+  stats.Set("totalConnections", Napi::Number::New(env, static_cast<double>(totalConnections_.load())));
+  stats.Set("bytesSent", Napi::Number::New(env, static_cast<double>(bytesSent_.load())));
+  stats.Set("bytesReceived", Napi::Number::New(env, static_cast<double>(bytesReceived_.load())));
+  stats.Set("bufferedBytes", Napi::Number::New(env, static_cast<double>(bufferedBytes_.load())));
+  stats.Set("warmChannels", Napi::Number::New(env, warmChannels_.load()));
+  return stats;
+}
+
+Napi::Value SSHTunnel::GetConnections(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+
+  if (!started_) {
+    deferred.Resolve(Napi::Array::New(env));
+    return deferred.Promise();
+  }
+
+  TunnelConnectionsWorker* worker = new TunnelConnectionsWorker(env, this, deferred);
+  worker->Queue();
+
+  return deferred.Promise();
+}
+
+Napi::Value SSHTunnel::IsRunning(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  return Napi::Boolean::New(env, running_.load());
+}
+
+// Reactor thread
+
+bool SSHTunnel::Poll() {
+  if (shutdown_) {
+    return false;
+  }
+
+  if (!ssh_is_connected(session_)) {
+    running_ = false;
+    TunnelEvent* event = new TunnelEvent();
+    event->type = "error";
+    event->message = "SSH session disconnected";
+    Emit(event);
+    Shutdown();
+    return false;
+  }
+
+  if (acceptPending_) {
+    acceptPending_ = false;
+    AcceptConnections();
+  }
+
+  bool progress = prewarm_ > 0 && RefillWarmChannels();
+
+  for (auto& conn : connections_) {
+    if (PumpConnection(*conn)) {
+      progress = true;
+    }
+    if (!conn->closed) {
+      UpdateInterest(*conn);
+      UpdateBuffered(*conn);
+    }
+  }
+
+  connections_.erase(
+    std::remove_if(connections_.begin(), connections_.end(),
+                   [](const std::unique_ptr<Connection>& conn) { return conn->closed; }),
+    connections_.end());
+
+  // Reporting progress makes the reactor poll again without sleeping:
+  // libssh may hold buffered channel data that will not raise another
+  // socket event.
+  return progress;
+}
+
+void SSHTunnel::AcceptConnections() {
+  socket_t fd;
+  while ((fd = AcceptConnection(listenFd_)) != SSH_INVALID_SOCKET) {
+    std::unique_ptr<Connection> conn(new Connection());
+    conn->id = nextConnectionId_++;
+    conn->fd = fd;
+    GetPeerAddress(fd, conn->peerHost, conn->peerPort);
+
+    // Hand over a warm channel if one is ready; data can flow at once
+    auto warm = std::find_if(warm_.begin(), warm_.end(),
+                             [](const WarmChannel& w) { return w.open; });
+    if (warm != warm_.end()) {
+      conn->channel = warm->channel;
+      conn->open = true;
+      warm_.erase(warm);
+      warmChannels_.fetch_sub(1, std::memory_order_relaxed);
+
+      totalConnections_.fetch_add(1, std::memory_order_relaxed);
+      activeConnections_.fetch_add(1, std::memory_order_relaxed);
+      EmitConnection(*conn);
+      connections_.push_back(std::move(conn));
+      continue;
+    }
+
+    conn->channel = ssh_channel_new(session_);
+    if (conn->channel == nullptr) {
+      CloseSocket(fd);
+      TunnelEvent* event = new TunnelEvent();
+      event->type = "error";
+      event->id = conn->id;
+      event->message = "Failed to create channel";
+      Emit(event);
+      continue;
+    }
+
+    totalConnections_.fetch_add(1, std::memory_order_relaxed);
+    activeConnections_.fetch_add(1, std::memory_order_relaxed);
+    connections_.push_back(std::move(conn));
+  }
+}
+
+bool SSHTunnel::RefillWarmChannels() {
+  bool progress = false;
+
+  for (WarmChannel& warm : warm_) {
+    if (warm.open) {
+      // The server or the target may drop a channel while it waits
+      if (ssh_channel_is_closed(warm.channel) || ssh_channel_is_eof(warm.channel)) {
+        ssh_channel_free(warm.channel);
+        warm.channel = nullptr;
+        warmChannels_.fetch_sub(1, std::memory_order_relaxed);
+        sessionStats_->channelsOpen.fetch_sub(1, std::memory_order_relaxed);
+        progress = true;
+      }
+      continue;
+    }
+
+    // The originator address is not known yet, so report the loopback
+    int rc = ssh_channel_open_forward(warm.channel, remoteHost_.c_str(), remotePort_, "127.0.0.1", 0);
+    if (rc == SSH_AGAIN) {
+      continue;
+    }
+    if (rc != SSH_OK) {
+      ssh_channel_free(warm.channel);
+      warm.channel = nullptr;
+      warmRetryAt_ = std::chrono::steady_clock::now() + kWarmRetryDelay;
+    } else {
+      warm.open = true;
+      warmChannels_.fetch_add(1, std::memory_order_relaxed);
+      sessionStats_->channelsOpen.fetch_add(1, std::memory_order_relaxed);
+    }
+    progress = true;
+  }
+
+  warm_.erase(std::remove_if(warm_.begin(), warm_.end(),
+                             [](const WarmChannel& w) { return w.channel == nullptr; }),
+              warm_.end());
+
+  if (warm_.size() < prewarm_ && std::chrono::steady_clock::now() >= warmRetryAt_) {
+    while (warm_.size() < prewarm_) {
+      WarmChannel warm;
+      warm.channel = ssh_channel_new(session_);
+      if (warm.channel == nullptr) {
+        break;
+      }
+      warm_.push_back(warm);
+      progress = true;
+    }
+  }
+
+  return progress;
+}
+
+void SSHTunnel::EmitConnection(const Connection& conn) {
+  TunnelEvent* event = new TunnelEvent();
+  event->type = "connection";
+  event->id = conn.id;
+  event->address = conn.peerHost;
+  event->port = conn.peerPort;
+  Emit(event);
+}
+
+bool SSHTunnel::PumpConnection(Connection& conn) {
+  if (!conn.open) {
+    int rc = ssh_channel_open_forward(conn.channel,
+                                      remoteHost_.c_str(), remotePort_,
+                                      conn.peerHost.empty() ? "127.0.0.1" : conn.peerHost.c_str(),
+                                      conn.peerPort);
+    if (rc == SSH_AGAIN) {
+      return false;
+    }
+    if (rc != SSH_OK) {
+      CloseConnection(conn, std::string("Failed to open forward channel: ") + ssh_get_error(session_));
+      return true;
+    }
+
+    conn.open = true;
+    sessionStats_->channelsOpen.fetch_add(1, std::memory_order_relaxed);
+    EmitConnection(conn);
+  }
+
+  bool progress = PumpToLocal(conn);
+  if (!conn.closed && PumpToRemote(conn)) {
+    progress = true;
+  }
+  if (conn.closed) {
+    return true;
+  }
+
+  bool drained = conn.toLocal.empty() && conn.toRemote.empty();
+  bool remoteGone = conn.remoteEof && (conn.localEof || ssh_channel_is_closed(conn.channel));
+  if (drained && remoteGone) {
+    CloseConnection(conn, "");
+    return true;
+  }
+
+  return progress;
+}
+
+bool SSHTunnel::PumpToLocal(Connection& conn) {
+  bool progress = false;
+  char buffer[kChunkSize];
+
+  for (int chunk = 0; chunk < kMaxChunksPerPump; chunk++) {
+    // Flush what the client refused last time before pulling more
+    while (conn.toLocalOffset < conn.toLocal.size()) {
+      int sent = send(conn.fd, conn.toLocal.data() + conn.toLocalOffset,
+                      static_cast<int>(conn.toLocal.size() - conn.toLocalOffset), 0);
+      if (sent < 0) {
+        if (SocketWouldBlock()) {
+          return progress;
+        }
+        CloseConnection(conn, SocketErrorString());
+        return true;
+      }
+      conn.toLocalOffset += sent;
+      progress = true;
+    }
+    conn.toLocal.clear();
+    conn.toLocalOffset = 0;
+
+    if (conn.remoteEof) {
+      break;
+    }
+
+    int bytesRead = ssh_channel_read_nonblocking(conn.channel, buffer, sizeof(buffer), 0);
+    if (bytesRead == SSH_EOF || (bytesRead == 0 && ssh_channel_is_eof(conn.channel))) {
+      conn.remoteEof = true;
+      progress = true;
+      break;
+    }
+    if (bytesRead < 0) {
+      CloseConnection(conn, std::string("Failed to read from channel: ") + ssh_get_error(session_));
+      return true;
+    }
+    if (bytesRead == 0) {
+      break;
+    }
+
+    conn.bytesReceived += bytesRead;
+    bytesReceived_.fetch_add(bytesRead, std::memory_order_relaxed);
+    progress = true;
+
+    int sent = send(conn.fd, buffer, bytesRead, 0);
+    if (sent < 0) {
+      if (!SocketWouldBlock()) {
+        CloseConnection(conn, SocketErrorString());
+        return true;
+      }
+      sent = 0;
+    }
+    if (sent < bytesRead) {
+      conn.toLocal.assign(buffer + sent, buffer + bytesRead);
+      return progress;
+    }
+  }
+
+  if (conn.remoteEof && conn.toLocal.empty() && !conn.localShutdown) {
+    ShutdownWrite(conn.fd);
+    conn.localShutdown = true;
+  }
+
+  return progress;
+}
+
+bool SSHTunnel::PumpToRemote(Connection& conn) {
+  bool progress = false;
+  char buffer[kChunkSize];
+
+  for (int chunk = 0; chunk < kMaxChunksPerPump; chunk++) {
+    // Only ever hand libssh as much as the remote window allows so that
+    // ssh_channel_write never has to wait for a window adjust.
+    uint32_t window = ssh_channel_window_size(conn.channel);
+
+    if (conn.toRemoteOffset < conn.toRemote.size()) {
+      if (window == 0) {
+        return progress;
+      }
+      uint32_t pending = static_cast<uint32_t>(conn.toRemote.size() - conn.toRemoteOffset);
+      int written = ssh_channel_write(conn.channel, conn.toRemote.data() + conn.toRemoteOffset,
+                                      std::min(window, pending));
+      if (written == SSH_ERROR) {
+        CloseConnection(conn, std::string("Failed to write to channel: ") + ssh_get_error(session_));
+        return true;
+      }
+      conn.toRemoteOffset += written;
+      conn.bytesSent += written;
+      bytesSent_.fetch_add(written, std::memory_order_relaxed);
+      progress = progress || written > 0;
+      if (conn.toRemoteOffset < conn.toRemote.size()) {
+        return progress;
+      }
+      conn.toRemote.clear();
+      conn.toRemoteOffset = 0;
+      window = ssh_channel_window_size(conn.channel);
+    }
+
+    if (conn.localEof || window == 0) {
+      break;
+    }
+
+    int bytesRead = recv(conn.fd, buffer, static_cast<int>(std::min<size_t>(window, sizeof(buffer))), 0);
+    if (bytesRead == 0) {
+      conn.localEof = true;
+      ssh_channel_send_eof(conn.channel);
+      progress = true;
+      break;
+    }
+    if (bytesRead < 0) {
+      if (SocketWouldBlock()) {
+        break;
+      }
+      CloseConnection(conn, SocketErrorString());
+      return true;
+    }
+
+    progress = true;
+    int written = ssh_channel_write(conn.channel, buffer, bytesRead);
+    if (written == SSH_ERROR) {
+      CloseConnection(conn, std::string("Failed to write to channel: ") + ssh_get_error(session_));
+      return true;
+    }
+    conn.bytesSent += written;
+    bytesSent_.fetch_add(written, std::memory_order_relaxed);
+    if (written < bytesRead) {
+      conn.toRemote.assign(buffer + written, buffer + bytesRead);
+      break;
+    }
+  }
+
+  return progress;
+}
+
+void SSHTunnel::UpdateInterest(Connection& conn) {
+  short events = 0;
+  if (conn.open) {
+    if (!conn.localEof && conn.toRemote.empty() && ssh_channel_window_size(conn.channel) > 0) {
+      events |= POLLIN;
+    }
+    if (!conn.toLocal.empty()) {
+      events |= POLLOUT;
+    }
+  }
+
+  if (events == conn.events) {
+    return;
+  }
+
+  if (conn.events != 0) {
+    ssh_event_remove_fd(reactor_->event(), conn.fd);
+  }
+  if (events != 0) {
+    ssh_event_add_fd(reactor_->event(), conn.fd, events, &SSHTunnel::OnSocketReady, this);
+  }
+  conn.events = events;
+}
+
+void SSHTunnel::UpdateBuffered(Connection& conn) {
+  size_t buffered = (conn.toLocal.size() - conn.toLocalOffset) +
+                    (conn.toRemote.size() - conn.toRemoteOffset);
+  if (buffered > conn.buffered) {
+    bufferedBytes_.fetch_add(buffered - conn.buffered, std::memory_order_relaxed);
+  } else {
+    bufferedBytes_.fetch_sub(conn.buffered - buffered, std::memory_order_relaxed);
+  }
+  conn.buffered = buffered;
+}
+
+void SSHTunnel::CloseConnection(Connection& conn, const std::string& error) {
+  if (conn.closed) {
+    return;
+  }
+  conn.closed = true;
+
+  bufferedBytes_.fetch_sub(conn.buffered, std::memory_order_relaxed);
+  conn.buffered = 0;
+
+  if (conn.events != 0) {
+    ssh_event_remove_fd(reactor_->event(), conn.fd);
+    conn.events = 0;
+  }
+  CloseSocket(conn.fd);
+  conn.fd = SSH_INVALID_SOCKET;
+
+  if (conn.channel != nullptr) {
+    if (conn.open && !ssh_channel_is_closed(conn.channel)) {
+      ssh_channel_close(conn.channel);
+    }
+    ssh_channel_free(conn.channel);
+    conn.channel = nullptr;
+    if (conn.open) {
+      sessionStats_->channelsOpen.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  activeConnections_.fetch_sub(1, std::memory_order_relaxed);
+
+  TunnelEvent* event = new TunnelEvent();
+  event->type = "close";
+  event->id = conn.id;
+  event->bytesSent = conn.bytesSent;
+  event->bytesReceived = conn.bytesReceived;
+  event->message = error;
+  Emit(event);
+}
+
+void SSHTunnel::Emit(TunnelEvent* event) {
+  reactor_->CallJs([this, event](Napi::Env env) {
+    if (!onEvent_.IsEmpty()) {
+      Napi::Object obj = Napi::Object::New(env);
+      obj.Set("type", event->type);
+      obj.Set("id", Napi::Number::New(env, event->id));
+      if (event->type == "connection") {
+        obj.Set("address", event->address);
+        obj.Set("port", Napi::Number::New(env, event->port));
+      } else if (event->type == "close") {
+        obj.Set("bytesSent", Napi::Number::New(env, static_cast<double>(event->bytesSent)));
+        obj.Set("bytesReceived", Napi::Number::New(env, static_cast<double>(event->bytesReceived)));
+      }
+      if (!event->message.empty()) {
+        obj.Set("message", event->message);
+      }
+      onEvent_.Call({obj});
+    }
+    delete event;
+  });
+}
+
+void SSHTunnel::Shutdown() {
+  if (shutdown_) {
+    return;
+  }
+  shutdown_ = true;
+
+  for (auto& conn : connections_) {
+    CloseConnection(*conn, "");
+  }
+  connections_.clear();
+
+  for (WarmChannel& warm : warm_) {
+    if (warm.open && !ssh_channel_is_closed(warm.channel)) {
+      ssh_channel_close(warm.channel);
+    }
+    if (warm.open) {
+      sessionStats_->channelsOpen.fetch_sub(1, std::memory_order_relaxed);
+    }
+    ssh_channel_free(warm.channel);
+  }
+  warm_.clear();
+  warmChannels_ = 0;
+
+  ssh_event_remove_fd(reactor_->event(), listenFd_);
+  CloseSocket(listenFd_);
+  listenFd_ = SSH_INVALID_SOCKET;
+
+  reactor_->RemovePoller(this);
+  running_ = false;
+}
+
+int SSHTunnel::OnListenReady(socket_t fd, int revents, void* userdata) {
+  // Callbacks can fire from inside any libssh call that polls, including
+  // the ones made while iterating connections_; accept on the next Poll()
+  static_cast<SSHTunnel*>(userdata)->acceptPending_ = true;
+  return 0;
+}
+
+int SSHTunnel::OnSocketReady(socket_t fd, int revents, void* userdata) {
+  // Readiness only wakes the loop; the pump pass does the actual I/O
+  return 0;
+}
+
+// TunnelStopWorker
+TunnelStopWorker::TunnelStopWorker(Napi::Env env, SSHTunnel* tunnel, const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, tunnel->Value()), tunnel_(tunnel), deferred_(deferred) {}
+
+int TunnelStopWorker::Execute() {
+  tunnel_->Shutdown();
+  return SSH_OK;
+}
+
+void TunnelStopWorker::OnOK() {
+  tunnel_->onEvent_.Reset();
+  tunnel_->reactor_->Unref();
+  tunnel_->Unref();
+  deferred_.Resolve(Env().Undefined());
+}
+
+void TunnelStopWorker::OnError(const Napi::Error& error) {
+  tunnel_->onEvent_.Reset();
+  tunnel_->reactor_->Unref();
+  tunnel_->Unref();
+  deferred_.Reject(error.Value());
+}
+
+// TunnelConnectionsWorker
+TunnelConnectionsWorker::TunnelConnectionsWorker(Napi::Env env, SSHTunnel* tunnel,
+                                                 const Napi::Promise::Deferred& deferred)
+    : ReactorWorker(env, tunnel->Value()), tunnel_(tunnel), deferred_(deferred) {}
+
+int TunnelConnectionsWorker::Execute() {
+  for (const auto& conn : tunnel_->connections_) {
+    if (conn->closed) {
+      continue;
+    }
+
+    Snapshot snapshot;
+    snapshot.id = conn->id;
+    snapshot.address = conn->peerHost;
+    snapshot.port = conn->peerPort;
+    snapshot.open = conn->open;
+    snapshot.bytesSent = conn->bytesSent;
+    snapshot.bytesReceived = conn->bytesReceived;
+    snapshot.bufferedToLocal = conn->toLocal.size() - conn->toLocalOffset;
+    snapshot.bufferedToRemote = conn->toRemote.size() - conn->toRemoteOffset;
+    // Received from the server but not yet pulled by the pump
+    int pending = conn->open ? ssh_channel_poll(conn->channel, 0) : 0;
+    snapshot.channelBuffered = pending > 0 ? static_cast<size_t>(pending) : 0;
+    snapshot.remoteWindow = conn->open ? ssh_channel_window_size(conn->channel) : 0;
+    connections_.push_back(snapshot);
+  }
+  return SSH_OK;
+}
+
+void TunnelConnectionsWorker::OnOK() {
+  Napi::Env env = Env();
+  Napi::Array result = Napi::Array::New(env, connections_.size());
+  for (size_t i = 0; i < connections_.size(); i++) {
+    const Snapshot& snapshot = connections_[i];
+    Napi::Object conn = Napi::Object::New(env);
+    conn.Set("id", Napi::Number::New(env, snapshot.id));
+    conn.Set("address", snapshot.address);
+    conn.Set("port", Napi::Number::New(env, snapshot.port));
+    conn.Set("open", Napi::Boolean::New(env, snapshot.open));
+    conn.Set("bytesSent", Napi::Number::New(env, static_cast<double>(snapshot.bytesSent)));
+    conn.Set("bytesReceived", Napi::Number::New(env, static_cast<double>(snapshot.bytesReceived)));
+    conn.Set("bufferedToLocal", Napi::Number::New(env, static_cast<double>(snapshot.bufferedToLocal)));
+    conn.Set("bufferedToRemote", Napi::Number::New(env, static_cast<double>(snapshot.bufferedToRemote)));
+    conn.Set("channelBuffered", Napi::Number::New(env, static_cast<double>(snapshot.channelBuffered)));
+    conn.Set("remoteWindow", Napi::Number::New(env, snapshot.remoteWindow));
+    result.Set(static_cast<uint32_t>(i), conn);
+  }
+  deferred_.Resolve(result);
+}
+
+void TunnelConnectionsWorker::OnError(const Napi::Error& error) {
+  deferred_.Reject(error.Value());
+}
+
+} // namespace libssh_node
@@ -0,0 +1,132 @@
+#ifndef LIBSSH_NODE_SSH_TUNNEL_H
+#define LIBSSH_NODE_SSH_TUNNEL_H
+
+#include <napi.h>
+#include <libssh/libssh.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "reactor.h"
+
+namespace libssh_node {
+
+// Native local port forwarder. Owns the listening socket and every accepted
+// connection, and pumps bytes between the local sockets and direct-tcpip
+// channels on the reactor thread. Only lifecycle events and counters reach JS.
+class SSHTunnel : public Napi::ObjectWrap<SSHTunnel>, public ReactorPoller {
+public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+  explicit SSHTunnel(const Napi::CallbackInfo& info);
+  ~SSHTunnel();
+
+private:
+  struct Connection;
+  struct TunnelEvent;
+  struct WarmChannel;
+
+  // Tunnel methods
+  Napi::Value Start(const Napi::CallbackInfo& info);
+  Napi::Value Stop(const Napi::CallbackInfo& info);
+  Napi::Value GetStats(const Napi::CallbackInfo& info);
+  Napi::Value GetConnections(const Napi::CallbackInfo& info);
+  Napi::Value IsRunning(const Napi::CallbackInfo& info);
+
+  // Reactor thread
+  bool Poll() override;
+  void AcceptConnections();
+  bool RefillWarmChannels();
+  void EmitConnection(const Connection& conn);
+  bool PumpConnection(Connection& conn);
+  bool PumpToLocal(Connection& conn);
+  bool PumpToRemote(Connection& conn);
+  void UpdateInterest(Connection& conn);
+  void UpdateBuffered(Connection& conn);
+  void CloseConnection(Connection& conn, const std::string& error);
+  void Emit(TunnelEvent* event);
+  void Shutdown();
+
+  static int OnListenReady(socket_t fd, int revents, void* userdata);
+  static int OnSocketReady(socket_t fd, int revents, void* userdata);
+
+  ssh_session session_;
+  Napi::ObjectReference sessionRef_; // Keep session alive
+  std::shared_ptr<std::atomic<bool>> sessionAlive_; // The session's, kept by the reactor
+  std::shared_ptr<SessionStats> sessionStats_;      // Open channels count into channelsOpen
+
+  std::string localHost_;
+  int localPort_;
+  std::string remoteHost_;
+  int remotePort_;
+  size_t prewarm_; // Forward channels to keep open ahead of accept()
+
+  std::shared_ptr<Reactor> reactor_;
+  Napi::FunctionReference onEvent_;
+  bool started_; // JS thread
+  std::atomic<bool> running_;
+
+  // Reactor thread
+  socket_t listenFd_;
+  bool acceptPending_;
+  bool shutdown_;
+  std::vector<std::unique_ptr<Connection>> connections_;
+  uint32_t nextConnectionId_;
+  std::vector<WarmChannel> warm_;
+  std::chrono::steady_clock::time_point warmRetryAt_;
+
+  // Counters, read from JS while the reactor thread updates them
+  std::atomic<uint64_t> totalConnections_;
+  std::atomic<uint64_t> activeConnections_;
+  std::atomic<uint64_t> bytesSent_;
+  std::atomic<uint64_t> bytesReceived_;
+  std::atomic<uint64_t> bufferedBytes_; // Held in tunnel buffers, both directions
+  std::atomic<uint32_t> warmChannels_;  // Open and waiting for a connection
+
+  friend class TunnelStopWorker;
+  friend class TunnelConnectionsWorker;
+};
+
+// Tears the tunnel down on the reactor thread
+class TunnelStopWorker : public ReactorWorker {
+public:
+  TunnelStopWorker(Napi::Env env, SSHTunnel* tunnel, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  SSHTunnel* tunnel_;
+  Napi::Promise::Deferred deferred_;
+};
+
+// Snapshots per-connection gauges on the reactor thread
+class TunnelConnectionsWorker : public ReactorWorker {
+public:
+  TunnelConnectionsWorker(Napi::Env env, SSHTunnel* tunnel, const Napi::Promise::Deferred& deferred);
+  int Execute() override;
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  struct Snapshot {
+    uint32_t id;
+    std::string address;
+    int port;
+    bool open;
+    uint64_t bytesSent;
+    uint64_t bytesReceived;
+    size_t bufferedToLocal;
+    size_t bufferedToRemote;
+    size_t channelBuffered;
+    uint32_t remoteWindow;
+  };
+
+  SSHTunnel* tunnel_;
+  Napi::Promise::Deferred deferred_;
+  std::vector<Snapshot> connections_;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_SSH_TUNNEL_H
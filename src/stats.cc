@@ -0,0 +1,122 @@
+#include "stats.h"
+#include <algorithm>
+
+namespace libssh_node {
+
+namespace {
+
+constexpr auto kRelaxed = std::memory_order_relaxed;
+
+double Load(const std::atomic<uint64_t>& counter) {
+  return static_cast<double>(counter.load(kRelaxed));
+}
+
+} // namespace
+
+// LatencyHistogram
+void LatencyHistogram::Record(std::chrono::steady_clock::duration elapsed) {
+  uint64_t us = static_cast<uint64_t>(
+    std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), 0));
+
+  size_t bucket = 0;
+  while (bucket < kBuckets - 1 && (us >> bucket) != 0) {
+    bucket++;
+  }
+
+  count_.fetch_add(1, kRelaxed);
+  totalUs_.fetch_add(us, kRelaxed);
+  buckets_[bucket].fetch_add(1, kRelaxed);
+
+  // Only the reactor thread records, so a plain compare is enough
+  if (us > maxUs_.load(kRelaxed)) {
+    maxUs_.store(us, kRelaxed);
+  }
+}
+
+Napi::Object LatencyHistogram::ToObject(Napi::Env env) const {
+  Napi::Object histogram = Napi::Object::New(env);
+  histogram.Set("count", Load(count_));
+  histogram.Set("totalUs", Load(totalUs_));
+  histogram.Set("maxUs", Load(maxUs_));
+
+  Napi::Array buckets = Napi::Array::New(env, kBuckets);
+  for (size_t i = 0; i < kBuckets; i++) {
+    buckets.Set(static_cast<uint32_t>(i), Load(buckets_[i]));
+  }
+  histogram.Set("buckets", buckets);
+  return histogram;
+}
+
+// OperationStatsMap
+OperationStats* OperationStatsMap::Get(const std::string& name) {
+  std::unique_ptr<OperationStats>& stats = operations_[name];
+  if (!stats) {
+    stats = std::make_unique<OperationStats>();
+  }
+  return stats.get();
+}
+
+Napi::Object OperationStatsMap::ToObject(Napi::Env env) const {
+  Napi::Object operations = Napi::Object::New(env);
+  for (const auto& entry : operations_) {
+    Napi::Object operation = Napi::Object::New(env);
+    operation.Set("queueWait", entry.second->queueWait.ToObject(env));
+    operation.Set("execute", entry.second->execute.ToObject(env));
+    operations.Set(entry.first, operation);
+  }
+  return operations;
+}
+
+// ConnectTimings
+Napi::Object ConnectTimings::ToObject(Napi::Env env) const {
+  auto phase = [env](double ms) -> Napi::Value {
+    return ms < 0 ? env.Null() : Napi::Number::New(env, ms);
+  };
+
+  Napi::Object timings = Napi::Object::New(env);
+  timings.Set("resolveMs", phase(resolveMs));
+  timings.Set("tcpMs", phase(tcpMs));
+  timings.Set("handshakeMs", phase(handshakeMs));
+  timings.Set("authMs", phase(authMs));
+  timings.Set("address", address.empty() ? env.Null() : Napi::String::New(env, address));
+  timings.Set("attempts", attempts);
+  return timings;
+}
+
+// IoCounters
+void IoCounters::CountRead(size_t bytes) {
+  for (IoCounters* counters = this; counters != nullptr; counters = counters->parent) {
+    counters->bytesRead.fetch_add(bytes, kRelaxed);
+    counters->reads.fetch_add(1, kRelaxed);
+  }
+}
+
+void IoCounters::CountWrite(size_t bytes) {
+  for (IoCounters* counters = this; counters != nullptr; counters = counters->parent) {
+    counters->bytesWritten.fetch_add(bytes, kRelaxed);
+    counters->writes.fetch_add(1, kRelaxed);
+  }
+}
+
+void IoCounters::CountWindowStall() {
+  for (IoCounters* counters = this; counters != nullptr; counters = counters->parent) {
+    counters->windowStalls.fetch_add(1, kRelaxed);
+  }
+}
+
+void IoCounters::AddBuffered(int64_t bytes) {
+  for (IoCounters* counters = this; counters != nullptr; counters = counters->parent) {
+    counters->bufferedBytes.fetch_add(bytes, kRelaxed);
+  }
+}
+
+void IoCounters::AddTo(Napi::Object stats) const {
+  stats.Set("bytesRead", Load(bytesRead));
+  stats.Set("bytesWritten", Load(bytesWritten));
+  stats.Set("reads", Load(reads));
+  stats.Set("writes", Load(writes));
+  stats.Set("windowStalls", Load(windowStalls));
+  stats.Set("bufferedBytes", static_cast<double>(bufferedBytes.load(kRelaxed)));
+}
+
+} // namespace libssh_node
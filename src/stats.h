@@ -0,0 +1,102 @@
+#ifndef LIBSSH_NODE_STATS_H
+#define LIBSSH_NODE_STATS_H
+
+#include <napi.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace libssh_node {
+
+// Durations in power-of-two microsecond buckets. Recorded on the reactor
+// thread and read from JS without locking; every field is a plain
+// counter, so relaxed atomics are enough.
+class LatencyHistogram {
+public:
+  static constexpr size_t kBuckets = 32; // Bucket i counts durations under 2^i us
+
+  void Record(std::chrono::steady_clock::duration elapsed);
+
+  // { count, totalUs, maxUs, buckets }
+  Napi::Object ToObject(Napi::Env env) const;
+
+private:
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> totalUs_{0};
+  std::atomic<uint64_t> maxUs_{0};
+  std::atomic<uint64_t> buckets_[kBuckets]{};
+};
+
+// Timings for one kind of reactor operation: how long it waited for the
+// reactor thread, and how long it took from its first step to completion
+struct OperationStats {
+  LatencyHistogram queueWait;
+  LatencyHistogram execute;
+};
+
+// Operation timings by name. Entries are created on the JS thread and
+// never removed, so workers can hold a pointer to theirs.
+class OperationStatsMap {
+public:
+  OperationStats* Get(const std::string& name); // JS thread
+  Napi::Object ToObject(Napi::Env env) const;   // JS thread
+
+private:
+  std::map<std::string, std::unique_ptr<OperationStats>> operations_;
+};
+
+// Data moved through channels. Counting into one set of counters also
+// counts into its parent, so a channel's traffic shows up in its
+// session's totals.
+struct IoCounters {
+  explicit IoCounters(IoCounters* parent = nullptr) : parent(parent) {}
+
+  void CountRead(size_t bytes);
+  void CountWrite(size_t bytes);
+  void CountWindowStall();
+  void AddBuffered(int64_t bytes);
+
+  // Sets bytesRead, bytesWritten, reads, writes, windowStalls, bufferedBytes
+  void AddTo(Napi::Object stats) const;
+
+  IoCounters* parent;
+  std::atomic<uint64_t> bytesRead{0};
+  std::atomic<uint64_t> bytesWritten{0};
+  std::atomic<uint64_t> reads{0};
+  std::atomic<uint64_t> writes{0};
+  std::atomic<uint64_t> windowStalls{0}; // Writes held back by an empty remote window
+  std::atomic<int64_t> bufferedBytes{0}; // Accepted from JS, not yet sent
+};
+
+// Phases of the last connect and authentication, in milliseconds; -1
+// for a phase that has not run. Written and read on the JS thread.
+struct ConnectTimings {
+  double resolveMs = -1;
+  double tcpMs = -1;     // Happy-eyeballs race, or -1 when libssh connected
+  double handshakeMs = -1;
+  double authMs = -1;
+  std::string address;   // Address the race connected to
+  int attempts = 0;
+
+  // { resolveMs, tcpMs, handshakeMs, authMs, address, attempts }, with
+  // null for phases that have not run
+  Napi::Object ToObject(Napi::Env env) const;
+};
+
+// Shared by a session and the channels and SFTP sessions opened on it
+struct SessionStats {
+  IoCounters io;
+  std::atomic<uint64_t> channelsOpened{0};
+  std::atomic<uint64_t> channelOpenFailures{0};
+  // Channels open right now, whichever API opened them; servers refuse
+  // more than MaxSessions per connection
+  std::atomic<int64_t> channelsOpen{0};
+  OperationStatsMap operations;
+};
+
+} // namespace libssh_node
+
+#endif // LIBSSH_NODE_STATS_H
@@ -0,0 +1,206 @@
+jest.mock('../build/Release/libssh_node.node', () => ({}), { virtual: true });
+
+import { SSHChannel } from '../lib/channel';
+
+type StreamEvent = { type: string; data?: Buffer; lines?: string[]; code?: number };
+
+function createNativeChannel() {
+  const events: { onEvent: ((event: StreamEvent) => void) | null } = { onEvent: null };
+  const native = {
+    get onEvent() { return events.onEvent; },
+    startStream: jest.fn((cb: (event: StreamEvent) => void, _options?: unknown) => { events.onEvent = cb; }),
+    readStart: jest.fn(),
+    readStop: jest.fn(),
+    write: jest.fn((data: Buffer) => Promise.resolve(data.length)),
+    writev: jest.fn((buffers: Buffer[]) => Promise.resolve(buffers.length)),
+    getWriteQueueSize: jest.fn(() => 0),
+    sendEof: jest.fn(() => Promise.resolve()),
+    close: jest.fn(() => Promise.resolve())
+  };
+  return native;
+}
+
+describe('SSHChannel', () => {
+  it('should pass readInto arguments through to the native channel', async () => {
+    const native = { readInto: jest.fn(() => Promise.resolve(3)) };
+    const channel = new SSHChannel(native);
+    const target = Buffer.alloc(16);
+
+    await expect(channel.readInto(target, 4, 8)).resolves.toBe(3);
+    expect(native.readInto).toHaveBeenCalledWith(target, 4, 8, undefined);
+  });
+
+  it('should pass cancellation options through to the native channel', async () => {
+    const native = {
+      read: jest.fn(() => Promise.resolve(Buffer.alloc(0))),
+      write: jest.fn(() => Promise.resolve(1)),
+      openSession: jest.fn(() => Promise.resolve()),
+      requestForwardTcpIp: jest.fn(() => Promise.resolve())
+    };
+    const channel = new SSHChannel(native);
+    const signal = new AbortController().signal;
+
+    await channel.openSession({ timeoutMs: 500 });
+    await channel.read(1024, { signal });
+    await channel.write(Buffer.from('x'), { signal, timeoutMs: 50 });
+    await channel.requestForwardTcpIp('db', 5432, undefined, undefined, { signal });
+
+    expect(native.openSession).toHaveBeenCalledWith({ timeoutMs: 500 });
+    expect(native.read).toHaveBeenCalledWith(1024, { signal });
+    expect(native.write).toHaveBeenCalledWith(Buffer.from('x'), { signal, timeoutMs: 50 });
+    expect(native.requestForwardTcpIp).toHaveBeenCalledWith('db', 5432, undefined, undefined, { signal });
+  });
+
+  it('should return the native channel counters', () => {
+    const counters = { bytesRead: 5, bytesWritten: 0, reads: 1, writes: 0, windowStalls: 0, bufferedBytes: 0 };
+    const native = { getStats: jest.fn(() => counters) };
+
+    expect(new SSHChannel(native).getStats()).toBe(counters);
+  });
+
+  it('should pass exec options and choose temp files for file capture', async () => {
+    const result = { command: 'make', exitCode: 0, signal: null };
+    const native = { exec: jest.fn(() => Promise.resolve(result)) };
+    const channel = new SSHChannel(native);
+
+    await expect(channel.exec('make', { timeoutMs: 100, capture: { mode: 'tail', maxBytes: 64 } }))
+      .resolves.toBe(result);
+    expect(native.exec).toHaveBeenCalledWith('make', {
+      timeoutMs: 100, signal: undefined, capture: { mode: 'tail', maxBytes: 64 }
+    });
+
+    await channel.exec('make', { capture: { mode: 'file', directory: '/var/tmp' } });
+    const capture = (native.exec.mock.calls[1] as unknown[])[1] as { capture: Record<string, string> };
+    expect(capture.capture.mode).toBe('file');
+    expect(capture.capture.stdoutPath).toMatch(/^\/var\/tmp\/libssh-node-exec-.*\.stdout$/);
+    expect(capture.capture.stderrPath).toMatch(/\.stderr$/);
+  });
+});
+
+describe('SSHChannelStream', () => {
+  it('should pause native reads when the readable side is full', async () => {
+    const native = createNativeChannel();
+    const stream = new SSHChannel(native).createStream({ highWaterMark: 4 });
+
+    expect(native.startStream).toHaveBeenCalledTimes(1);
+    stream.read(0);
+    expect(native.readStart).toHaveBeenCalledTimes(1);
+
+    native.onEvent!({ type: 'data', data: Buffer.from('hello') });
+    expect(native.readStop).toHaveBeenCalledTimes(1);
+
+    expect(stream.read()?.toString()).toBe('hello');
+    await new Promise(resolve => setImmediate(resolve));
+    expect(native.readStart).toHaveBeenCalledTimes(2);
+  });
+
+  it('should route stderr and report the exit code', async () => {
+    const native = createNativeChannel();
+    const stream = new SSHChannel(native).createStream();
+    const stdout: string[] = [];
+    const stderr: string[] = [];
+    const exit = jest.fn();
+
+    stream.on('data', chunk => stdout.push(chunk.toString()));
+    stream.stderr.on('data', chunk => stderr.push(chunk.toString()));
+    stream.on('exit', exit);
+    const closed = new Promise(resolve => stream.on('close', resolve));
+
+    native.onEvent!({ type: 'data', data: Buffer.from('out') });
+    native.onEvent!({ type: 'stderr', data: Buffer.from('err') });
+    native.onEvent!({ type: 'eof' });
+    native.onEvent!({ type: 'exit', code: 2 });
+    native.onEvent!({ type: 'close' });
+    await closed;
+
+    expect(stdout).toEqual(['out']);
+    expect(stderr).toEqual(['err']);
+    expect(exit).toHaveBeenCalledWith(2);
+    expect(stream.exitCode).toBe(2);
+    expect(native.close).not.toHaveBeenCalled();
+  });
+
+  it('should write through the channel and send EOF on end', async () => {
+    const native = createNativeChannel();
+    const stream = new SSHChannel(native).createStream();
+
+    const finished = new Promise(resolve => stream.on('finish', resolve));
+    stream.write(Buffer.from('abc'));
+    stream.end();
+    await finished;
+
+    expect(native.write).toHaveBeenCalledWith(Buffer.from('abc'));
+    expect(native.sendEof).toHaveBeenCalledTimes(1);
+  });
+
+  it('should batch corked writes into one writev call', async () => {
+    const native = createNativeChannel();
+    const stream = new SSHChannel(native).createStream();
+
+    stream.cork();
+    stream.write(Buffer.from('a'));
+    stream.write(Buffer.from('b'));
+    const flushed = new Promise(resolve => stream.write(Buffer.from('c'), resolve));
+    stream.uncork();
+    await flushed;
+
+    expect(native.writev).toHaveBeenCalledWith([Buffer.from('a'), Buffer.from('b'), Buffer.from('c')]);
+    expect(native.write).not.toHaveBeenCalled();
+  });
+
+  it('should wait for the native write when the queue is above the high-water mark', async () => {
+    const native = createNativeChannel();
+    const stream = new SSHChannel(native).createStream({ highWaterMark: 8 });
+    let finishWrite: (bytes: number) => void = () => undefined;
+    native.write.mockImplementation(() => new Promise<number>(resolve => { finishWrite = resolve; }));
+
+    const done = jest.fn();
+    native.getWriteQueueSize.mockReturnValue(4);
+    stream.write(Buffer.from('abcd'), done);
+    await new Promise(resolve => setImmediate(resolve));
+    expect(done).toHaveBeenCalledTimes(1);
+
+    const blocked = jest.fn();
+    native.getWriteQueueSize.mockReturnValue(16);
+    stream.write(Buffer.from('efgh'), blocked);
+    await new Promise(resolve => setImmediate(resolve));
+    expect(blocked).not.toHaveBeenCalled();
+
+    finishWrite(4);
+    await new Promise(resolve => setImmediate(resolve));
+    expect(blocked).toHaveBeenCalledTimes(1);
+  });
+
+  it('should ask for native line framing and deliver batches', async () => {
+    const native = createNativeChannel();
+    const stream = new SSHChannel(native).createLineStream({ maxBatch: 100, flushMs: 10 });
+    const batches: string[][] = [];
+    const errors: string[][] = [];
+
+    expect(native.startStream.mock.calls[0][1]).toEqual({
+      lines: { maxBatch: 100, flushMs: 10, maxLineLength: undefined }
+    });
+    stream.on('data', batch => batches.push(batch));
+    stream.stderr.on('data', batch => errors.push(batch));
+    const ended = new Promise(resolve => stream.on('end', resolve));
+
+    native.onEvent!({ type: 'lines', lines: ['a', 'b'] });
+    native.onEvent!({ type: 'stderrLines', lines: ['oops'] });
+    native.onEvent!({ type: 'eof' });
+    await ended;
+
+    expect(batches).toEqual([['a', 'b']]);
+    expect(errors).toEqual([['oops']]);
+  });
+
+  it('should close the native channel when destroyed', async () => {
+    const native = createNativeChannel();
+    const stream = new SSHChannel(native).createStream();
+
+    const closed = new Promise(resolve => stream.on('close', resolve));
+    stream.destroy();
+    await closed;
+
+    expect(native.close).toHaveBeenCalledTimes(1);
+  });
+});
@@ -1,3 +1,6 @@
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
 import { SSHConfigParser } from '../lib/config';
 
 describe('SSHConfigParser', () => {
@@ -85,5 +88,68 @@ Host *.example.com
       // For now, just verify content parsing works
       expect(hosts).toHaveLength(1);
     });
+
+    describe('from a file', () => {
+      let dir: string;
+      let configPath: string;
+
+      beforeEach(() => {
+        dir = fs.mkdtempSync(path.join(os.tmpdir(), 'ssh-config-'));
+        configPath = path.join(dir, 'config');
+      });
+
+      afterEach(() => {
+        fs.rmSync(dir, { recursive: true, force: true });
+      });
+
+      it('should merge every matching block, first value winning', () => {
+        fs.writeFileSync(configPath, `
+Host web1 web2
+  User deploy
+  IdentityFile /keys/web
+Host *.example.com web*
+  User nobody
+  Port 2222
+  IdentityFile /keys/default
+`);
+
+        const config = SSHConfigParser.findHostConfig('web1', configPath);
+        expect(config).toMatchObject({ host: 'web1', user: 'deploy', port: 2222 });
+        expect(config?.identityFile).toEqual(['/keys/web', '/keys/default']);
+      });
+
+      it('should honour negated patterns', () => {
+        fs.writeFileSync(configPath, `
+Host web* !web9
+  User deploy
+`);
+
+        expect(SSHConfigParser.findHostConfig('web1', configPath)?.user).toBe('deploy');
+        expect(SSHConfigParser.findHostConfig('web9', configPath)).toBeNull();
+      });
+
+      it('should reparse the file once it changes', () => {
+        fs.writeFileSync(configPath, 'Host a\n  User first\n');
+        expect(SSHConfigParser.findHostConfig('a', configPath)?.user).toBe('first');
+        expect(SSHConfigParser.parse(configPath)).toBe(SSHConfigParser.parse(configPath));
+
+        fs.writeFileSync(configPath, 'Host a\n  User second-user\n');
+        expect(SSHConfigParser.findHostConfig('a', configPath)?.user).toBe('second-user');
+      });
+    });
+  });
+
+  describe('parseProxyJump', () => {
+    it('should split hops with their users and ports', () => {
+      expect(SSHConfigParser.parseProxyJump('alice@bastion:2222, gw,ssh://bob@[2001:db8::1]:22')).toEqual([
+        { spec: 'alice@bastion:2222', host: 'bastion', port: 2222, user: 'alice' },
+        { spec: 'gw', host: 'gw' },
+        { spec: 'ssh://bob@[2001:db8::1]:22', host: '2001:db8::1', port: 22, user: 'bob' }
+      ]);
+    });
+
+    it('should give no hops for none', () => {
+      expect(SSHConfigParser.parseProxyJump('none')).toEqual([]);
+    });
   });
 });
@@ -0,0 +1,20 @@
+import { CipherProbe } from '../lib/crypto';
+
+describe('CipherProbe', () => {
+  it('should put the faster AEAD cipher first', () => {
+    const result = CipherProbe.probe();
+
+    expect(result.aesGcmMBps).toBeGreaterThan(0);
+    const first = result.aesGcmMBps >= result.chachaMBps ? 'aes128-gcm@openssh.com' : 'chacha20-poly1305@openssh.com';
+    expect(result.ciphers[0]).toBe(first);
+    expect(result.ciphers.slice(-3)).toEqual(['aes128-ctr', 'aes192-ctr', 'aes256-ctr']);
+  });
+
+  it('should measure once per process', () => {
+    expect(CipherProbe.probe()).toBe(CipherProbe.probe());
+
+    const ciphers = CipherProbe.preferredCiphers();
+    ciphers.pop();
+    expect(CipherProbe.preferredCiphers()).toHaveLength(ciphers.length + 1);
+  });
+});
@@ -0,0 +1,137 @@
+const mockStats = { connects: 0, disconnects: 0, failNext: false, sessions: [] as Array<{ channelsOpen: number }> };
+
+jest.mock('../build/Release/libssh_node.node', () => ({
+  SSHSession: class MockSSHSession {
+    private connected = false;
+    channelsOpen = 0;
+    constructor() {
+      mockStats.sessions.push(this);
+    }
+    connect() {
+      mockStats.connects++;
+      if (mockStats.failNext) {
+        mockStats.failNext = false;
+        return Promise.reject(new Error('Connection refused'));
+      }
+      this.connected = true;
+      return Promise.resolve();
+    }
+    disconnect() {
+      mockStats.disconnects++;
+      this.connected = false;
+      return Promise.resolve();
+    }
+    isConnected() { return this.connected; }
+    getStats() { return { channelsOpen: this.channelsOpen }; }
+    authenticatePassword() { return Promise.resolve(); }
+    authenticateAgent() { return Promise.resolve(); }
+  }
+}), { virtual: true });
+
+import { SSHSessionPool } from '../lib/pool';
+
+const target = { host: 'bastion.example.com', port: 22, autoDetectAgent: false };
+const auth = { username: 'deploy', useAgent: true };
+
+describe('SSHSessionPool', () => {
+  beforeEach(() => {
+    mockStats.connects = 0;
+    mockStats.disconnects = 0;
+    mockStats.failNext = false;
+    mockStats.sessions = [];
+  });
+
+  it('should share one connection between concurrent leases', async () => {
+    const pool = new SSHSessionPool();
+    const [a, b] = await Promise.all([pool.acquire(target, auth), pool.acquire(target, auth)]);
+
+    expect(a.session).toBe(b.session);
+    expect(mockStats.connects).toBe(1);
+    expect(pool.getStats()).toEqual({ sessions: 1, leases: 2 });
+
+    a.release();
+    a.release();
+    expect(pool.getStats()).toEqual({ sessions: 1, leases: 1 });
+    await pool.close();
+  });
+
+  it('should key sessions by auth method', async () => {
+    const pool = new SSHSessionPool();
+    const agent = await pool.acquire(target, auth);
+    const password = await pool.acquire(target, { username: 'deploy', password: 'secret' });
+
+    expect(agent.session).not.toBe(password.session);
+    expect(mockStats.connects).toBe(2);
+    await pool.close();
+  });
+
+  it('should not share a session between callers with other connection options', async () => {
+    const pool = new SSHSessionPool();
+    const a = await pool.acquire({ ...target, knownHosts: '/etc/ssh/ci_known_hosts' }, auth);
+    const b = await pool.acquire(target, auth);
+    const c = await pool.acquire({ ...target, ciphers: ['aes128-gcm@openssh.com'] }, auth);
+    const d = await pool.acquire({ ...target, knownHosts: '/etc/ssh/ci_known_hosts' }, auth);
+
+    expect(a.session).not.toBe(b.session);
+    expect(c.session).not.toBe(b.session);
+    expect(d.session).toBe(a.session);
+    expect(mockStats.connects).toBe(3);
+    await pool.close();
+  });
+
+  it('should open another connection once the lease cap is reached', async () => {
+    const pool = new SSHSessionPool({ maxLeasesPerSession: 1 });
+    const a = await pool.acquire(target, auth);
+    const b = await pool.acquire(target, auth);
+
+    expect(a.session).not.toBe(b.session);
+    expect(pool.getStats()).toEqual({ sessions: 2, leases: 2 });
+    await pool.close();
+  });
+
+  it('should open another connection once a session has the channel cap open', async () => {
+    const pool = new SSHSessionPool({ maxChannelsPerSession: 4 });
+    const a = await pool.acquire(target, auth);
+    // e.g. a prewarmed tunnel holding four forward channels
+    mockStats.sessions[0].channelsOpen = 4;
+    const b = await pool.acquire(target, auth);
+
+    expect(b.session).not.toBe(a.session);
+    expect(mockStats.connects).toBe(2);
+
+    mockStats.sessions[0].channelsOpen = 3;
+    const c = await pool.acquire(target, auth);
+    expect(c.session).toBe(a.session);
+    expect(pool.getStats()).toEqual({ sessions: 2, leases: 3 });
+    await pool.close();
+  });
+
+  it('should close idle sessions after the timeout', async () => {
+    jest.useFakeTimers();
+    try {
+      const pool = new SSHSessionPool({ idleTimeout: 1000 });
+      const lease = await pool.acquire(target, auth);
+      lease.release();
+
+      jest.advanceTimersByTime(999);
+      expect(mockStats.disconnects).toBe(0);
+      jest.advanceTimersByTime(1);
+      expect(mockStats.disconnects).toBe(1);
+      expect(pool.getStats()).toEqual({ sessions: 0, leases: 0 });
+    } finally {
+      jest.useRealTimers();
+    }
+  });
+
+  it('should drop a session that failed to connect', async () => {
+    const pool = new SSHSessionPool();
+    mockStats.failNext = true;
+
+    await expect(pool.acquire(target, auth)).rejects.toThrow('Connection refused');
+    expect(pool.getStats()).toEqual({ sessions: 0, leases: 0 });
+
+    const lease = await pool.acquire(target, auth);
+    expect(lease.session.isConnected()).toBe(true);
+    await pool.close();
+  });
+});
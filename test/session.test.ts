@@ -1,18 +1,62 @@
+// Connections made by mock sessions, in order
+const mockConnections: Array<{ host: unknown; via: unknown }> = [];
+
 // Mock the native module if it doesn't exist
 jest.mock('../build/Release/libssh_node.node', () => ({
   SSHSession: class MockSSHSession {
-    constructor() {}
-    connect() { return Promise.resolve(); }
-    disconnect() { return Promise.resolve(); }
-    isConnected() { return false; }
+    options: Record<string, unknown>;
+    connected = false;
+    constructor(options: Record<string, unknown>) { this.options = options; }
+    connect() {
+      this.connected = true;
+      mockConnections.push({ host: this.options.host, via: null });
+      return Promise.resolve();
+    }
+    connectVia(jump: { options: Record<string, unknown> }) {
+      this.connected = true;
+      mockConnections.push({ host: this.options.host, via: jump.options.host });
+      return Promise.resolve();
+    }
+    disconnect() { this.connected = false; return Promise.resolve(); }
+    isConnected() { return this.connected; }
     authenticatePassword() { return Promise.resolve(); }
     authenticateAgent() { return Promise.resolve(); }
     setOption() {}
     parseConfig() {}
     createChannel() { return {}; }
+    getStats() {
+      return {
+        bytesRead: 10, bytesWritten: 4, reads: 2, writes: 1, windowStalls: 0, bufferedBytes: 0,
+        channelsOpened: 1, channelOpenFailures: 0, channelsOpen: 1,
+        operations: { connect: { queueWait: { count: 1, totalUs: 3, maxUs: 3, buckets: [0, 0, 1] } } },
+        connect: { resolveMs: 1.5, tcpMs: 0.4, handshakeMs: 12, authMs: null, address: '::1', attempts: 2 }
+      };
+    }
+    execMany(commands: Array<string | { command: string }>, options: { concurrency?: number }) {
+      return Promise.resolve(commands.map(entry => ({
+        command: typeof entry === 'string' ? entry : entry.command,
+        exitCode: 0,
+        signal: null,
+        stdout: Buffer.from(String(options.concurrency)),
+        stderr: Buffer.alloc(0),
+        truncated: false,
+        timedOut: false
+      })));
+    }
+    openChannels(targets: Array<{ remoteHost?: string }>) {
+      return targets.map(target => ({
+        channel: { target },
+        opened: target.remoteHost === 'refused' ? Promise.reject(new Error('Failed to open forward channel')) : Promise.resolve()
+      }));
+    }
+  },
+  resolveConfig(host: string) {
+    return host === 'db' ? { hostname: ['10.0.0.5'], port: ['2200'], user: ['postgres'], identityfile: ['/keys/a', '/keys/b'] } : {};
   }
 }), { virtual: true });
 
+import { SSHConfigParser } from '../lib/config';
+import { SSHSessionPool } from '../lib/pool';
 import { SSHSession } from '../lib/session';
 
 describe('SSHSession', () => {
@@ -56,6 +100,168 @@ describe('SSHSession', () => {
     });
   });
 
+  describe('openChannels', () => {
+    it('should open the requested number of session channels', async () => {
+      const session = new SSHSession({ autoDetectAgent: false });
+      const channels = await Promise.all(session.openChannels(3));
+
+      expect(channels).toHaveLength(3);
+      expect(channels[0].getNativeChannel()).toEqual({ target: {} });
+    });
+
+    it('should settle each forward channel independently', async () => {
+      const session = new SSHSession({ autoDetectAgent: false });
+      const [ok, refused] = session.openChannels([
+        { remoteHost: 'db', remotePort: 5432 },
+        { remoteHost: 'refused', remotePort: 5432 }
+      ]);
+
+      expect((await ok).getNativeChannel().target.remoteHost).toBe('db');
+      await expect(refused).rejects.toThrow('Failed to open forward channel');
+    });
+  });
+
+  describe('execMany', () => {
+    it('should pass commands and options to the native batch', async () => {
+      const session = new SSHSession({ autoDetectAgent: false });
+      const results = await session.execMany(['uptime', { command: 'df -h', timeoutMs: 500 }], { concurrency: 2 });
+
+      expect(results.map(r => r.command)).toEqual(['uptime', 'df -h']);
+      expect(results[1].stdout.toString()).toBe('2');
+    });
+  });
+
+  describe('algorithm options', () => {
+    it('should pass algorithm lists through to the native session', () => {
+      const session = new SSHSession({ autoDetectAgent: false, ciphers: ['aes128-ctr'], compression: true });
+      expect(session.getNativeSession().options).toMatchObject({ ciphers: ['aes128-ctr'], compression: true });
+    });
+
+    it('should fill in probed ciphers only when none are given', () => {
+      const probed = new SSHSession({ autoDetectAgent: false, probeCiphers: true });
+      const ciphers = probed.getNativeSession().options.ciphers as string[];
+      expect(ciphers).toContain('chacha20-poly1305@openssh.com');
+      expect(ciphers).toContain('aes128-gcm@openssh.com');
+
+      const explicit = new SSHSession({ autoDetectAgent: false, probeCiphers: true, ciphers: 'aes256-ctr' });
+      expect(explicit.getNativeSession().options.ciphers).toBe('aes256-ctr');
+    });
+  });
+
+  describe('ssh_config', () => {
+    it('should take host settings from the native resolver', () => {
+      const session = new SSHSession({ autoDetectAgent: false, host: 'db' });
+      expect(session.getNativeSession().options).toMatchObject({ hostname: '10.0.0.5', port: 2200, user: 'postgres' });
+      expect(SSHConfigParser.findHostConfig('db')?.identityFile).toEqual(['/keys/a', '/keys/b']);
+      expect(SSHConfigParser.findHostConfig('elsewhere')).toBeNull();
+    });
+
+    it('should prefer explicit options', () => {
+      const session = new SSHSession({ autoDetectAgent: false, host: 'db', port: 22 });
+      expect(session.getNativeSession().options.port).toBe(22);
+    });
+  });
+
+  describe('happyEyeballs', () => {
+    afterEach(() => jest.restoreAllMocks());
+
+    it('should be turned off for hosts reached through a ProxyJump', () => {
+      jest.spyOn(SSHConfigParser, 'findHostConfig').mockReturnValue({ host: 'inner', proxyJump: 'bastion' });
+      const session = new SSHSession({ autoDetectAgent: false, host: 'inner' });
+      expect(session.getNativeSession().options.happyEyeballs).toBe(false);
+    });
+
+    it('should leave an explicit setting alone', () => {
+      jest.spyOn(SSHConfigParser, 'findHostConfig').mockReturnValue({ host: 'inner', proxyJump: 'bastion' });
+      const session = new SSHSession({ autoDetectAgent: false, host: 'inner', happyEyeballs: true });
+      expect(session.getNativeSession().options.happyEyeballs).toBe(true);
+    });
+  });
+
+  describe('proxyJump', () => {
+    beforeEach(() => {
+      mockConnections.length = 0;
+    });
+    afterEach(() => jest.restoreAllMocks());
+
+    it('should chain through every hop over jump channels', async () => {
+      const pool = new SSHSessionPool();
+      const session = new SSHSession({
+        autoDetectAgent: false, host: 'target', proxyJump: 'alice@bastion:2222,gw', jumpPool: pool
+      });
+      await session.connect();
+
+      expect(mockConnections).toEqual([
+        { host: 'bastion', via: null },
+        { host: 'gw', via: 'bastion' },
+        { host: 'target', via: 'gw' }
+      ]);
+      expect(session.getNativeSession().options.proxyJump).toBe('alice@bastion:2222,gw');
+      await pool.close();
+    });
+
+    it('should share a jump session between targets until both disconnect', async () => {
+      const pool = new SSHSessionPool();
+      const first = new SSHSession({ autoDetectAgent: false, host: 'app1', proxyJump: 'bastion', jumpPool: pool });
+      const second = new SSHSession({ autoDetectAgent: false, host: 'app2', proxyJump: 'bastion', jumpPool: pool });
+      await first.connect();
+      await second.connect();
+
+      expect(mockConnections.filter(c => c.host === 'bastion')).toHaveLength(1);
+      expect(pool.getStats()).toEqual({ sessions: 1, leases: 2 });
+
+      await first.disconnect();
+      await second.disconnect();
+      expect(pool.getStats()).toEqual({ sessions: 1, leases: 0 });
+      await pool.close();
+    });
+
+    it('should use ProxyJump from ssh_config unless told otherwise', async () => {
+      jest.spyOn(SSHConfigParser, 'findHostConfig').mockReturnValue({ host: 'inner', proxyJump: 'bastion' });
+      const pool = new SSHSessionPool();
+      await new SSHSession({ autoDetectAgent: false, host: 'inner', jumpPool: pool }).connect();
+      await new SSHSession({ autoDetectAgent: false, host: 'inner', proxyJump: 'none', jumpPool: pool }).connect();
+
+      expect(mockConnections).toEqual([
+        { host: 'bastion', via: null },
+        { host: 'inner', via: 'bastion' },
+        { host: 'inner', via: null }
+      ]);
+      await pool.close();
+    });
+  });
+
+  describe('cancellation', () => {
+    afterEach(() => jest.restoreAllMocks());
+
+    it('should pass signal and timeoutMs through to the native operations', async () => {
+      const session = new SSHSession({ autoDetectAgent: false, host: 'example.com', proxyJump: 'none' });
+      const native = session.getNativeSession();
+      const connect = jest.spyOn(native, 'connect');
+      const authenticateAgent = jest.spyOn(native, 'authenticateAgent');
+      const signal = new AbortController().signal;
+
+      await session.connect({ signal, timeoutMs: 2000 });
+      await session.authenticate({ useAgent: true, username: 'deploy', signal });
+
+      expect(connect).toHaveBeenCalledWith({ signal, timeoutMs: 2000 });
+      expect(authenticateAgent).toHaveBeenCalledWith('deploy', { signal, timeoutMs: undefined });
+    });
+  });
+
+  describe('getStats', () => {
+    it('should return the native counters', () => {
+      const session = new SSHSession({ autoDetectAgent: false });
+      const stats = session.getStats();
+
+      expect(stats.bytesRead).toBe(10);
+      expect(stats.channelsOpened).toBe(1);
+      expect(stats.channelsOpen).toBe(1);
+      expect(stats.operations.connect.queueWait.buckets[2]).toBe(1);
+      expect(stats.connect).toMatchObject({ address: '::1', attempts: 2, authMs: null });
+    });
+  });
+
   // Note: Actual connection tests require a real SSH server
   // These should be in integration tests
 });
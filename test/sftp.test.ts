@@ -0,0 +1,162 @@
+const mockCalls: unknown[][] = [];
+const mockListing: string[][] = [];
+
+function mockBatch(names: string[]) {
+  const ends: number[] = [];
+  let end = 0;
+  for (const name of names) {
+    end += Buffer.byteLength(name);
+    ends.push(end);
+  }
+  return {
+    names: Buffer.from(names.join('')),
+    nameEnds: Uint32Array.from(ends),
+    sizes: Float64Array.from(names.map((_, i) => i * 100)),
+    mtimes: Float64Array.from(names.map(() => 1700000000)),
+    modes: Uint32Array.from(names.map((name) => (name.endsWith('/') ? 0o040755 : 0o100644)))
+  };
+}
+
+jest.mock('../build/Release/libssh_node.node', () => ({
+  SSHSession: class MockSSHSession {
+    constructor() {}
+    isConnected() { return true; }
+  },
+  SSHSftp: class MockSSHSftp {
+    constructor(session: unknown) { mockCalls.push(['new', session]); }
+    open() { return Promise.resolve(); }
+    close() { mockCalls.push(['close']); return Promise.resolve(); }
+    download(...args: unknown[]) {
+      mockCalls.push(['download', ...args]);
+      return Promise.resolve({ bytes: 1024 });
+    }
+    transferMany(...args: unknown[]) {
+      mockCalls.push(['transferMany', ...args]);
+      return Promise.resolve({ bytes: 30, files: [{ bytes: 10 }, { bytes: 20 }, { bytes: 0, error: 'Failed to open remote file' }] });
+    }
+    openDir(path: string) { mockCalls.push(['openDir', path]); return Promise.resolve(7); }
+    readDir(handle: number, batchSize?: number) {
+      mockCalls.push(['readDir', handle, batchSize]);
+      const names = mockListing.shift();
+      return Promise.resolve(names ? mockBatch(names) : null);
+    }
+    closeDir(handle: number) { mockCalls.push(['closeDir', handle]); return Promise.resolve(); }
+    upload(...args: unknown[]) {
+      mockCalls.push(['upload', ...args]);
+      const options = args[2] as { onProgress?: (transferred: number, total: number) => void };
+      options.onProgress?.(2048, 2048);
+      return Promise.resolve({ bytes: 2048 });
+    }
+  }
+}), { virtual: true });
+
+import { SSHSession } from '../lib/session';
+import { SSHSftp } from '../lib/sftp';
+
+describe('SSHSftp', () => {
+  let session: SSHSession;
+
+  beforeEach(() => {
+    mockCalls.length = 0;
+    mockListing.length = 0;
+    session = new SSHSession({ autoDetectAgent: false });
+    jest.spyOn(session, 'isConnected').mockReturnValue(true);
+  });
+
+  it('should open the subsystem on the native session', async () => {
+    const sftp = new SSHSftp(session);
+    await sftp.open();
+
+    expect(sftp.isOpen()).toBe(true);
+    expect(mockCalls[0]).toEqual(['new', session.getNativeSession()]);
+    await expect(sftp.open()).rejects.toThrow('SFTP session is already open');
+  });
+
+  it('should pass download options through', async () => {
+    const sftp = new SSHSftp(session);
+    await sftp.open();
+
+    const result = await sftp.download('/var/log/big.log', '/tmp/big.log', { concurrency: 16 });
+    expect(result.bytes).toBe(1024);
+    expect(mockCalls[1]).toEqual(['download', '/var/log/big.log', '/tmp/big.log', { concurrency: 16 }]);
+  });
+
+  it('should upload with a progress callback', async () => {
+    const sftp = new SSHSftp(session);
+    await sftp.open();
+
+    const progress: number[][] = [];
+    const result = await sftp.upload('/tmp/dump.sql', '/srv/dump.sql', {
+      concurrency: 128,
+      onProgress: (transferred, total) => progress.push([transferred, total])
+    });
+
+    expect(result.bytes).toBe(2048);
+    expect(mockCalls[1].slice(0, 3)).toEqual(['upload', '/tmp/dump.sql', '/srv/dump.sql']);
+    expect(progress).toEqual([[2048, 2048]]);
+  });
+
+  it('should merge per-file results with their jobs', async () => {
+    const sftp = new SSHSftp(session);
+    await sftp.open();
+
+    const jobs = [
+      { direction: 'download' as const, remotePath: '/a', localPath: '/tmp/a' },
+      { direction: 'upload' as const, remotePath: '/b', localPath: '/tmp/b' },
+      { direction: 'download' as const, remotePath: '/missing', localPath: '/tmp/missing' }
+    ];
+    const result = await sftp.transferMany(jobs, { channels: 8 });
+
+    expect(result.bytes).toBe(30);
+    expect(result.files[1]).toEqual({ direction: 'upload', remotePath: '/b', localPath: '/tmp/b', bytes: 20 });
+    expect(result.files[2].error).toBe('Failed to open remote file');
+    expect(mockCalls[1]).toEqual(['transferMany', jobs, { channels: 8 }]);
+  });
+
+  it('should list a directory in batches', async () => {
+    const sftp = new SSHSftp(session);
+    await sftp.open();
+    mockListing.push(['a.log', 'b.log'], ['dir/', 'ünïcode']);
+
+    const names: string[] = [];
+    let directories = 0;
+    for await (const batch of sftp.readdir('/var/log', { batchSize: 2 })) {
+      for (let i = 0; i < batch.length; i++) {
+        names.push(batch.name(i));
+        if (batch.isDirectory(i)) {
+          directories++;
+        }
+      }
+    }
+
+    expect(names).toEqual(['a.log', 'b.log', 'dir/', 'ünïcode']);
+    expect(directories).toBe(1);
+    expect(mockCalls[1]).toEqual(['openDir', '/var/log']);
+    expect(mockCalls[2]).toEqual(['readDir', 7, 2]);
+    expect(mockCalls[mockCalls.length - 1]).toEqual(['closeDir', 7]);
+  });
+
+  it('should close the handle when iteration stops early', async () => {
+    const sftp = new SSHSftp(session);
+    await sftp.open();
+    mockListing.push(['a', 'b'], ['c']);
+
+    for await (const batch of sftp.readdir('/srv')) {
+      expect([...batch.entries()][1]).toEqual({ name: 'b', size: 100, mtime: 1700000000, mode: 0o100644 });
+      break;
+    }
+
+    expect(mockCalls[mockCalls.length - 1]).toEqual(['closeDir', 7]);
+  });
+
+  it('should refuse transfers before open and after close', async () => {
+    const sftp = new SSHSftp(session);
+    await expect(sftp.download('/a', '/b')).rejects.toThrow('SFTP session is not open');
+    await expect(sftp.upload('/a', '/b')).rejects.toThrow('SFTP session is not open');
+
+    await sftp.open();
+    await sftp.close();
+    expect(mockCalls[mockCalls.length - 1]).toEqual(['close']);
+    await expect(sftp.download('/a', '/b')).rejects.toThrow('SFTP session is not open');
+  });
+});
@@ -0,0 +1,117 @@
+// Mock the native module if it doesn't exist
+const mockEvents: Array<(event: unknown) => void> = [];
+const mockOptions: Array<Record<string, unknown>> = [];
+
+jest.mock('../build/Release/libssh_node.node', () => ({
+  SSHSession: class MockSSHSession {
+    constructor() {}
+    isConnected() { return true; }
+  },
+  SSHTunnel: class MockSSHTunnel {
+    private running = false;
+    constructor(_session: unknown, options: Record<string, unknown>) { mockOptions.push(options); }
+    start(onEvent: (event: unknown) => void) {
+      this.running = true;
+      mockEvents.push(onEvent);
+      return 40123;
+    }
+    stop() { this.running = false; return Promise.resolve(); }
+    isRunning() { return this.running; }
+    getStats() {
+      return { activeConnections: 1, totalConnections: 3, bytesSent: 10, bytesReceived: 20, bufferedBytes: 4, warmChannels: 2 };
+    }
+    getConnections() {
+      return Promise.resolve([{
+        id: 2, address: '127.0.0.1', port: 51000, open: true, bytesSent: 10, bytesReceived: 20,
+        bufferedToLocal: 4, bufferedToRemote: 0, channelBuffered: 8, remoteWindow: 65536
+      }]);
+    }
+  }
+}), { virtual: true });
+
+import { SSHSession } from '../lib/session';
+import { SSHTunnel } from '../lib/tunnel';
+
+describe('SSHTunnel', () => {
+  let session: SSHSession;
+
+  beforeEach(() => {
+    mockEvents.length = 0;
+    mockOptions.length = 0;
+    session = new SSHSession({ autoDetectAgent: false });
+    jest.spyOn(session, 'isConnected').mockReturnValue(true);
+  });
+
+  it('should report the port assigned by the native engine', async () => {
+    const tunnel = new SSHTunnel({ session, remoteHost: 'localhost', remotePort: 5432 });
+    await tunnel.start();
+
+    expect(tunnel.isRunning()).toBe(true);
+    expect(tunnel.getLocalAddress()).toEqual({ host: '127.0.0.1', port: 40123 });
+
+    await tunnel.stop();
+    expect(tunnel.isRunning()).toBe(false);
+    expect(tunnel.getLocalAddress()).toBeNull();
+  });
+
+  it('should refuse to start twice', async () => {
+    const tunnel = new SSHTunnel({ session, remoteHost: 'localhost', remotePort: 5432 });
+    await tunnel.start();
+    await expect(tunnel.start()).rejects.toThrow('Tunnel is already started');
+    await tunnel.stop();
+  });
+
+  it('should pass the warm pool size to the native tunnel', async () => {
+    const warm = new SSHTunnel({ session, remoteHost: 'localhost', remotePort: 5432, prewarm: 3 });
+    const cold = new SSHTunnel({ session, remoteHost: 'localhost', remotePort: 5432 });
+    await warm.start();
+    await cold.start();
+
+    expect(mockOptions[0].prewarm).toBe(3);
+    expect(mockOptions[1].prewarm).toBe(0);
+    await warm.stop();
+    await cold.stop();
+  });
+
+  it('should expose native counters', async () => {
+    const tunnel = new SSHTunnel({ session, remoteHost: 'localhost', remotePort: 5432 });
+    expect(tunnel.getActiveConnectionCount()).toBe(0);
+
+    await tunnel.start();
+    expect(tunnel.getStats()).toEqual({
+      activeConnections: 1, totalConnections: 3, bytesSent: 10, bytesReceived: 20, bufferedBytes: 4, warmChannels: 2
+    });
+    expect(tunnel.getActiveConnectionCount()).toBe(1);
+    await tunnel.stop();
+  });
+
+  it('should expose per-connection buffer gauges', async () => {
+    const tunnel = new SSHTunnel({ session, remoteHost: 'localhost', remotePort: 5432 });
+    expect(await tunnel.getConnections()).toEqual([]);
+
+    await tunnel.start();
+    const [conn] = await tunnel.getConnections();
+    expect(conn.bufferedToLocal).toBe(4);
+    expect(conn.channelBuffered).toBe(8);
+    expect(conn.remoteWindow).toBe(65536);
+    await tunnel.stop();
+  });
+
+  it('should re-emit native lifecycle events', async () => {
+    const tunnel = new SSHTunnel({ session, remoteHost: 'localhost', remotePort: 5432 });
+    const opened = jest.fn();
+    const closed = jest.fn();
+    tunnel.on('connection', opened);
+    tunnel.on('close', closed);
+
+    await tunnel.start();
+    mockEvents[0]({ type: 'connection', id: 7, address: '127.0.0.1', port: 51000 });
+    mockEvents[0]({ type: 'close', id: 7, bytesSent: 5, bytesReceived: 9, message: 'reset' });
+
+    expect(opened).toHaveBeenCalledWith({ id: 7, address: '127.0.0.1', port: 51000 });
+    expect(closed).toHaveBeenCalledTimes(1);
+    expect(closed.mock.calls[0][0].bytesReceived).toBe(9);
+    expect(closed.mock.calls[0][0].error.message).toBe('reset');
+    await tunnel.stop();
+  });
+});